@@ -124,15 +124,18 @@ testScripts = [
     'bip68-112-113-p2p.py',
     'rawtransactions.py',
     'reindex.py',
+    'blockimport.py',
     # vv Tests less than 30s vv
     'mempool_resurrect_test.py',
     'txn_doublespend.py --mineblock',
     'txn_clone.py',
     'getchaintips.py',
     'rest.py',
+    'addressindex.py',
     'mempool_spendcoinbase.py',
     'mempool_reorg.py',
     'httpbasics.py',
+    'rpcqueue.py',
     'multi_rpc.py',
     'proxy_test.py',
     'signrawtransactions.py',
@@ -0,0 +1,161 @@
+#!/usr/bin/env python3
+# Copyright (c) 2017 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#
+# Test the address index as blocks are connected, disconnected and reorged,
+# through getaddressoutputs and /rest/address/
+#
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import *
+from test_framework.address import script_to_p2sh
+from test_framework.mininode import CTransaction, FromHex, ToHex
+from test_framework.script import CScript, OP_TRUE, OP_2, OP_3, OP_4
+
+import http.client
+import json
+import urllib.parse
+
+COINBASE_MATURITY = 180
+
+# Pay-to-script-hash outputs that anyone can spend by revealing the script
+SCRIPT_A = CScript([OP_TRUE])
+SCRIPT_B = CScript([OP_2])
+SCRIPT_C = CScript([OP_3])
+SCRIPT_D = CScript([OP_4])
+
+class AddressIndexTest (BitcoinTestFramework):
+    def __init__(self):
+        super().__init__()
+        self.num_nodes = 2
+        self.setup_clean_chain = True
+
+    def setup_network(self):
+        # The nodes are not connected: blocks are passed with submitblock so
+        # that node1 can build a competing chain
+        self.nodes = start_nodes(self.num_nodes, self.options.tmpdir, [["-addressindex", "-rest"], []])
+        self.is_network_split = True
+
+    def spend(self, txid, vout, value, script, address):
+        rawtx = self.nodes[0].createrawtransaction([{"txid": txid, "vout": vout}], {address: value})
+        tx = FromHex(CTransaction(), rawtx)
+        tx.vin[0].scriptSig = CScript([script])
+        return self.nodes[0].sendrawtransaction(ToHex(tx))
+
+    def submit_blocks(self, source, dest, hashes):
+        # A block on a branch that is not longer yet is inconclusive
+        for blockhash in hashes:
+            assert(dest.submitblock(source.getblock(blockhash, False, True)) in (None, "inconclusive"))
+        assert_equal(dest.getbestblockhash(), hashes[-1])
+
+    def rest_outputs(self, address, unspentonly=False, skip=0, count=1000):
+        url = urllib.parse.urlparse(self.nodes[0].url)
+        path = '/rest/address/' + ('unspent/' if unspentonly else '') + '%d/%d/%s.json' % (skip, count, address)
+        conn = http.client.HTTPConnection(url.hostname, url.port)
+        conn.request('GET', path)
+        response = conn.getresponse()
+        assert_equal(response.status, 200)
+        return json.loads(response.read().decode('utf-8'), parse_float=Decimal)
+
+    def outputs(self, address, unspentonly=False, skip=0, count=1000):
+        # The RPC and REST interfaces return the same entries
+        entries = self.nodes[0].getaddressoutputs(address, unspentonly, skip, count)
+        assert_equal(self.rest_outputs(address, unspentonly, skip, count), entries)
+        return entries
+
+    def run_test(self):
+        node = self.nodes[0]
+        address_a = script_to_p2sh(SCRIPT_A)
+        address_b = script_to_p2sh(SCRIPT_B)
+        address_c = script_to_p2sh(SCRIPT_C)
+        address_d = script_to_p2sh(SCRIPT_D)
+
+        assert_raises_jsonrpc(-1, "Address index not enabled", self.nodes[1].getaddressoutputs, address_a)
+        assert_raises_jsonrpc(-5, "Invalid Unitus address", node.getaddressoutputs, "notanaddress")
+        assert_raises_jsonrpc(-8, "Count out of range", node.getaddressoutputs, address_a, False, 0, 10001)
+
+        print("Connect blocks paying to one address...")
+        hashes = node.generatetoaddress(COINBASE_MATURITY + 1, address_a)
+        self.submit_blocks(node, self.nodes[1], hashes)
+        entries = self.outputs(address_a)
+        assert_equal(len(entries), COINBASE_MATURITY + 1)
+        for height, entry in enumerate(entries, 1):
+            assert_equal(entry["height"], height)
+            assert_equal(entry["txid"], node.getblock(hashes[height - 1])["tx"][0])
+            assert_equal(entry["vout"], 0)
+            assert_equal(entry["spent"], False)
+        assert_equal(self.outputs(address_a, True), entries)
+        assert_equal(self.outputs(address_b), [])
+
+        # Paging
+        assert_equal(self.outputs(address_a, False, 10, 5), entries[10:15])
+        assert_equal(self.outputs(address_a, True, COINBASE_MATURITY, 10), entries[COINBASE_MATURITY:])
+        assert_equal(self.outputs(address_a, False, 1000, 10), [])
+        assert_equal(self.nodes[0].getaddressoutputs(address_a, False, 0, 0), [])
+
+        print("Spend an output and the output it creates in the same block...")
+        coinbase = entries[0]
+        value_b = coinbase["value"] - Decimal("0.01")
+        value_c = value_b - Decimal("0.01")
+        txid_b = self.spend(coinbase["txid"], 0, value_b, SCRIPT_A, address_b)
+        txid_c = self.spend(txid_b, 0, value_c, SCRIPT_B, address_c)
+        tip = node.generatetoaddress(1, address_d)[0]
+        assert_equal(set(node.getblock(tip)["tx"][1:]), {txid_b, txid_c})
+        height = COINBASE_MATURITY + 2
+
+        def check_spent_in_block():
+            entries_a = self.outputs(address_a)
+            assert_equal(entries_a[0]["spent"], True)
+            assert_equal(entries_a[0]["spenttxid"], txid_b)
+            assert_equal(entries_a[0]["spentheight"], height)
+            assert_equal(self.outputs(address_a, True), entries_a[1:])
+
+            # Written and spent by the same block
+            assert_equal(self.outputs(address_b), [{"txid": txid_b, "vout": 0, "height": height, "value": value_b,
+                                                    "spent": True, "spenttxid": txid_c, "spentheight": height}])
+            assert_equal(self.outputs(address_b, True), [])
+
+            assert_equal(self.outputs(address_c), [{"txid": txid_c, "vout": 0, "height": height, "value": value_c, "spent": False}])
+
+        check_spent_in_block()
+        assert_equal(len(self.outputs(address_a)), COINBASE_MATURITY + 1)
+        assert_equal([entry["height"] for entry in self.outputs(address_d)], [height])
+
+        print("Disconnect the block...")
+        node.invalidateblock(tip)
+        assert_equal(self.outputs(address_a), entries)
+        assert_equal(self.outputs(address_b), [])
+        assert_equal(self.outputs(address_c), [])
+        assert_equal(self.outputs(address_d), [])
+
+        print("Connect it again...")
+        node.reconsiderblock(tip)
+        assert_equal(node.getbestblockhash(), tip)
+        check_spent_in_block()
+        assert_equal([entry["height"] for entry in self.outputs(address_d)], [height])
+
+        print("Reorg to a longer chain without the transactions...")
+        fork = self.nodes[1].generatetoaddress(2, address_d)
+        self.submit_blocks(self.nodes[1], node, fork)
+        assert_equal(node.getbestblockhash(), fork[1])
+        assert_equal(self.outputs(address_a), entries)
+        assert_equal(self.outputs(address_b), [])
+        assert_equal(self.outputs(address_c), [])
+        entries_d = self.outputs(address_d)
+        assert_equal([entry["height"] for entry in entries_d], [height, height + 1])
+        assert_equal([entry["txid"] for entry in entries_d], [node.getblock(blockhash)["tx"][0] for blockhash in fork])
+        assert_equal(sorted(node.getrawmempool()), sorted([txid_b, txid_c]))
+
+        print("Mine the transactions on the new chain...")
+        height += 2
+        tip = node.generatetoaddress(1, address_a)[0]
+        check_spent_in_block()
+        entries_a = self.outputs(address_a)
+        assert_equal(len(entries_a), COINBASE_MATURITY + 2)
+        assert_equal(entries_a[-1]["height"], height)
+        assert_equal(len(self.outputs(address_d)), 2)
+
+if __name__ == '__main__':
+    AddressIndexTest().main()
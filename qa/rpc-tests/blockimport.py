@@ -0,0 +1,122 @@
+#!/usr/bin/env python3
+# Copyright (c) 2017 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#
+# Test importing blocks with -loadblock and -reindex: blocks out of order
+# across files, blocks read again once the import buffer is full, files
+# that cannot be opened, and a reindex interrupted by a shutdown
+#
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import *
+
+import os
+import struct
+import time
+
+NUM_BLOCKS = 300
+MAGIC = bytes([0xc7, 0xab, 0xc8, 0x9d])
+
+class BlockImportTest (BitcoinTestFramework):
+    def __init__(self):
+        super().__init__()
+        self.num_nodes = 4
+        self.setup_clean_chain = True
+
+    def setup_network(self):
+        # Only the first node starts, the others import its blocks
+        self.nodes = [start_node(0, self.options.tmpdir)]
+        self.is_network_split = True
+
+    def last_run_log(self, i):
+        with open(log_filename(self.options.tmpdir, i, "debug.log"), encoding='utf8') as f:
+            log = f.read()
+        return log[log.rfind("Unitus version"):]
+
+    def block_record(self, blockhash):
+        block = hex_str_to_bytes(self.nodes[0].getblock(blockhash, False, True))
+        return MAGIC + struct.pack("<I", len(block)) + block
+
+    def write_blocks(self, name, hashes):
+        path = os.path.join(self.options.tmpdir, name)
+        with open(path, 'wb') as f:
+            for blockhash in hashes:
+                f.write(self.block_record(blockhash))
+        return path
+
+    def wait_for_tip(self, node, tip):
+        for attempt in range(600):
+            if node.getblockcount() >= NUM_BLOCKS:
+                break
+            time.sleep(0.1)
+        assert_equal(node.getblockcount(), NUM_BLOCKS)
+        assert_equal(node.getbestblockhash(), tip)
+
+    def import_blocks(self, i, tip, extra_args):
+        node = start_node(i, self.options.tmpdir, ["-debug=reindex"] + extra_args)
+        self.wait_for_tip(node, tip)
+        stop_node(node, i)
+        return self.last_run_log(i)
+
+    def run_test(self):
+        hashes = self.nodes[0].generatetoaddress(NUM_BLOCKS, "mfWyW5fc9NUj75YAnFgoRLrjxgLDn2MMth")
+        tip = hashes[-1]
+        half = NUM_BLOCKS // 2
+        # Like a bootstrap file, the first file starts with the genesis block
+        early = self.write_blocks("early.dat", [self.nodes[0].getblockhash(0)] + hashes[:half])
+        late = self.write_blocks("late.dat", hashes[half:])
+        missing = os.path.join(self.options.tmpdir, "missing.dat")
+        record = self.block_record(hashes[0])
+
+        print("Import files in the wrong order...")
+        log = self.import_blocks(1, tip, ["-loadblock=" + late, "-loadblock=" + early])
+        assert("Out of order block %s" % hashes[half] in log)
+        assert("Processing out of order child %s of %s" % (hashes[half], hashes[half - 1]) in log)
+        assert("Import buffer full" not in log)
+
+        print("Import without room to hold blocks read ahead...")
+        log = self.import_blocks(2, tip, ["-importbuffer=0", "-loadblock=" + late, "-loadblock=" + early])
+        assert("reading blocks of %s again" % late in log)
+        assert("reading blocks of %s again" % early in log)
+
+        print("Import with a file that cannot be opened...")
+        log = self.import_blocks(3, tip, ["-loadblock=" + missing, "-loadblock=" + early, "-loadblock=" + late])
+        assert("Could not open blocks file %s" % missing in log)
+
+        print("Interrupt a reindex...")
+        # The node reindexes its own blocks, then waits for the next block
+        # file, a pipe, until the shutdown has started
+        stop_node(self.nodes[0], 0)
+        pipe = os.path.join(self.options.tmpdir, "node0", "regtest", "blocks", "blk00001.dat")
+        os.mkfifo(pipe)
+        node = start_node(0, self.options.tmpdir, ["-reindex"])
+        for attempt in range(600):
+            if node.getblockchaininfo()["headers"] >= NUM_BLOCKS:
+                break
+            time.sleep(0.1)
+        assert_equal(node.getblockchaininfo()["headers"], NUM_BLOCKS)
+        node.stop()
+        for attempt in range(600):
+            if "Shutdown: In progress" in self.last_run_log(0):
+                break
+            time.sleep(0.1)
+        with open(pipe, 'wb') as f:
+            f.write(record)
+        assert_equal(bitcoind_processes[0].wait(timeout=60), 0)
+        del bitcoind_processes[0]
+        log = self.last_run_log(0)
+        assert("Reindexing block file blk00001.dat" in log)
+        assert("Reindexing finished" not in log)
+        os.remove(pipe)
+
+        # The reindex starts over on the next start
+        self.nodes[0] = start_node(0, self.options.tmpdir)
+        self.wait_for_tip(self.nodes[0], tip)
+        log = self.last_run_log(0)
+        assert("Reindexing block file blk00000.dat" in log)
+        assert("Reindexing finished" in log)
+
+if __name__ == '__main__':
+    BlockImportTest().main()
@@ -0,0 +1,123 @@
+#!/usr/bin/env python3
+# Copyright (c) 2017 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#
+# Test JSON-RPC batches larger than the work queue depth, getrpcinfo and
+# the work class of REST requests
+#
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import *
+
+import http.client
+import json
+import time
+import urllib.parse
+
+class RPCQueueTest (BitcoinTestFramework):
+    def __init__(self):
+        super().__init__()
+        self.num_nodes = 1
+        self.setup_clean_chain = True
+
+    def setup_network(self):
+        self.nodes = start_nodes(self.num_nodes, self.options.tmpdir, [["-rpcworkqueue=4", "-rpcthreads=2", "-rest",
+                                                                         "-rpcpriority=getblockcount:low",
+                                                                         "-rpcmethodthreads=getblockhash:1"]])
+        self.is_network_split = False
+
+    def batch(self, entries):
+        url = urllib.parse.urlparse(self.nodes[0].url)
+        authpair = url.username + ':' + url.password
+        headers = {"Authorization": "Basic " + str_to_b64str(authpair)}
+        conn = http.client.HTTPConnection(url.hostname, url.port)
+        conn.request('POST', '/', json.dumps(entries), headers)
+        response = conn.getresponse()
+        assert_equal(response.status, 200)
+        replies = json.loads(response.read().decode('utf-8'))
+        conn.close()
+        return replies
+
+    def run_test(self):
+        node = self.nodes[0]
+        node.generatetoaddress(10, "mfWyW5fc9NUj75YAnFgoRLrjxgLDn2MMth")
+        assert_equal(node.getblockcount(), 10)
+        hashes = [node.getblockhash(height) for height in range(11)]
+
+        # A batch much larger than the depth of each method's queue runs to
+        # completion, with the replies in the order of the entries
+        entries = []
+        for i in range(100):
+            entries.append({"method": "getblockcount", "id": 2 * i})
+            entries.append({"method": "getblockhash", "params": [i % 11], "id": 2 * i + 1})
+        replies = self.batch(entries)
+        assert_equal(len(replies), 200)
+        for i in range(100):
+            assert_equal(replies[2 * i]["id"], 2 * i)
+            assert_equal(replies[2 * i]["error"], None)
+            assert_equal(replies[2 * i]["result"], 10)
+            assert_equal(replies[2 * i + 1]["id"], 2 * i + 1)
+            assert_equal(replies[2 * i + 1]["error"], None)
+            assert_equal(replies[2 * i + 1]["result"], hashes[i % 11])
+
+        # Unknown methods and malformed entries fail on their own
+        replies = self.batch([{"method": "getblockcount", "id": 0}, {"method": "nosuchmethod", "id": 1}, {"id": 2}])
+        assert_equal(len(replies), 3)
+        assert_equal(replies[0]["result"], 10)
+        assert_equal(replies[1]["error"]["code"], -32601)
+        assert_equal(replies[2]["error"]["code"], -32600)
+
+        # getrpcinfo reports a queue per method with its limits and counters.
+        # A batch is answered as its last entry completes, so that entry may
+        # not be counted yet.
+        for attempt in range(50):
+            info = node.getrpcinfo()
+            if info["getblockcount"]["active"] == 0 and info["getblockhash"]["active"] == 0:
+                break
+            time.sleep(0.1)
+        assert("http" in info)
+        assert_equal(info["http"]["priority"], "high")
+        assert_equal(info["http"]["maxdepth"], 4)
+
+        count = info["getblockcount"]
+        assert_equal(count["priority"], "low")
+        assert_equal(count["maxdepth"], 4)
+        assert_equal(count["threadlimit"], 1)
+        assert_equal(count["depth"], 0)
+        assert_equal(count["active"], 0)
+        # Including the call that waited for the node to start
+        assert_equal(count["processed"], 103)
+        assert_equal(count["rejected"], 0)
+        assert(count["maxwait"] >= count["avgwait"] >= 0)
+        assert(count["maxrun"] >= count["avgrun"] >= 0)
+
+        blockhash = info["getblockhash"]
+        assert_equal(blockhash["priority"], "normal")
+        assert_equal(blockhash["threadlimit"], 1)
+        assert_equal(blockhash["processed"], 111)
+        assert_equal(blockhash["rejected"], 0)
+
+        # The call reporting the statistics is still running
+        assert_equal(info["getrpcinfo"]["active"], 1)
+        assert_equal(info["getrpcinfo"]["processed"], 0)
+
+        assert_equal(node.getrpcinfo()["getrpcinfo"]["processed"], 1)
+
+        # REST requests run in a class of their own with the default limits
+        url = urllib.parse.urlparse(node.url)
+        conn = http.client.HTTPConnection(url.hostname, url.port)
+        conn.request('GET', '/rest/chaininfo.json')
+        response = conn.getresponse()
+        assert_equal(response.status, 200)
+        assert_equal(json.loads(response.read().decode('utf-8'))["blocks"], 10)
+        conn.close()
+        rest = node.getrpcinfo()["rest"]
+        assert_equal(rest["priority"], "normal")
+        assert_equal(rest["threadlimit"], 1)
+        assert_equal(rest["maxdepth"], 4)
+        assert_equal(rest["processed"], 1)
+
+if __name__ == '__main__':
+    RPCQueueTest().main()
@@ -9,6 +9,7 @@
 #include "utilstrencodings.h"
 #include "crypto/common.h"
 
+#include <algorithm>
 #include <stdio.h>
 #include <string.h>
 
@@ -258,3 +259,325 @@ arith_uint256 UintToArith256(const uint256 &a)
         b.pn[x] = ReadLE32(a.begin() + x*4);
     return b;
 }
+
+namespace {
+
+/**
+ * Unsigned integer with a fixed capacity of WIDTH 32-bit limbs, only used for
+ * the exact intermediates of GetProductNthRoot. Only the lowest nSize limbs
+ * are significant; the top one is non-zero unless the value is zero.
+ */
+class wide_uint
+{
+public:
+    enum { WIDTH = 44 };
+    uint32_t pn[WIDTH];
+    int nSize;
+
+    wide_uint(uint64_t b = 0)
+    {
+        pn[0] = (uint32_t)b;
+        pn[1] = (uint32_t)(b >> 32);
+        nSize = 2;
+        Normalize();
+    }
+
+    explicit wide_uint(const arith_uint256& b)
+    {
+        uint256 n = ArithToUint256(b);
+        for (int i = 0; i < 8; i++)
+            pn[i] = ReadLE32(n.begin() + i * 4);
+        nSize = 8;
+        Normalize();
+    }
+
+    void Normalize()
+    {
+        while (nSize > 0 && pn[nSize - 1] == 0)
+            nSize--;
+    }
+
+    bool IsZero() const { return nSize == 0; }
+
+    arith_uint256 GetLow256() const
+    {
+        uint256 n;
+        for (int i = 0; i < 8; i++)
+            WriteLE32(n.begin() + i * 4, i < nSize ? pn[i] : 0);
+        return UintToArith256(n);
+    }
+
+    int bits() const
+    {
+        if (nSize == 0)
+            return 0;
+        int nBits = 32 * (nSize - 1);
+        for (uint32_t nTop = pn[nSize - 1]; nTop != 0; nTop >>= 1)
+            nBits++;
+        return nBits;
+    }
+
+    int CompareTo(const wide_uint& b) const
+    {
+        if (nSize != b.nSize)
+            return nSize < b.nSize ? -1 : 1;
+        for (int i = nSize - 1; i >= 0; i--) {
+            if (pn[i] != b.pn[i])
+                return pn[i] < b.pn[i] ? -1 : 1;
+        }
+        return 0;
+    }
+
+    friend bool operator==(const wide_uint& a, const wide_uint& b) { return a.CompareTo(b) == 0; }
+    friend bool operator<(const wide_uint& a, const wide_uint& b) { return a.CompareTo(b) < 0; }
+    friend bool operator<=(const wide_uint& a, const wide_uint& b) { return a.CompareTo(b) <= 0; }
+
+    friend wide_uint operator+(const wide_uint& a, const wide_uint& b)
+    {
+        const wide_uint& l = a.nSize >= b.nSize ? a : b;
+        const wide_uint& s = a.nSize >= b.nSize ? b : a;
+        wide_uint r;
+        uint64_t carry = 0;
+        for (int i = 0; i < l.nSize; i++) {
+            uint64_t n = carry + l.pn[i] + (i < s.nSize ? s.pn[i] : 0);
+            r.pn[i] = (uint32_t)n;
+            carry = n >> 32;
+        }
+        r.nSize = l.nSize;
+        if (carry) {
+            assert(r.nSize < WIDTH);
+            r.pn[r.nSize++] = (uint32_t)carry;
+        }
+        return r;
+    }
+
+    /** a - b, requires a >= b. */
+    friend wide_uint operator-(const wide_uint& a, const wide_uint& b)
+    {
+        assert(b <= a);
+        wide_uint r;
+        int64_t borrow = 0;
+        for (int i = 0; i < a.nSize; i++) {
+            int64_t n = (int64_t)a.pn[i] - (i < b.nSize ? b.pn[i] : 0) - borrow;
+            borrow = n < 0;
+            r.pn[i] = (uint32_t)n;
+        }
+        r.nSize = a.nSize;
+        r.Normalize();
+        return r;
+    }
+
+    friend wide_uint operator*(const wide_uint& a, const wide_uint& b)
+    {
+        wide_uint r;
+        if (a.IsZero() || b.IsZero())
+            return r;
+        assert(a.nSize + b.nSize <= WIDTH);
+        for (int i = 0; i < a.nSize + b.nSize; i++)
+            r.pn[i] = 0;
+        for (int j = 0; j < b.nSize; j++) {
+            uint64_t carry = 0;
+            for (int i = 0; i < a.nSize; i++) {
+                uint64_t n = carry + r.pn[i + j] + (uint64_t)a.pn[i] * b.pn[j];
+                r.pn[i + j] = (uint32_t)n;
+                carry = n >> 32;
+            }
+            r.pn[j + a.nSize] = (uint32_t)carry;
+        }
+        r.nSize = a.nSize + b.nSize;
+        r.Normalize();
+        return r;
+    }
+
+    friend wide_uint operator<<(const wide_uint& a, unsigned int shift)
+    {
+        wide_uint r;
+        if (a.IsZero())
+            return r;
+        int k = shift / 32;
+        shift %= 32;
+        assert(a.nSize + k + 1 <= WIDTH);
+        for (int i = 0; i < k; i++)
+            r.pn[i] = 0;
+        r.pn[a.nSize + k] = 0;
+        for (int i = a.nSize - 1; i >= 0; i--) {
+            if (shift != 0)
+                r.pn[i + k + 1] |= a.pn[i] >> (32 - shift);
+            r.pn[i + k] = a.pn[i] << shift;
+        }
+        r.nSize = a.nSize + k + 1;
+        r.Normalize();
+        return r;
+    }
+
+    friend wide_uint operator>>(const wide_uint& a, unsigned int shift)
+    {
+        wide_uint r;
+        int k = shift / 32;
+        shift %= 32;
+        if (k >= a.nSize)
+            return r;
+        for (int i = k; i < a.nSize; i++) {
+            uint32_t n = a.pn[i] >> shift;
+            if (shift != 0 && i + 1 < a.nSize)
+                n |= a.pn[i + 1] << (32 - shift);
+            r.pn[i - k] = n;
+        }
+        r.nSize = a.nSize - k;
+        r.Normalize();
+        return r;
+    }
+
+    /** Truncating division (Knuth, TAOCP vol. 2, algorithm 4.3.1 D). */
+    friend wide_uint operator/(const wide_uint& u, const wide_uint& v)
+    {
+        if (v.IsZero())
+            throw uint_error("Division by zero");
+        wide_uint q;
+        if (u < v)
+            return q;
+
+        const int m = u.nSize;
+        const int n = v.nSize;
+        if (n == 1) {
+            uint64_t rem = 0;
+            for (int j = m - 1; j >= 0; j--) {
+                uint64_t cur = (rem << 32) | u.pn[j];
+                q.pn[j] = (uint32_t)(cur / v.pn[0]);
+                rem = cur % v.pn[0];
+            }
+            q.nSize = m;
+            q.Normalize();
+            return q;
+        }
+
+        // Normalize so that the top limb of the divisor has its high bit set.
+        int s = 0;
+        while (!(v.pn[n - 1] & (0x80000000U >> s)))
+            s++;
+        uint32_t vn[WIDTH];
+        uint32_t un[WIDTH + 1];
+        for (int i = n - 1; i > 0; i--)
+            vn[i] = (v.pn[i] << s) | (s ? (uint32_t)((uint64_t)v.pn[i - 1] >> (32 - s)) : 0);
+        vn[0] = v.pn[0] << s;
+        un[m] = s ? (uint32_t)((uint64_t)u.pn[m - 1] >> (32 - s)) : 0;
+        for (int i = m - 1; i > 0; i--)
+            un[i] = (u.pn[i] << s) | (s ? (uint32_t)((uint64_t)u.pn[i - 1] >> (32 - s)) : 0);
+        un[0] = u.pn[0] << s;
+
+        const uint64_t b = 1ULL << 32;
+        for (int j = m - n; j >= 0; j--) {
+            uint64_t num = ((uint64_t)un[j + n] << 32) | un[j + n - 1];
+            uint64_t qhat = num / vn[n - 1];
+            uint64_t rhat = num % vn[n - 1];
+            while (qhat >= b || qhat * vn[n - 2] > ((rhat << 32) | un[j + n - 2])) {
+                qhat--;
+                rhat += vn[n - 1];
+                if (rhat >= b)
+                    break;
+            }
+
+            // Multiply and subtract.
+            int64_t k = 0;
+            int64_t t;
+            for (int i = 0; i < n; i++) {
+                uint64_t p = qhat * vn[i];
+                t = (int64_t)un[i + j] - k - (int64_t)(p & 0xffffffff);
+                un[i + j] = (uint32_t)t;
+                k = (int64_t)(p >> 32) - (t >> 32);
+            }
+            t = (int64_t)un[j + n] - k;
+            un[j + n] = (uint32_t)t;
+
+            q.pn[j] = (uint32_t)qhat;
+            if (t < 0) {
+                // Subtracted too much, add back.
+                q.pn[j]--;
+                uint64_t carry = 0;
+                for (int i = 0; i < n; i++) {
+                    uint64_t sum = (uint64_t)un[i + j] + vn[i] + carry;
+                    un[i + j] = (uint32_t)sum;
+                    carry = sum >> 32;
+                }
+                un[j + n] += (uint32_t)carry;
+            }
+        }
+        q.nSize = m - n + 1;
+        q.Normalize();
+        return q;
+    }
+};
+
+/** Port of CBigNum::nthRoot, see bignum.h. */
+wide_uint NthRoot(const wide_uint& x, int n)
+{
+    assert(n > 1);
+    if (x.IsZero())
+        return 0;
+
+    // starting approximation
+    int nRootBits = (x.bits() + n - 1) / n;
+    int nStartingBits = std::min(8, nRootBits);
+    wide_uint upper = x >> ((nRootBits - nStartingBits) * n);
+    wide_uint cur = 0;
+    for (int i = nStartingBits - 1; i >= 0; i--) {
+        wide_uint next = cur + wide_uint(1 << i);
+        wide_uint power = 1;
+        for (int j = 0; j < n; j++)
+            power = power * next;
+        if (power <= upper)
+            cur = next;
+    }
+    if (nRootBits == nStartingBits)
+        return cur;
+    cur = cur << (nRootBits - nStartingBits);
+
+    // iterate: cur = cur + (x / cur^^(n-1) - cur)/n
+    // The sign of the delta is tracked separately; like BN_div, the step
+    // delta/n is truncated towards zero.
+    const wide_uint root = n;
+    int nTerminate = 0;
+    // this should always converge in fewer steps, but limit just in case
+    for (int it = 0; it < 20; it++) {
+        wide_uint denominator = 1;
+        for (int i = 0; i < n - 1; i++)
+            denominator = denominator * cur;
+        wide_uint quotient = x / denominator;
+        if (quotient == cur)
+            return cur;
+        if (quotient < cur) {
+            if (nTerminate == 1)
+                return cur - 1;
+            wide_uint delta = cur - quotient;
+            if (delta <= root) {
+                cur = cur - 1;
+                nTerminate = -1;
+                continue;
+            }
+            cur = cur - delta / root;
+        } else {
+            if (nTerminate == -1)
+                return cur;
+            wide_uint delta = quotient - cur;
+            if (delta <= root) {
+                cur = cur + 1;
+                nTerminate = 1;
+                continue;
+            }
+            cur = cur + delta / root;
+        }
+        nTerminate = 0;
+    }
+    return cur;
+}
+
+} // anon namespace
+
+arith_uint256 GetProductNthRoot(const arith_uint256* pvalues, unsigned int nValues, int n)
+{
+    assert(nValues <= MAX_PRODUCT_NTHROOT_VALUES);
+    wide_uint product = 1;
+    for (unsigned int i = 0; i < nValues; i++)
+        product = product * wide_uint(pvalues[i]);
+    return NthRoot(product, n).GetLow256();
+}
@@ -287,4 +287,15 @@ public:
 uint256 ArithToUint256(const arith_uint256 &);
 arith_uint256 UintToArith256(const uint256 &);
 
+/** Maximum number of factors accepted by GetProductNthRoot. */
+static const unsigned int MAX_PRODUCT_NTHROOT_VALUES = 5;
+
+/**
+ * Integer n-th root (rounded down) of the product of nValues 256-bit values.
+ * The product is evaluated exactly and the root is found with the same
+ * starting approximation and Newton iteration as CBigNum::nthRoot, so the
+ * result is identical to it. Only the low 256 bits of the root are returned.
+ */
+arith_uint256 GetProductNthRoot(const arith_uint256* pvalues, unsigned int nValues, int n);
+
 #endif // BITCOIN_ARITH_UINT256_H
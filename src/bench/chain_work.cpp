@@ -0,0 +1,47 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "arith_uint256.h"
+#include "chain.h"
+#include "chainparams.h"
+
+#include <vector>
+
+// Link and credit work to a synthetic block index the way LoadBlockIndexDB
+// does at startup. The chain starts at genesis so the skip list can be built,
+// and the main net work rule heights are moved into it so both decayed-sum
+// rules and the geometric-mean rule are measured. The algos rotate
+// irregularly as on the real chain.
+static void LoadBlockIndexChainWork(benchmark::State& state)
+{
+    const int nBlocks = 10000;
+    Consensus::Params params = Params(CBaseChainParams::MAIN).GetConsensus();
+    params.nBlockAlgoNormalisedWorkDecayV2Start = nBlocks / 4;
+    params.nGeometricAverageWork_Start = nBlocks / 2;
+
+    std::vector<CBlockIndex> vIndex;
+    vIndex.reserve(nBlocks);
+    for (int i = 0; i < nBlocks; i++) {
+        CBlockHeader header;
+        header.SetBaseVersion(BLOCK_VERSION_DEFAULT, params.nAuxpowChainId);
+        header.SetAlgo((i * 7 + i / 3) % NUM_ALGOS);
+        header.nTime = params.nTimeArgon2dStart + i * params.nPowTargetSpacing;
+        header.nBits = 0x1b0404cb + (i % 256);
+        vIndex.push_back(CBlockIndex(header));
+    }
+
+    while (state.KeepRunning()) {
+        for (int i = 0; i < nBlocks; i++) {
+            CBlockIndex& index = vIndex[i];
+            index.pprev = i ? &vIndex[i - 1] : NULL;
+            index.nHeight = i;
+            index.BuildSkip();
+            index.nChainWork = (index.pprev ? index.pprev->nChainWork : 0) + GetBlockProof(index, params);
+        }
+    }
+}
+
+BENCHMARK(LoadBlockIndexChainWork);
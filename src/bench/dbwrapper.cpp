@@ -0,0 +1,130 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "coins.h"
+#include "dbwrapper.h"
+#include "random.h"
+#include "uint256.h"
+#include "util.h"
+
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+// Replays the coin database side of block connection: the coins a block
+// spends are looked up and erased, its new outputs are written, and each
+// flush is one CDBWrapper batch, as in CCoinsViewDB::BatchWrite.
+static const size_t INITIAL_COINS = 200000;
+static const size_t SPENDS_PER_FLUSH = 2000;
+static const size_t OUTPUTS_PER_FLUSH = 2500;
+static const size_t DB_CACHE_SIZE = 32 << 20;
+
+namespace {
+
+/** Same key layout as the coin database: 'C', the txid and VARINT(n) */
+struct CoinKey {
+    const COutPoint& outpoint;
+    CoinKey(const COutPoint& outpointIn) : outpoint(outpointIn) {}
+
+    template<typename Stream>
+    void Serialize(Stream &s) const {
+        s << 'C';
+        s << outpoint.hash;
+        s << VARINT(outpoint.n);
+    }
+};
+
+uint256 RandomHash(FastRandomContext& rng)
+{
+    uint256 hash;
+    for (unsigned int i = 0; i < hash.size(); i += 4) {
+        uint32_t n = rng.rand32();
+        memcpy(hash.begin() + i, &n, 4);
+    }
+    return hash;
+}
+
+/** Add n pay-to-pubkey-hash coins of random new transactions to the batch */
+void WriteNewCoins(CDBBatch& batch, FastRandomContext& rng, size_t n, int nHeight, std::vector<COutPoint>& vCoins)
+{
+    COutPoint outpoint;
+    for (size_t i = 0; i < n; i++) {
+        // Transactions have two outputs on average
+        if (i % 2 == 0) {
+            outpoint.hash = RandomHash(rng);
+            outpoint.n = 0;
+        } else {
+            outpoint.n++;
+        }
+        uint256 hashKey = RandomHash(rng);
+        CScript script = CScript() << OP_DUP << OP_HASH160 << std::vector<unsigned char>(hashKey.begin(), hashKey.begin() + 20) << OP_EQUALVERIFY << OP_CHECKSIG;
+        batch.Write(CoinKey(outpoint), Coin(CTxOut(rng.rand32() % (50 * COIN), script), nHeight, false));
+        vCoins.push_back(outpoint);
+    }
+}
+
+void DBWrapperFlush(benchmark::State& state, DBProfile profile)
+{
+    FastRandomContext rng(true);
+    boost::filesystem::path path = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    {
+        CDBWrapper db(path, DB_CACHE_SIZE, false, true, true, profile);
+        std::vector<COutPoint> vCoins;
+        vCoins.reserve(INITIAL_COINS);
+        int nHeight = 0;
+        while (vCoins.size() < INITIAL_COINS) {
+            CDBBatch batch(db);
+            WriteNewCoins(batch, rng, OUTPUTS_PER_FLUSH, nHeight++, vCoins);
+            db.WriteBatch(batch);
+        }
+
+        while (state.KeepRunning()) {
+            CDBBatch batch(db);
+            for (size_t i = 0; i < SPENDS_PER_FLUSH && !vCoins.empty(); i++) {
+                size_t nPos = rng.rand32() % vCoins.size();
+                Coin coin;
+                if (!db.Read(CoinKey(vCoins[nPos]), coin))
+                    assert(!"coin missing from database");
+                batch.Erase(CoinKey(vCoins[nPos]));
+                vCoins[nPos] = vCoins.back();
+                vCoins.pop_back();
+            }
+            WriteNewCoins(batch, rng, OUTPUTS_PER_FLUSH, nHeight++, vCoins);
+            db.WriteBatch(batch);
+        }
+    }
+    boost::filesystem::remove_all(path);
+}
+
+}
+
+static void DBWrapperFlushDefault(benchmark::State& state)
+{
+    DBWrapperFlush(state, DBPROFILE_DEFAULT);
+}
+
+static void DBWrapperFlushFast(benchmark::State& state)
+{
+    DBWrapperFlush(state, DBPROFILE_FAST);
+}
+
+static void DBWrapperFlushCompact(benchmark::State& state)
+{
+    DBWrapperFlush(state, DBPROFILE_COMPACT);
+}
+
+/** The compact profile is only measured in builds with Snappy: without it
+ *  the profile is refused at startup, and the bench would time it uncompressed */
+static bool RegisterDBWrapperFlushCompact()
+{
+    if (!DBCompressionAvailable())
+        return false;
+    benchmark::BenchRunner runner("DBWrapperFlushCompact", DBWrapperFlushCompact);
+    return true;
+}
+
+BENCHMARK(DBWrapperFlushDefault);
+BENCHMARK(DBWrapperFlushFast);
+static const bool fDBWrapperFlushCompact = RegisterDBWrapperFlushCompact();
@@ -0,0 +1,151 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "arith_uint256.h"
+#include "chainparams.h"
+#include "crypto/hashlanes.h"
+#include "validation.h"
+#include "primitives/block.h"
+
+#include <vector>
+
+// Hash a single pure header with the PoW function that applies to the given
+// algo slot at the given time. nTime selects the activation era, so the same
+// slot measures e.g. Blake before nTimeLyra2RE2Start and Lyra2RE2 after it.
+
+static CPureBlockHeader MakeBenchHeader(int algo, uint32_t nTime)
+{
+    CPureBlockHeader header;
+    header.nVersion = BLOCK_VERSION_DEFAULT;
+    header.SetAlgo(algo);
+    header.hashPrevBlock = uint256S("0000000000000a3290f20e75860d505ce0e948a1d1d846bec7e39015d242884b");
+    header.hashMerkleRoot = uint256S("f5b9e36a2de6fe0e4bfdd0ed25b33e8c1e8e2b0e4a2c5d4ec8d9d6bb3a7e5c1a");
+    header.nTime = nTime;
+    header.nBits = 0x1e0fffff;
+    header.nNonce = 0;
+    return header;
+}
+
+static void PoWHashBench(benchmark::State& state, int algo, uint32_t nTime)
+{
+    const Consensus::Params& params = Params(CBaseChainParams::MAIN).GetConsensus();
+    CPureBlockHeader header = MakeBenchHeader(algo, nTime);
+    while (state.KeepRunning()) {
+        header.GetPoWHash(algo, params);
+        header.nNonce++;
+    }
+}
+
+static void PoWHash_Blake(benchmark::State& state)
+{
+    const Consensus::Params& params = Params(CBaseChainParams::MAIN).GetConsensus();
+    PoWHashBench(state, ALGO_SLOT1, params.nTimeLyra2RE2Start - 1);
+}
+
+static void PoWHash_Lyra2RE2(benchmark::State& state)
+{
+    const Consensus::Params& params = Params(CBaseChainParams::MAIN).GetConsensus();
+    PoWHashBench(state, ALGO_SLOT1, params.nTimeLyra2RE2Start);
+}
+
+static void PoWHash_Skein(benchmark::State& state)
+{
+    const Consensus::Params& params = Params(CBaseChainParams::MAIN).GetConsensus();
+    PoWHashBench(state, ALGO_SLOT2, params.nTimeArgon2dStart);
+}
+
+static void PoWHash_Qubit(benchmark::State& state)
+{
+    const Consensus::Params& params = Params(CBaseChainParams::MAIN).GetConsensus();
+    PoWHashBench(state, ALGO_SLOT3, params.nTimeArgon2dStart - 1);
+}
+
+static void PoWHash_Argon2d(benchmark::State& state)
+{
+    const Consensus::Params& params = Params(CBaseChainParams::MAIN).GetConsensus();
+    PoWHashBench(state, ALGO_SLOT3, params.nTimeArgon2dStart);
+}
+
+static void PoWHash_Yescrypt(benchmark::State& state)
+{
+    const Consensus::Params& params = Params(CBaseChainParams::MAIN).GetConsensus();
+    PoWHashBench(state, ALGO_SLOT4, params.nTimeArgon2dStart);
+}
+
+static void PoWHash_X11(benchmark::State& state)
+{
+    const Consensus::Params& params = Params(CBaseChainParams::MAIN).GetConsensus();
+    PoWHashBench(state, ALGO_SLOT5, params.nTimeArgon2dStart);
+}
+
+// Hash HASH_LANES pure headers at once with GetPoWHashes, as the miner and
+// header batch verification do. Compare per header with the benchmarks above.
+static void PoWHashBatchBench(benchmark::State& state, int algo, uint32_t nTime)
+{
+    const Consensus::Params& params = Params(CBaseChainParams::MAIN).GetConsensus();
+    std::vector<CPureBlockHeader> vHeaders(HASH_LANES, MakeBenchHeader(algo, nTime));
+    std::vector<const CPureBlockHeader*> vpHeaders;
+    for (size_t i = 0; i < HASH_LANES; i++) {
+        vHeaders[i].nNonce = i;
+        vpHeaders.push_back(&vHeaders[i]);
+    }
+    std::vector<uint256> vHashes(HASH_LANES);
+    while (state.KeepRunning()) {
+        GetPoWHashes(vpHeaders.data(), HASH_LANES, algo, params, vHashes.data());
+        for (CPureBlockHeader& header : vHeaders)
+            header.nNonce += HASH_LANES;
+    }
+}
+
+static void PoWHash_QubitBatch(benchmark::State& state)
+{
+    const Consensus::Params& params = Params(CBaseChainParams::MAIN).GetConsensus();
+    PoWHashBatchBench(state, ALGO_SLOT3, params.nTimeArgon2dStart - 1);
+}
+
+static void PoWHash_X11Batch(benchmark::State& state)
+{
+    const Consensus::Params& params = Params(CBaseChainParams::MAIN).GetConsensus();
+    PoWHashBatchBench(state, ALGO_SLOT5, params.nTimeArgon2dStart);
+}
+
+// Header validation over a chain segment that rotates through all five algo
+// slots, as seen during headers-first sync of the current chain. Most headers
+// will not meet their target; the cost of interest is computing the PoW hash.
+static void PoWCheckMixedHeaders(benchmark::State& state)
+{
+    const Consensus::Params& params = Params(CBaseChainParams::MAIN).GetConsensus();
+
+    std::vector<CBlockHeader> vHeaders;
+    for (int i = 0; i < NUM_ALGOS * 2; i++) {
+        CBlockHeader header;
+        header.SetBaseVersion(BLOCK_VERSION_DEFAULT, params.nAuxpowChainId);
+        header.SetAlgo(i % NUM_ALGOS);
+        header.hashMerkleRoot = uint256S("f5b9e36a2de6fe0e4bfdd0ed25b33e8c1e8e2b0e4a2c5d4ec8d9d6bb3a7e5c1a");
+        header.nTime = params.nTimeArgon2dStart + i * params.nPowTargetSpacing;
+        header.nBits = UintToArith256(params.powLimit[i % NUM_ALGOS]).GetCompact();
+        header.nNonce = i;
+        vHeaders.push_back(header);
+    }
+
+    while (state.KeepRunning()) {
+        for (CBlockHeader& header : vHeaders) {
+            CheckProofOfWork(header, params);
+            header.nNonce += vHeaders.size();
+        }
+    }
+}
+
+BENCHMARK(PoWHash_Blake);
+BENCHMARK(PoWHash_Lyra2RE2);
+BENCHMARK(PoWHash_Skein);
+BENCHMARK(PoWHash_Qubit);
+BENCHMARK(PoWHash_Argon2d);
+BENCHMARK(PoWHash_Yescrypt);
+BENCHMARK(PoWHash_X11);
+BENCHMARK(PoWHash_QubitBatch);
+BENCHMARK(PoWHash_X11Batch);
+BENCHMARK(PoWCheckMixedHeaders);
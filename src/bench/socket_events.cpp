@@ -0,0 +1,179 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "compat.h"
+#include "netbase.h"
+#include "util.h"
+
+#ifndef WIN32
+
+#include <vector>
+
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
+
+// Per-message cost of waiting for socket readiness, as seen by the socket
+// handler thread, over a growing number of idle loopback TCP connections.
+// Each iteration sends one byte over a different connection and waits for
+// the accepted end to become readable; with select() the wait costs
+// O(connections), with epoll it should stay flat.
+
+namespace {
+
+struct LoopbackConnections
+{
+    std::vector<SOCKET> vClient;
+    std::vector<SOCKET> vServer;
+
+    explicit LoopbackConnections(size_t nConnections)
+    {
+        RaiseFileDescriptorLimit(2 * nConnections + 64);
+
+        SOCKET hListen = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = 0;
+        socklen_t len = sizeof(addr);
+        if (hListen == INVALID_SOCKET ||
+            bind(hListen, (struct sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR ||
+            listen(hListen, SOMAXCONN) == SOCKET_ERROR ||
+            getsockname(hListen, (struct sockaddr*)&addr, &len) == SOCKET_ERROR) {
+            CloseSocket(hListen);
+            return;
+        }
+
+        const int one = 1;
+        for (size_t i = 0; i < nConnections; i++) {
+            SOCKET hClient = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+            if (hClient == INVALID_SOCKET)
+                break;
+            if (connect(hClient, (struct sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR) {
+                CloseSocket(hClient);
+                break;
+            }
+            SOCKET hServer = accept(hListen, NULL, NULL);
+            if (hServer == INVALID_SOCKET) {
+                CloseSocket(hClient);
+                break;
+            }
+            setsockopt(hClient, IPPROTO_TCP, TCP_NODELAY, (const char*)&one, sizeof(one));
+            fcntl(hServer, F_SETFL, fcntl(hServer, F_GETFL, 0) | O_NONBLOCK);
+            vClient.push_back(hClient);
+            vServer.push_back(hServer);
+        }
+        CloseSocket(hListen);
+    }
+
+    ~LoopbackConnections()
+    {
+        for (SOCKET& hSocket : vClient)
+            CloseSocket(hSocket);
+        for (SOCKET& hSocket : vServer)
+            CloseSocket(hSocket);
+    }
+};
+
+void SocketEventsSelect(benchmark::State& state, size_t nConnections)
+{
+    LoopbackConnections conns(nConnections);
+    for (SOCKET hSocket : conns.vServer)
+        if (!IsSelectableSocket(hSocket))
+            return;
+    size_t nSize = conns.vServer.size();
+    if (nSize == 0)
+        return;
+
+    size_t n = 0;
+    char ch = 0;
+    while (state.KeepRunning()) {
+        send(conns.vClient[n % nSize], &ch, 1, MSG_NOSIGNAL);
+        bool fReceived = false;
+        while (!fReceived) {
+            // Same work as the select() socket handler: rebuild the set, wait, then scan it
+            fd_set fdsetRecv;
+            FD_ZERO(&fdsetRecv);
+            SOCKET hSocketMax = 0;
+            for (SOCKET hSocket : conns.vServer) {
+                FD_SET(hSocket, &fdsetRecv);
+                hSocketMax = std::max(hSocketMax, hSocket);
+            }
+            struct timeval timeout = {0, 50000};
+            if (select(hSocketMax + 1, &fdsetRecv, NULL, NULL, &timeout) <= 0)
+                continue;
+            for (SOCKET hSocket : conns.vServer) {
+                if (FD_ISSET(hSocket, &fdsetRecv) && recv(hSocket, &ch, 1, MSG_DONTWAIT) == 1)
+                    fReceived = true;
+            }
+        }
+        n++;
+    }
+}
+
+#ifdef HAVE_SYS_EPOLL_H
+void SocketEventsEpoll(benchmark::State& state, size_t nConnections)
+{
+    LoopbackConnections conns(nConnections);
+    size_t nSize = conns.vServer.size();
+    if (nSize == 0)
+        return;
+
+    int epollfd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollfd == -1)
+        return;
+    for (size_t i = 0; i < nSize; i++) {
+        struct epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN | EPOLLET;
+        event.data.u64 = i;
+        epoll_ctl(epollfd, EPOLL_CTL_ADD, conns.vServer[i], &event);
+    }
+
+    size_t n = 0;
+    char ch = 0;
+    struct epoll_event events[64];
+    while (state.KeepRunning()) {
+        send(conns.vClient[n % nSize], &ch, 1, MSG_NOSIGNAL);
+        bool fReceived = false;
+        while (!fReceived) {
+            int nEvents = epoll_wait(epollfd, events, 64, 50);
+            for (int i = 0; i < nEvents; i++) {
+                if (recv(conns.vServer[events[i].data.u64], &ch, 1, MSG_DONTWAIT) == 1)
+                    fReceived = true;
+            }
+        }
+        n++;
+    }
+    close(epollfd);
+}
+#endif
+
+} // namespace
+
+static void SocketEventsSelect_100(benchmark::State& state) { SocketEventsSelect(state, 100); }
+static void SocketEventsSelect_400(benchmark::State& state) { SocketEventsSelect(state, 400); }
+
+BENCHMARK(SocketEventsSelect_100);
+BENCHMARK(SocketEventsSelect_400);
+
+#ifdef HAVE_SYS_EPOLL_H
+static void SocketEventsEpoll_100(benchmark::State& state) { SocketEventsEpoll(state, 100); }
+static void SocketEventsEpoll_400(benchmark::State& state) { SocketEventsEpoll(state, 400); }
+static void SocketEventsEpoll_4000(benchmark::State& state) { SocketEventsEpoll(state, 4000); }
+
+BENCHMARK(SocketEventsEpoll_100);
+BENCHMARK(SocketEventsEpoll_400);
+BENCHMARK(SocketEventsEpoll_4000);
+#endif
+
+#endif // WIN32
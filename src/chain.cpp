@@ -6,7 +6,6 @@
 #include "chain.h"
 #include "chainparams.h"
 #include "validation.h"
-#include "bignum.h"
 
 /* Moved here from the header, because we need auxpow and the logic
    becomes more involved.  */
@@ -17,12 +16,17 @@ CBlockHeader CBlockIndex::GetBlockHeader(const Consensus::Params& consensusParam
     block.nVersion       = nVersion;
 
     /* The CBlockIndex object's block header is missing the auxpow.
-       So if this is an auxpow block, read it from disk instead.  We only
-       have to read the actual *header*, not the full block.  */
+       So if this is an auxpow block and the auxpow is not kept in memory,
+       read it from disk instead.  We only have to read the actual *header*,
+       not the full block.  */
     if (block.IsAuxpow())
     {
-        ReadBlockHeaderFromDisk(block, this, consensusParams);
-        return block;
+        if (!pauxpow)
+        {
+            ReadBlockHeaderFromDisk(block, this, consensusParams);
+            return block;
+        }
+        block.auxpow = pauxpow;
     }
 
     if (pprev)
@@ -34,6 +38,18 @@ CBlockHeader CBlockIndex::GetBlockHeader(const Consensus::Params& consensusParam
     return block;
 }
 
+uint256 CBlockIndex::GetBlockPoWHash(const Consensus::Params& consensusParams) const
+{
+    if (!hashPoW.IsNull())
+        return hashPoW;
+
+    CBlockHeader block = GetBlockHeader(consensusParams);
+    int algo = block.GetAlgo();
+    if (block.auxpow)
+        return block.auxpow->getParentBlockPoWHash(algo, consensusParams);
+    return block.GetPoWHash(algo, consensusParams);
+}
+
 /**
  * CChain implementation
  */
@@ -142,8 +158,11 @@ const CBlockIndex* CBlockIndex::GetAncestor(int height) const
 
 void CBlockIndex::BuildSkip()
 {
-    if (pprev)
+    if (pprev) {
         pskip = pprev->GetAncestor(GetSkipHeight(nHeight));
+        for (int algo = 0; algo < NUM_ALGOS; algo++)
+            pprevAlgo[algo] = const_cast<CBlockIndex*>(GetLastBlockIndexForAlgo(pprev, algo));
+    }
 }
 
 arith_uint256 GetBlockProofBase(const CBlockIndex& block)
@@ -161,135 +180,96 @@ arith_uint256 GetBlockProofBase(const CBlockIndex& block)
     return (~bnTarget / (bnTarget + 1)) + 1;
 }
 
-arith_uint256 GetPrevWorkForAlgo(const CBlockIndex& block, int algo)
+arith_uint256 GetPrevWorkForAlgo(const CBlockIndex& block, int algo, const Consensus::Params& params)
 {
-    const CBlockIndex* pindex = &block;
-    while (pindex != NULL)
-    {
-        if (pindex->GetAlgo() == algo)
-        {
-            return GetBlockProofBase(*pindex);
-        }
-        pindex = pindex->pprev;
-    }
-    return UintToArith256(Params().GetConsensus().powLimit[algo]);
+    const CBlockIndex* pindex = GetLastBlockIndexForAlgo(&block, algo);
+    if (pindex != NULL)
+        return GetBlockProofBase(*pindex);
+    return UintToArith256(params.powLimit[algo]);
 }
 
-arith_uint256 GetPrevWorkForAlgoWithDecayV1(const CBlockIndex& block, int algo)
+arith_uint256 GetPrevWorkForAlgoWithDecayV1(const CBlockIndex& block, int algo, const Consensus::Params& params)
 {
-    int nDistance = 0;
-    arith_uint256 nWork;
-    const CBlockIndex* pindex = &block;
-    pindex = pindex->pprev;
-    while (pindex != NULL)
-    {
-        if (nDistance > 32)
-        {
-            return UintToArith256(Params().GetConsensus().powLimit[algo]);
-        }
-        if (pindex->GetAlgo() == algo)
-        {
-            arith_uint256 nWork = GetBlockProofBase(*pindex);
-            nWork *= (32 - nDistance);
-            nWork /= 32;
-            if (nWork < UintToArith256(Params().GetConsensus().powLimit[algo]))
-                nWork = UintToArith256(Params().GetConsensus().powLimit[algo]);
-            return nWork;
-        }
-        pindex = pindex->pprev;
-        nDistance++;
-    }
-    return UintToArith256(Params().GetConsensus().powLimit[algo]);
+    const CBlockIndex* pindex = GetLastBlockIndexForAlgo(block.pprev, algo);
+    if (pindex == NULL)
+        return UintToArith256(params.powLimit[algo]);
+    int nDistance = block.nHeight - 1 - pindex->nHeight;
+    if (nDistance > 32)
+        return UintToArith256(params.powLimit[algo]);
+
+    arith_uint256 nWork = GetBlockProofBase(*pindex);
+    nWork *= (32 - nDistance);
+    nWork /= 32;
+    if (nWork < UintToArith256(params.powLimit[algo]))
+        nWork = UintToArith256(params.powLimit[algo]);
+    return nWork;
 }
 
-arith_uint256 GetPrevWorkForAlgoWithDecayV2(const CBlockIndex& block, int algo)
+arith_uint256 GetPrevWorkForAlgoWithDecayV2(const CBlockIndex& block, int algo, const Consensus::Params& params)
 {
-    int nDistance = 0;
-    arith_uint256 nWork;
-    const CBlockIndex* pindex = &block;
-    pindex = pindex->pprev;
-    while (pindex != NULL)
-    {
-        if (nDistance > 32)
-        {
-            return arith_uint256(0);
-        }
-        if (pindex->GetAlgo() == algo)
-        {
-            arith_uint256 nWork = GetBlockProofBase(*pindex);
-            nWork *= (32 - nDistance);
-            nWork /= 32;
-            return nWork;
-        }
-        pindex = pindex->pprev;
-        nDistance++;
-    }
-    return arith_uint256(0);
+    const CBlockIndex* pindex = GetLastBlockIndexForAlgo(block.pprev, algo);
+    if (pindex == NULL)
+        return arith_uint256(0);
+    int nDistance = block.nHeight - 1 - pindex->nHeight;
+    if (nDistance > 32)
+        return arith_uint256(0);
+
+    arith_uint256 nWork = GetBlockProofBase(*pindex);
+    nWork *= (32 - nDistance);
+    nWork /= 32;
+    return nWork;
 }
 
-arith_uint256 GetPrevWorkForAlgoWithDecayV3(const CBlockIndex& block, int algo)
+arith_uint256 GetPrevWorkForAlgoWithDecayV3(const CBlockIndex& block, int algo, const Consensus::Params& params)
 {
-    int nDistance = 0;
-    arith_uint256 nWork;
-    const CBlockIndex* pindex = &block;
-    pindex = pindex->pprev;
-    while (pindex != NULL)
-    {
-        if (nDistance > 100)
-        {
-            return arith_uint256(0);
-        }
-        if (pindex->GetAlgo() == algo)
-        {
-            arith_uint256 nWork = GetBlockProofBase(*pindex);
-            nWork *= (100 - nDistance);
-            nWork /= 100;
-            return nWork;
-        }
-        pindex = pindex->pprev;
-        nDistance++;
-    }
-    return arith_uint256(0);
+    const CBlockIndex* pindex = GetLastBlockIndexForAlgo(block.pprev, algo);
+    if (pindex == NULL)
+        return arith_uint256(0);
+    int nDistance = block.nHeight - 1 - pindex->nHeight;
+    if (nDistance > 100)
+        return arith_uint256(0);
+
+    arith_uint256 nWork = GetBlockProofBase(*pindex);
+    nWork *= (100 - nDistance);
+    nWork /= 100;
+    return nWork;
 }
 
-arith_uint256 GetGeometricMeanPrevWork(const CBlockIndex& block)
+arith_uint256 GetGeometricMeanPrevWork(const CBlockIndex& block, const Consensus::Params& params)
 {
-    //arith_uint256 bnRes;
-    arith_uint256 nBlockWork = GetBlockProofBase(block);
-    CBigNum bnBlockWork = CBigNum(ArithToUint256(nBlockWork));
+    static_assert(NUM_ALGOS <= MAX_PRODUCT_NTHROOT_VALUES, "too many algos for GetProductNthRoot");
+    arith_uint256 vBlockWork[NUM_ALGOS];
+    unsigned int nBlockWork = 0;
+    vBlockWork[nBlockWork++] = GetBlockProofBase(block);
     int nAlgo = block.GetAlgo();
     
     for (int algo = 0; algo < NUM_ALGOS; algo++)
     {
         if (algo != nAlgo)
         {
-            arith_uint256 nBlockWorkAlt = GetPrevWorkForAlgoWithDecayV3(block, algo);
-            CBigNum bnBlockWorkAlt = CBigNum(ArithToUint256(nBlockWorkAlt));
-            if (bnBlockWorkAlt != 0)
-                bnBlockWork *= bnBlockWorkAlt;
+            arith_uint256 nBlockWorkAlt = GetPrevWorkForAlgoWithDecayV3(block, algo, params);
+            if (nBlockWorkAlt != 0)
+                vBlockWork[nBlockWork++] = nBlockWorkAlt;
         }
     }
     // Compute the geometric mean
-    CBigNum bnRes = bnBlockWork.nthRoot(NUM_ALGOS);
+    arith_uint256 bnRes = GetProductNthRoot(vBlockWork, nBlockWork, NUM_ALGOS);
     
     // Scale to roughly match the old work calculation
     bnRes <<= 8;
     
-    //return bnRes;
-    return UintToArith256(bnRes.getuint256());
+    return bnRes;
 }
 
-arith_uint256 GetBlockProof(const CBlockIndex& block)
+arith_uint256 GetBlockProof(const CBlockIndex& block, const Consensus::Params& params)
 {
-    Consensus::Params params = Params().GetConsensus();
-
     arith_uint256 bnTarget;
     int nHeight = block.nHeight;
     int nAlgo = block.GetAlgo();
 
     if (nHeight > params.nGeometricAverageWork_Start)
     {
-        bnTarget = GetGeometricMeanPrevWork(block);
+        bnTarget = GetGeometricMeanPrevWork(block, params);
     }
     else
     {
@@ -300,11 +280,11 @@ arith_uint256 GetBlockProof(const CBlockIndex& block)
             {
                 if(nHeight >= params.nBlockAlgoNormalisedWorkDecayV2Start)
                 {
-                    nBlockWork += GetPrevWorkForAlgoWithDecayV2(block, algo);
+                    nBlockWork += GetPrevWorkForAlgoWithDecayV2(block, algo, params);
                 }
                 else
                 {
-                    nBlockWork += GetPrevWorkForAlgoWithDecayV1(block, algo);
+                    nBlockWork += GetPrevWorkForAlgoWithDecayV1(block, algo, params);
                 }
             }
         }
@@ -324,7 +304,7 @@ int64_t GetBlockProofEquivalentTime(const CBlockIndex& to, const CBlockIndex& fr
         r = from.nChainWork - to.nChainWork;
         sign = -1;
     }
-    r = r * arith_uint256(params.nPowTargetSpacing) / GetBlockProof(tip);
+    r = r * arith_uint256(params.nPowTargetSpacing) / GetBlockProof(tip, params);
     if (r.bits() > 63) {
         return sign * std::numeric_limits<int64_t>::max();
     }
@@ -339,6 +319,9 @@ const CBlockIndex* GetLastBlockIndexForAlgo(const CBlockIndex* pindex, int algo)
             return NULL;
         if (pindex->GetAlgo() == algo)
             return pindex;
+        // Use the O(1) per-algo pointer once BuildSkip has been run for this entry.
+        if (pindex->pskip)
+            return pindex->pprevAlgo[algo];
         pindex = pindex->pprev;
     }
 }
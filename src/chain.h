@@ -166,6 +166,9 @@ public:
     //! pointer to the index of some further predecessor of this block
     CBlockIndex* pskip;
 
+    //! pointers to the index of the last predecessor of this block mined with each algo
+    CBlockIndex* pprevAlgo[NUM_ALGOS];
+
     //! height of the entry in the chain. The genesis block has height 0
     int nHeight;
 
@@ -200,6 +203,13 @@ public:
     unsigned int nBits;
     unsigned int nNonce;
 
+    //! PoW hash of the block header (of the parent block for auxpow blocks), set once the
+    //! proof of work has been validated. Null if not known yet.
+    uint256 hashPoW;
+
+    //! (memory only) auxpow of the block header, only kept for recently accepted headers
+    boost::shared_ptr<CAuxPow> pauxpow;
+
     //! (memory only) Sequential id assigned to distinguish order in which blocks are received.
     int32_t nSequenceId;
 
@@ -211,6 +221,8 @@ public:
         phashBlock = NULL;
         pprev = NULL;
         pskip = NULL;
+        for (int algo = 0; algo < NUM_ALGOS; algo++)
+            pprevAlgo[algo] = NULL;
         nHeight = 0;
         nFile = 0;
         nDataPos = 0;
@@ -227,6 +239,8 @@ public:
         nTime          = 0;
         nBits          = 0;
         nNonce         = 0;
+        hashPoW        = uint256();
+        pauxpow.reset();
     }
 
     CBlockIndex()
@@ -270,12 +284,7 @@ public:
         return *phashBlock;
     }
 
-    uint256 GetBlockPoWHash(const Consensus::Params& consensusParams) const
-    {
-        CBlockHeader block = GetBlockHeader(consensusParams);
-        int algo = block.GetAlgo();
-        return block.GetPoWHash(algo, consensusParams);
-    }
+    uint256 GetBlockPoWHash(const Consensus::Params& consensusParams) const;
     
     int GetAlgo() const
     {
@@ -339,7 +348,7 @@ public:
         return false;
     }
 
-    //! Build the skiplist pointer for this entry.
+    //! Build the skiplist pointer and the per-algo predecessor pointers for this entry.
     void BuildSkip();
 
     //! Efficiently find an ancestor of this block.
@@ -354,7 +363,8 @@ public:
 
 };
 
-arith_uint256 GetBlockProof(const CBlockIndex& block);
+/** Return the work credited to block, which depends on the work of recent blocks of the other algos. */
+arith_uint256 GetBlockProof(const CBlockIndex& block, const Consensus::Params& params);
 /** Return the time it would take to redo the work difference between from and to, assuming the current hashrate corresponds to the difficulty at tip, in seconds. */
 int64_t GetBlockProofEquivalentTime(const CBlockIndex& to, const CBlockIndex& from, const CBlockIndex& tip, const Consensus::Params&);
 /** Return the index to the last block of algo */
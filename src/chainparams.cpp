@@ -333,6 +333,12 @@ public:
         
         consensus.fPowAllowMinDifficultyBlocks = true;
         consensus.fPowNoRetargeting = true;
+
+        consensus.nBlockSequentialAlgoMaxCountV1 = 100000; // tests mine long runs of one algo
+        consensus.nBlockSequentialAlgoMaxCountV2 = 100000; // V2 applies from nBlockSequentialAlgoRule2Start
+        consensus.nBlockSequentialAlgoRule2Start = 0;
+        consensus.nBlockAlgoNormalisedWorkDecayV2Start = 0;
+        consensus.nGeometricAverageWork_Start = 0;    // the decay calculations overflow or round to zero at powLimit
         consensus.nRuleChangeActivationThreshold = 108; // 75% for testchains
         consensus.nMinerConfirmationWindow = 144; // Faster than normal for regtest (144 instead of 2016)
         consensus.vDeployments[Consensus::DEPLOYMENT_TESTDUMMY].bit = 28;
@@ -0,0 +1,75 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "crypto/hashX11.h"
+
+#include "crypto/hashlanes.h"
+
+#include <algorithm>
+
+void HashX11Batch(const unsigned char* const* ppdata, size_t nLen, uint256* phash, size_t nCount)
+{
+    sph_blake512_context     ctx_blake;
+    sph_bmw512_context       ctx_bmw;
+    sph_groestl512_context   ctx_groestl;
+    sph_skein512_context     ctx_skein;
+    sph_keccak512_context    ctx_keccak;
+    sph_shavite512_context   ctx_shavite;
+    sph_simd512_context      ctx_simd;
+    sph_echo512_context      ctx_echo;
+
+    uint512 hash[HASH_LANES];
+    const unsigned char* pphash[HASH_LANES];
+    for (size_t i = 0; i < HASH_LANES; i++)
+        pphash[i] = hash[i].begin();
+
+    for (size_t nStart = 0; nStart < nCount; nStart += HASH_LANES) {
+        const size_t n = std::min(HASH_LANES, nCount - nStart);
+
+        for (size_t i = 0; i < n; i++) {
+            sph_blake512_init(&ctx_blake);
+            sph_blake512(&ctx_blake, ppdata[nStart + i], nLen);
+            sph_blake512_close(&ctx_blake, hash[i].begin());
+
+            sph_bmw512_init(&ctx_bmw);
+            sph_bmw512(&ctx_bmw, hash[i].begin(), 64);
+            sph_bmw512_close(&ctx_bmw, hash[i].begin());
+
+            sph_groestl512_init(&ctx_groestl);
+            sph_groestl512(&ctx_groestl, hash[i].begin(), 64);
+            sph_groestl512_close(&ctx_groestl, hash[i].begin());
+
+            sph_skein512_init(&ctx_skein);
+            sph_skein512(&ctx_skein, hash[i].begin(), 64);
+            sph_skein512_close(&ctx_skein, hash[i].begin());
+        }
+
+        JH512Lanes(pphash, 64, hash, n);
+
+        for (size_t i = 0; i < n; i++) {
+            sph_keccak512_init(&ctx_keccak);
+            sph_keccak512(&ctx_keccak, hash[i].begin(), 64);
+            sph_keccak512_close(&ctx_keccak, hash[i].begin());
+        }
+
+        Luffa512Lanes(pphash, 64, hash, n);
+        CubeHash512Lanes(pphash, 64, hash, n);
+
+        for (size_t i = 0; i < n; i++) {
+            sph_shavite512_init(&ctx_shavite);
+            sph_shavite512(&ctx_shavite, hash[i].begin(), 64);
+            sph_shavite512_close(&ctx_shavite, hash[i].begin());
+
+            sph_simd512_init(&ctx_simd);
+            sph_simd512(&ctx_simd, hash[i].begin(), 64);
+            sph_simd512_close(&ctx_simd, hash[i].begin());
+
+            sph_echo512_init(&ctx_echo);
+            sph_echo512(&ctx_echo, hash[i].begin(), 64);
+            sph_echo512_close(&ctx_echo, hash[i].begin());
+
+            phash[nStart + i] = hash[i].trim256();
+        }
+    }
+}
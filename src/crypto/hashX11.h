@@ -134,4 +134,12 @@ inline uint256 HashX11(const T1 pbegin, const T1 pend)
 
 
 
+/**
+ * X11 hash of nCount inputs of nLen bytes each, at ppdata[0] to
+ * ppdata[nCount - 1], as HashX11 computes it. The inputs go through the
+ * chain HASH_LANES at a time, so that the JH, Luffa and CubeHash stages hash
+ * them together in SIMD lanes.
+ */
+void HashX11Batch(const unsigned char* const* ppdata, size_t nLen, uint256* phash, size_t nCount);
+
 #endif // HASHBLOCK_H
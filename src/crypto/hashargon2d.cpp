@@ -0,0 +1,137 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "crypto/hashargon2d.h"
+
+#if defined(HAVE_CONFIG_H)
+#include "config/bitcoin-config.h"
+#endif
+
+#ifndef WIN32
+#include <sys/mman.h> // for mmap
+#endif
+#include <new>
+#include <stdexcept>
+#include <stdlib.h>
+#include <string>
+
+namespace {
+
+/**
+ * Scratch memory for the Argon2d block matrix. It is kept per thread and
+ * reused for every hash, instead of mapping, faulting in and unmapping 4 MB
+ * for each header. Huge pages are used when the system has them reserved
+ * (or, failing that, advised for transparent huge pages).
+ */
+class Argon2dArena
+{
+private:
+    uint8_t* pbase;
+    size_t nSize;
+    bool fMapped;
+
+    void Release()
+    {
+        if (!pbase)
+            return;
+#ifndef WIN32
+        if (fMapped)
+            munmap(pbase, nSize);
+        else
+#endif
+            free(pbase);
+        pbase = NULL;
+        nSize = 0;
+        fMapped = false;
+    }
+
+public:
+    Argon2dArena() : pbase(NULL), nSize(0), fMapped(false) {}
+    ~Argon2dArena() { Release(); }
+
+    uint8_t* Get(size_t nBytes)
+    {
+        if (nBytes <= nSize)
+            return pbase;
+        Release();
+#if !defined(WIN32) && defined(MAP_ANONYMOUS)
+        void* p = MAP_FAILED;
+#ifdef MAP_HUGETLB
+        static const size_t HUGEPAGE_SIZE = 2 * 1024 * 1024;
+        size_t nHugeSize = (nBytes + HUGEPAGE_SIZE - 1) & ~(HUGEPAGE_SIZE - 1);
+        p = mmap(NULL, nHugeSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p != MAP_FAILED)
+            nBytes = nHugeSize;
+#endif
+        if (p == MAP_FAILED) {
+            p = mmap(NULL, nBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+#ifdef MADV_HUGEPAGE
+            if (p != MAP_FAILED)
+                madvise(p, nBytes, MADV_HUGEPAGE);
+#endif
+        }
+        if (p != MAP_FAILED) {
+            pbase = (uint8_t*)p;
+            nSize = nBytes;
+            fMapped = true;
+            return pbase;
+        }
+#endif
+        pbase = (uint8_t*)malloc(nBytes);
+        nSize = pbase ? nBytes : 0;
+        return pbase;
+    }
+};
+
+thread_local Argon2dArena arena;
+
+int AllocateFromArena(uint8_t** memory, size_t bytes_to_allocate)
+{
+    *memory = arena.Get(bytes_to_allocate);
+    return *memory ? ARGON2_OK : ARGON2_MEMORY_ALLOCATION_ERROR;
+}
+
+void ReturnToArena(uint8_t* memory, size_t bytes_to_allocate)
+{
+    // Kept for the next hash on this thread, freed when the thread exits.
+}
+
+} // anon namespace
+
+uint256 Argon2dPoWHash(const unsigned char* pdata, size_t nLen)
+{
+    static unsigned char pblank[1];
+    unsigned char* pinput = nLen ? const_cast<unsigned char*>(pdata) : pblank;
+
+    uint256 hash;
+    argon2_context context;
+    context.out = hash.begin();
+    context.outlen = hash.size();
+    context.pwd = pinput;
+    context.pwdlen = nLen;
+    context.salt = pinput;
+    context.saltlen = nLen;
+    context.secret = NULL;
+    context.secretlen = 0;
+    context.ad = NULL;
+    context.adlen = 0;
+    context.t_cost = 1; // 1 iteration
+    context.m_cost = 4096; // use 4MB
+    context.lanes = 1; // 1 thread, 1 lane
+    context.threads = 1;
+    context.version = ARGON2_VERSION_NUMBER;
+    context.allocate_cbk = AllocateFromArena;
+    context.free_cbk = ReturnToArena;
+    // The inputs are public block headers, so there is nothing secret to
+    // wipe from the block matrix; Argon2 would otherwise overwrite all 4 MB
+    // after every hash. Other Argon2 users still get their memory wiped.
+    context.flags = ARGON2_FLAG_KEEP_MEMORY;
+
+    int ret = argon2_ctx(&context, Argon2_d);
+    if (ret == ARGON2_MEMORY_ALLOCATION_ERROR)
+        throw std::bad_alloc();
+    if (ret != ARGON2_OK)
+        throw std::runtime_error(std::string("Argon2d PoW hash failed: ") + argon2_error_message(ret));
+    return hash;
+}
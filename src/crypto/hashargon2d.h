@@ -12,23 +12,17 @@
 
 #include <vector>
 
+/**
+ * Argon2d PoW hash (1 pass over 4 MB, 1 lane) of nLen bytes at pdata, using
+ * the data as both password and salt. The block matrix lives in a per-thread
+ * arena that is reused across calls.
+ */
+uint256 Argon2dPoWHash(const unsigned char* pdata, size_t nLen);
+
 template<typename T1>
 inline uint256 HashArgon2d(const T1 pbegin, const T1 pend)
 {
-    uint32_t t_cost = 1; // 1 iteration
-    uint32_t m_cost = 4096; // use 4MB
-    uint32_t parallelism = 1; // 1 thread, 2 lanes
-    
-    static unsigned char pblank[1];
-    size_t pwdlen = (pend - pbegin) * sizeof(pbegin[0]);
-    
-    uint256 hash;
-    size_t hashlen = 32;
-    
-    argon2d_hash_raw(t_cost, m_cost, parallelism, (pbegin == pend ? pblank : (unsigned char*)&pbegin[0]), pwdlen,
-                    (pbegin == pend ? pblank : (unsigned char*)&pbegin[0]), pwdlen, (unsigned char*)&hash, hashlen);
-    
-    return hash;
+    return Argon2dPoWHash((const unsigned char*)&pbegin[0], (pend - pbegin) * sizeof(pbegin[0]));
 }
 
 #endif
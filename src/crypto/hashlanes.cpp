@@ -0,0 +1,701 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "crypto/hashlanes.h"
+
+#include "crypto/common.h"
+#include "crypto/sha3/sph_cubehash.h"
+#include "crypto/sha3/sph_jh.h"
+#include "crypto/sha3/sph_luffa.h"
+
+#include <string.h>
+
+// The kernels below keep word i of every lane in element l of a GCC/Clang
+// generic vector, so the round functions read like the scalar reference code
+// while each operation works on HASH_LANES inputs. They are compiled once for
+// the baseline instruction set, which is SSE2 on x86-64, and once more for
+// AVX2, picked at runtime. Compilers without generic vectors use the sph code.
+#if defined(__GNUC__)
+#define ENABLE_HASH_LANES
+#if defined(__x86_64__) || defined(__i386__)
+#define ENABLE_HASH_LANES_AVX2
+#endif
+#endif
+
+namespace
+{
+
+/** Hash the inputs one by one with the sph reference code */
+template<typename Context, void (*Init)(void*), void (*Update)(void*, const void*, size_t), void (*Close)(void*, void*)>
+void HashOneByOne(const unsigned char* const* ppdata, size_t nLen, uint512* phash, size_t nCount)
+{
+    Context ctx;
+    for (size_t i = 0; i < nCount; i++) {
+        Init(&ctx);
+        Update(&ctx, ppdata[i], nLen);
+        Close(&ctx, phash[i].begin());
+    }
+}
+
+/** Hash HASH_LANES inputs of nLen bytes at once */
+typedef void (*LaneKernel)(const unsigned char* const* ppdata, size_t nLen, uint512* phash);
+typedef void (*OneByOneKernel)(const unsigned char* const* ppdata, size_t nLen, uint512* phash, size_t nCount);
+
+struct CLaneKernels
+{
+    std::string strName;
+    /** NULL if the inputs are hashed one by one */
+    LaneKernel cubehash;
+    LaneKernel jh;
+    LaneKernel luffa;
+    /** A trailing group with fewer inputs than this is faster to hash one by one */
+    size_t nMinPartialLanes;
+};
+
+void RunLanes(LaneKernel kernel, size_t nMinPartialLanes, OneByOneKernel oneByOne, const unsigned char* const* ppdata, size_t nLen, uint512* phash, size_t nCount)
+{
+    size_t i = 0;
+    if (kernel) {
+        for (; i + HASH_LANES <= nCount; i += HASH_LANES)
+            kernel(ppdata + i, nLen, phash + i);
+        if (nCount - i >= nMinPartialLanes) {
+            // Fill the unused lanes with copies of the first input
+            const unsigned char* pplanes[HASH_LANES];
+            uint512 lanes[HASH_LANES];
+            for (size_t l = 0; l < HASH_LANES; l++)
+                pplanes[l] = ppdata[i + l < nCount ? i + l : i];
+            kernel(pplanes, nLen, lanes);
+            std::copy(lanes, lanes + (nCount - i), phash + i);
+            i = nCount;
+        }
+    }
+    oneByOne(ppdata + i, nLen, phash + i, nCount - i);
+}
+
+#ifdef ENABLE_HASH_LANES
+
+#define LANES_INLINE inline __attribute__((always_inline))
+
+// Fully unroll the short fixed-count loops over state words, so that the
+// words stay in registers instead of being indexed in memory.
+#if defined(__clang__)
+#define LANES_UNROLL _Pragma("unroll")
+#elif __GNUC__ >= 8
+#define LANES_UNROLL _Pragma("GCC unroll 16")
+#else
+#define LANES_UNROLL
+#endif
+
+typedef uint32_t vu32 __attribute__((vector_size(4 * HASH_LANES)));
+// 64-bit words are hashed HASH_LANES / 2 at a time, so that a vector fits an
+// AVX2 register.
+typedef uint64_t vu64 __attribute__((vector_size(4 * HASH_LANES)));
+static const size_t HASH_LANES_64 = HASH_LANES / 2;
+
+#define ROTL32(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+LANES_INLINE void LoadLE32(vu32* w, const unsigned char* const* ppdata, int nWords)
+{
+    for (int i = 0; i < nWords; i++)
+        for (size_t l = 0; l < HASH_LANES; l++)
+            w[i][l] = ReadLE32(ppdata[l] + 4 * i);
+}
+
+LANES_INLINE void StoreLE32(uint512* phash, const vu32* w, int nWords)
+{
+    for (int i = 0; i < nWords; i++)
+        for (size_t l = 0; l < HASH_LANES; l++)
+            WriteLE32(phash[l].begin() + 4 * i, w[i][l]);
+}
+
+LANES_INLINE void LoadBE32(vu32* w, const unsigned char* const* ppdata, int nWords)
+{
+    for (int i = 0; i < nWords; i++)
+        for (size_t l = 0; l < HASH_LANES; l++)
+            w[i][l] = ReadBE32(ppdata[l] + 4 * i);
+}
+
+LANES_INLINE void StoreBE32(uint512* phash, int nOffset, const vu32* w, int nWords)
+{
+    for (int i = 0; i < nWords; i++)
+        for (size_t l = 0; l < HASH_LANES; l++)
+            WriteBE32(phash[l].begin() + nOffset + 4 * i, w[i][l]);
+}
+
+LANES_INLINE void LoadLE64(vu64* w, const unsigned char* const* ppdata, int nWords)
+{
+    for (int i = 0; i < nWords; i++)
+        for (size_t l = 0; l < HASH_LANES_64; l++)
+            w[i][l] = ReadLE64(ppdata[l] + 8 * i);
+}
+
+LANES_INLINE void StoreLE64(uint512* phash, const vu64* w, int nWords)
+{
+    for (int i = 0; i < nWords; i++)
+        for (size_t l = 0; l < HASH_LANES_64; l++)
+            WriteLE64(phash[l].begin() + 8 * i, w[i][l]);
+}
+
+/**
+ * Point ppblock at the 32 bytes at nOffset of every input. Where the input
+ * ends before them, copy the rest of it to buf instead, followed by the 0x80
+ * padding byte and zeros.
+ */
+LANES_INLINE void GetBlock32(const unsigned char** ppblock, unsigned char buf[HASH_LANES][32], const unsigned char* const* ppdata, size_t nLen, size_t nOffset)
+{
+    for (size_t l = 0; l < HASH_LANES; l++) {
+        if (nOffset + 32 <= nLen) {
+            ppblock[l] = ppdata[l] + nOffset;
+        } else {
+            memset(buf[l], 0, 32);
+            memcpy(buf[l], ppdata[l] + nOffset, nLen - nOffset);
+            buf[l][nLen - nOffset] = 0x80;
+            ppblock[l] = buf[l];
+        }
+    }
+}
+
+/* CubeHash16/32-512, as in Bernstein's reference implementation. */
+
+static const uint32_t CUBEHASH_IV512[32] = {
+    0x2AEA2A61, 0x50F494D4, 0x2D538B8B, 0x4167D83E,
+    0x3FEE2313, 0xC701CF8C, 0xCC39968E, 0x50AC5695,
+    0x4D42C787, 0xA647A8B3, 0x97CF0BEF, 0x825B4537,
+    0xEEF864D2, 0xF22090C4, 0xD0E5CD33, 0xA23911AE,
+    0xFCD398D9, 0x148FE485, 0x1B017BEF, 0xB6444532,
+    0x6A536159, 0x2FF5781C, 0x91FA7934, 0x0DBADEA9,
+    0xD65C8A2B, 0xA5A70E75, 0xB1C62456, 0xBC796576,
+    0x1921C8F7, 0xE7989AF1, 0x7795D246, 0xD43E3B44
+};
+
+LANES_INLINE void CubeHashRounds(vu32* x, int nRounds)
+{
+    for (int r = 0; r < nRounds; r++) {
+        vu32 y[16];
+        LANES_UNROLL for (int i = 0; i < 16; i++) x[i + 16] += x[i];
+        LANES_UNROLL for (int i = 0; i < 16; i++) y[i ^ 8] = x[i];
+        LANES_UNROLL for (int i = 0; i < 16; i++) x[i] = ROTL32(y[i], 7);
+        LANES_UNROLL for (int i = 0; i < 16; i++) x[i] ^= x[i + 16];
+        LANES_UNROLL for (int i = 0; i < 16; i++) y[i ^ 2] = x[i + 16];
+        LANES_UNROLL for (int i = 0; i < 16; i++) x[i + 16] = y[i];
+        LANES_UNROLL for (int i = 0; i < 16; i++) x[i + 16] += x[i];
+        LANES_UNROLL for (int i = 0; i < 16; i++) y[i ^ 4] = x[i];
+        LANES_UNROLL for (int i = 0; i < 16; i++) x[i] = ROTL32(y[i], 11);
+        LANES_UNROLL for (int i = 0; i < 16; i++) x[i] ^= x[i + 16];
+        LANES_UNROLL for (int i = 0; i < 16; i++) y[i ^ 1] = x[i + 16];
+        LANES_UNROLL for (int i = 0; i < 16; i++) x[i + 16] = y[i];
+    }
+}
+
+LANES_INLINE void CubeHash512(const unsigned char* const* ppdata, size_t nLen, uint512* phash)
+{
+    const vu32 zero = {};
+    vu32 x[32], m[8];
+    const unsigned char* ppblock[HASH_LANES];
+    unsigned char buf[HASH_LANES][32];
+    for (int i = 0; i < 32; i++)
+        x[i] = zero + CUBEHASH_IV512[i];
+    // The last block holds the padding
+    for (size_t nOffset = 0; nOffset <= nLen; nOffset += 32) {
+        GetBlock32(ppblock, buf, ppdata, nLen, nOffset);
+        LoadLE32(m, ppblock, 8);
+        for (int i = 0; i < 8; i++)
+            x[i] ^= m[i];
+        CubeHashRounds(x, 16);
+    }
+    x[31] ^= 1;
+    CubeHashRounds(x, 160);
+    StoreLE32(phash, x, 16);
+}
+
+/* JH-512, with the bitsliced 64-bit state of sph_jh. The constants are
+ * byte-swapped to match the little-endian loads, as sph does. */
+
+constexpr uint64_t JHConst(uint64_t x)
+{
+    return ((x & 0xffULL) << 56) | ((x & 0xff00ULL) << 40) | ((x & 0xff0000ULL) << 24) | ((x & 0xff000000ULL) << 8) |
+           ((x >> 8) & 0xff000000ULL) | ((x >> 24) & 0xff0000ULL) | ((x >> 40) & 0xff00ULL) | (x >> 56);
+}
+
+static const uint64_t JH_C[168] = {
+    JHConst(0x72d5dea2df15f867), JHConst(0x7b84150ab7231557),
+    JHConst(0x81abd6904d5a87f6), JHConst(0x4e9f4fc5c3d12b40),
+    JHConst(0xea983ae05c45fa9c), JHConst(0x03c5d29966b2999a),
+    JHConst(0x660296b4f2bb538a), JHConst(0xb556141a88dba231),
+    JHConst(0x03a35a5c9a190edb), JHConst(0x403fb20a87c14410),
+    JHConst(0x1c051980849e951d), JHConst(0x6f33ebad5ee7cddc),
+    JHConst(0x10ba139202bf6b41), JHConst(0xdc786515f7bb27d0),
+    JHConst(0x0a2c813937aa7850), JHConst(0x3f1abfd2410091d3),
+    JHConst(0x422d5a0df6cc7e90), JHConst(0xdd629f9c92c097ce),
+    JHConst(0x185ca70bc72b44ac), JHConst(0xd1df65d663c6fc23),
+    JHConst(0x976e6c039ee0b81a), JHConst(0x2105457e446ceca8),
+    JHConst(0xeef103bb5d8e61fa), JHConst(0xfd9697b294838197),
+    JHConst(0x4a8e8537db03302f), JHConst(0x2a678d2dfb9f6a95),
+    JHConst(0x8afe7381f8b8696c), JHConst(0x8ac77246c07f4214),
+    JHConst(0xc5f4158fbdc75ec4), JHConst(0x75446fa78f11bb80),
+    JHConst(0x52de75b7aee488bc), JHConst(0x82b8001e98a6a3f4),
+    JHConst(0x8ef48f33a9a36315), JHConst(0xaa5f5624d5b7f989),
+    JHConst(0xb6f1ed207c5ae0fd), JHConst(0x36cae95a06422c36),
+    JHConst(0xce2935434efe983d), JHConst(0x533af974739a4ba7),
+    JHConst(0xd0f51f596f4e8186), JHConst(0x0e9dad81afd85a9f),
+    JHConst(0xa7050667ee34626a), JHConst(0x8b0b28be6eb91727),
+    JHConst(0x47740726c680103f), JHConst(0xe0a07e6fc67e487b),
+    JHConst(0x0d550aa54af8a4c0), JHConst(0x91e3e79f978ef19e),
+    JHConst(0x8676728150608dd4), JHConst(0x7e9e5a41f3e5b062),
+    JHConst(0xfc9f1fec4054207a), JHConst(0xe3e41a00cef4c984),
+    JHConst(0x4fd794f59dfa95d8), JHConst(0x552e7e1124c354a5),
+    JHConst(0x5bdf7228bdfe6e28), JHConst(0x78f57fe20fa5c4b2),
+    JHConst(0x05897cefee49d32e), JHConst(0x447e9385eb28597f),
+    JHConst(0x705f6937b324314a), JHConst(0x5e8628f11dd6e465),
+    JHConst(0xc71b770451b920e7), JHConst(0x74fe43e823d4878a),
+    JHConst(0x7d29e8a3927694f2), JHConst(0xddcb7a099b30d9c1),
+    JHConst(0x1d1b30fb5bdc1be0), JHConst(0xda24494ff29c82bf),
+    JHConst(0xa4e7ba31b470bfff), JHConst(0x0d324405def8bc48),
+    JHConst(0x3baefc3253bbd339), JHConst(0x459fc3c1e0298ba0),
+    JHConst(0xe5c905fdf7ae090f), JHConst(0x947034124290f134),
+    JHConst(0xa271b701e344ed95), JHConst(0xe93b8e364f2f984a),
+    JHConst(0x88401d63a06cf615), JHConst(0x47c1444b8752afff),
+    JHConst(0x7ebb4af1e20ac630), JHConst(0x4670b6c5cc6e8ce6),
+    JHConst(0xa4d5a456bd4fca00), JHConst(0xda9d844bc83e18ae),
+    JHConst(0x7357ce453064d1ad), JHConst(0xe8a6ce68145c2567),
+    JHConst(0xa3da8cf2cb0ee116), JHConst(0x33e906589a94999a),
+    JHConst(0x1f60b220c26f847b), JHConst(0xd1ceac7fa0d18518),
+    JHConst(0x32595ba18ddd19d3), JHConst(0x509a1cc0aaa5b446),
+    JHConst(0x9f3d6367e4046bba), JHConst(0xf6ca19ab0b56ee7e),
+    JHConst(0x1fb179eaa9282174), JHConst(0xe9bdf7353b3651ee),
+    JHConst(0x1d57ac5a7550d376), JHConst(0x3a46c2fea37d7001),
+    JHConst(0xf735c1af98a4d842), JHConst(0x78edec209e6b6779),
+    JHConst(0x41836315ea3adba8), JHConst(0xfac33b4d32832c83),
+    JHConst(0xa7403b1f1c2747f3), JHConst(0x5940f034b72d769a),
+    JHConst(0xe73e4e6cd2214ffd), JHConst(0xb8fd8d39dc5759ef),
+    JHConst(0x8d9b0c492b49ebda), JHConst(0x5ba2d74968f3700d),
+    JHConst(0x7d3baed07a8d5584), JHConst(0xf5a5e9f0e4f88e65),
+    JHConst(0xa0b8a2f436103b53), JHConst(0x0ca8079e753eec5a),
+    JHConst(0x9168949256e8884f), JHConst(0x5bb05c55f8babc4c),
+    JHConst(0xe3bb3b99f387947b), JHConst(0x75daf4d6726b1c5d),
+    JHConst(0x64aeac28dc34b36d), JHConst(0x6c34a550b828db71),
+    JHConst(0xf861e2f2108d512a), JHConst(0xe3db643359dd75fc),
+    JHConst(0x1cacbcf143ce3fa2), JHConst(0x67bbd13c02e843b0),
+    JHConst(0x330a5bca8829a175), JHConst(0x7f34194db416535c),
+    JHConst(0x923b94c30e794d1e), JHConst(0x797475d7b6eeaf3f),
+    JHConst(0xeaa8d4f7be1a3921), JHConst(0x5cf47e094c232751),
+    JHConst(0x26a32453ba323cd2), JHConst(0x44a3174a6da6d5ad),
+    JHConst(0xb51d3ea6aff2c908), JHConst(0x83593d98916b3c56),
+    JHConst(0x4cf87ca17286604d), JHConst(0x46e23ecc086ec7f6),
+    JHConst(0x2f9833b3b1bc765e), JHConst(0x2bd666a5efc4e62a),
+    JHConst(0x06f4b6e8bec1d436), JHConst(0x74ee8215bcef2163),
+    JHConst(0xfdc14e0df453c969), JHConst(0xa77d5ac406585826),
+    JHConst(0x7ec1141606e0fa16), JHConst(0x7e90af3d28639d3f),
+    JHConst(0xd2c9f2e3009bd20c), JHConst(0x5faace30b7d40c30),
+    JHConst(0x742a5116f2e03298), JHConst(0x0deb30d8e3cef89a),
+    JHConst(0x4bc59e7bb5f17992), JHConst(0xff51e66e048668d3),
+    JHConst(0x9b234d57e6966731), JHConst(0xcce6a6f3170a7505),
+    JHConst(0xb17681d913326cce), JHConst(0x3c175284f805a262),
+    JHConst(0xf42bcbb378471547), JHConst(0xff46548223936a48),
+    JHConst(0x38df58074e5e6565), JHConst(0xf2fc7c89fc86508e),
+    JHConst(0x31702e44d00bca86), JHConst(0xf04009a23078474e),
+    JHConst(0x65a0ee39d1f73883), JHConst(0xf75ee937e42c3abd),
+    JHConst(0x2197b2260113f86f), JHConst(0xa344edd1ef9fdee7),
+    JHConst(0x8ba0df15762592d9), JHConst(0x3c85f7f612dc42be),
+    JHConst(0xd8a7ec7cab27b07e), JHConst(0x538d7ddaaa3ea8de),
+    JHConst(0xaa25ce93bd0269d8), JHConst(0x5af643fd1a7308f9),
+    JHConst(0xc05fefda174a19a5), JHConst(0x974d66334cfd216a),
+    JHConst(0x35b49831db411570), JHConst(0xea1e0fbbedcd549b),
+    JHConst(0x9ad063a151974072), JHConst(0xf6759dbf91476fe2)
+};
+
+static const uint64_t JH_IV512[16] = {
+    JHConst(0x6fd14b963e00aa17), JHConst(0x636a2e057a15d543),
+    JHConst(0x8a225e8d0c97ef0b), JHConst(0xe9341259f2b3c361),
+    JHConst(0x891da0c1536f801e), JHConst(0x2aa9056bea2b6d80),
+    JHConst(0x588eccdb2075baa6), JHConst(0xa90f3a76baf83bf7),
+    JHConst(0x0169e60541e34a69), JHConst(0x46b58a8e2e6fe65a),
+    JHConst(0x1047a7d0c1843c24), JHConst(0x3b6e71b12d5ac199),
+    JHConst(0xcf57f6ec9db1f856), JHConst(0xa706887c5716b156),
+    JHConst(0xe3c2fcdfe68517fb), JHConst(0x545a4678cc8cdd4b)
+};
+
+LANES_INLINE void JHSb(vu64& x0, vu64& x1, vu64& x2, vu64& x3, uint64_t c)
+{
+    vu64 tmp;
+    x3 = ~x3;
+    x0 ^= c & ~x2;
+    tmp = c ^ (x0 & x1);
+    x0 ^= x2 & x3;
+    x3 ^= ~x1 & x2;
+    x1 ^= x0 & x2;
+    x2 ^= x0 & ~x3;
+    x0 ^= x1 | x3;
+    x3 ^= x1 & x2;
+    x1 ^= tmp & x0;
+    x2 ^= tmp;
+}
+
+LANES_INLINE void JHLb(vu64& x0, vu64& x1, vu64& x2, vu64& x3, vu64& x4, vu64& x5, vu64& x6, vu64& x7)
+{
+    x4 ^= x1;
+    x5 ^= x2;
+    x6 ^= x3 ^ x0;
+    x7 ^= x0;
+    x0 ^= x5;
+    x1 ^= x6;
+    x2 ^= x7 ^ x4;
+    x3 ^= x4;
+}
+
+LANES_INLINE void JHSwap(vu64& x, uint64_t c, int n)
+{
+    vu64 t = (x & c) << n;
+    x = ((x >> n) & c) | t;
+}
+
+/** Round r of E8; ro is r % 7, which selects the bit swap */
+LANES_INLINE void JHRound(vu64* h, int r, int ro)
+{
+    static const uint64_t masks[6] = {
+        0x5555555555555555ULL, 0x3333333333333333ULL, 0x0F0F0F0F0F0F0F0FULL,
+        0x00FF00FF00FF00FFULL, 0x0000FFFF0000FFFFULL, 0x00000000FFFFFFFFULL
+    };
+    // h[2k] and h[2k + 1] are the high and low halves of sph's hk
+    JHSb(h[0], h[4], h[8], h[12], JH_C[4 * r + 0]);
+    JHSb(h[1], h[5], h[9], h[13], JH_C[4 * r + 1]);
+    JHSb(h[2], h[6], h[10], h[14], JH_C[4 * r + 2]);
+    JHSb(h[3], h[7], h[11], h[15], JH_C[4 * r + 3]);
+    JHLb(h[0], h[4], h[8], h[12], h[2], h[6], h[10], h[14]);
+    JHLb(h[1], h[5], h[9], h[13], h[3], h[7], h[11], h[15]);
+    LANES_UNROLL
+    for (int k = 2; k < 16; k += 4) {
+        if (ro == 6) {
+            std::swap(h[k], h[k + 1]);
+        } else {
+            JHSwap(h[k], masks[ro], 1 << ro);
+            JHSwap(h[k + 1], masks[ro], 1 << ro);
+        }
+    }
+}
+
+LANES_INLINE void JHE8(vu64* h)
+{
+    for (int r = 0; r < 42; r += 7) {
+        JHRound(h, r + 0, 0);
+        JHRound(h, r + 1, 1);
+        JHRound(h, r + 2, 2);
+        JHRound(h, r + 3, 3);
+        JHRound(h, r + 4, 4);
+        JHRound(h, r + 5, 5);
+        JHRound(h, r + 6, 6);
+    }
+}
+
+LANES_INLINE void JHBlock(vu64* h, const vu64* m)
+{
+    for (int i = 0; i < 8; i++)
+        h[i] ^= m[i];
+    JHE8(h);
+    for (int i = 0; i < 8; i++)
+        h[i + 8] ^= m[i];
+}
+
+/** JH-512 of HASH_LANES_64 inputs whose length is a multiple of the 64-byte block */
+LANES_INLINE void JH512Half(const unsigned char* const* ppdata, size_t nLen, uint512* phash)
+{
+    const vu64 zero = {};
+    vu64 h[16], m[8];
+    const unsigned char* ppblock[HASH_LANES_64];
+    for (int i = 0; i < 16; i++)
+        h[i] = zero + JH_IV512[i];
+    for (size_t nOffset = 0; nOffset < nLen; nOffset += 64) {
+        for (size_t l = 0; l < HASH_LANES_64; l++)
+            ppblock[l] = ppdata[l] + nOffset;
+        LoadLE64(m, ppblock, 8);
+        JHBlock(h, m);
+    }
+    // Padding block: 0x80, zeros and the big-endian bit length
+    for (int i = 0; i < 8; i++)
+        m[i] = zero;
+    m[0] += 0x80;
+    m[7] += JHConst((uint64_t)nLen << 3);
+    JHBlock(h, m);
+    StoreLE64(phash, h + 8, 8);
+}
+
+LANES_INLINE void JH512(const unsigned char* const* ppdata, size_t nLen, uint512* phash)
+{
+    for (size_t i = 0; i < HASH_LANES; i += HASH_LANES_64)
+        JH512Half(ppdata + i, nLen, phash + i);
+}
+
+/* Luffa-512, with the 32-bit state of sph_luffa. */
+
+static const uint32_t LUFFA_IV[5][8] = {
+    { 0x6d251e69, 0x44b051e0, 0x4eaa6fb4, 0xdbf78465,
+      0x6e292011, 0x90152df4, 0xee058139, 0xdef610bb },
+    { 0xc3b44b95, 0xd9d2f256, 0x70eee9a0, 0xde099fa3,
+      0x5d9b0557, 0x8fc944b3, 0xcf1ccf0e, 0x746cd581 },
+    { 0xf7efc89d, 0x5dba5781, 0x04016ce5, 0xad659c05,
+      0x0306194f, 0x666d1836, 0x24aa230a, 0x8b264ae7 },
+    { 0x858075d5, 0x36d79cce, 0xe571f7d7, 0x204b1f67,
+      0x35870c6a, 0x57e9e923, 0x14bcb808, 0x7cde72ce },
+    { 0x6c68e9be, 0x5ec41e22, 0xc825b7c7, 0xaffb4363,
+      0xf5df3999, 0x0fc688f1, 0xb07224cc, 0x03e86cea }
+};
+
+static const uint32_t LUFFA_RC[5][2][8] = {
+    { { 0x303994a6, 0xc0e65299, 0x6cc33a12, 0xdc56983e,
+        0x1e00108f, 0x7800423d, 0x8f5b7882, 0x96e1db12 },
+      { 0xe0337818, 0x441ba90d, 0x7f34d442, 0x9389217f,
+        0xe5a8bce6, 0x5274baf4, 0x26889ba7, 0x9a226e9d } },
+    { { 0xb6de10ed, 0x70f47aae, 0x0707a3d4, 0x1c1e8f51,
+        0x707a3d45, 0xaeb28562, 0xbaca1589, 0x40a46f3e },
+      { 0x01685f3d, 0x05a17cf4, 0xbd09caca, 0xf4272b28,
+        0x144ae5cc, 0xfaa7ae2b, 0x2e48f1c1, 0xb923c704 } },
+    { { 0xfc20d9d2, 0x34552e25, 0x7ad8818f, 0x8438764a,
+        0xbb6de032, 0xedb780c8, 0xd9847356, 0xa2c78434 },
+      { 0xe25e72c1, 0xe623bb72, 0x5c58a4a4, 0x1e38e2e7,
+        0x78e38b9d, 0x27586719, 0x36eda57f, 0x703aace7 } },
+    { { 0xb213afa5, 0xc84ebe95, 0x4e608a22, 0x56d858fe,
+        0x343b138f, 0xd0ec4e3d, 0x2ceb4882, 0xb3ad2208 },
+      { 0xe028c9bf, 0x44756f91, 0x7e8fce32, 0x956548be,
+        0xfe191be2, 0x3cb226e5, 0x5944a28e, 0xa1c4c355 } },
+    { { 0xf0d2e9e3, 0xac11d7fa, 0x1bcb66f2, 0x6f2d9bc9,
+        0x78602649, 0x8edae952, 0x3b6ba548, 0xedae9520 },
+      { 0x5090d577, 0x2d1925ab, 0xb46496ac, 0xd1925ab0,
+        0x29131ab6, 0x0fc053c3, 0x3f014f0c, 0xfc053c31 } }
+};
+
+/** Multiply by 2 in the ring of Luffa's message injection */
+LANES_INLINE void LuffaM2(vu32* d, const vu32* s)
+{
+    vu32 tmp = s[7];
+    d[7] = s[6];
+    d[6] = s[5];
+    d[5] = s[4];
+    d[4] = s[3] ^ tmp;
+    d[3] = s[2] ^ tmp;
+    d[2] = s[1];
+    d[1] = s[0] ^ tmp;
+    d[0] = tmp;
+}
+
+LANES_INLINE void LuffaXor(vu32* d, const vu32* s)
+{
+    for (int i = 0; i < 8; i++)
+        d[i] ^= s[i];
+}
+
+LANES_INLINE void LuffaSubCrumb(vu32& a0, vu32& a1, vu32& a2, vu32& a3)
+{
+    vu32 tmp = a0;
+    a0 |= a1;
+    a2 ^= a3;
+    a1 = ~a1;
+    a0 ^= a3;
+    a3 &= tmp;
+    a1 ^= a3;
+    a3 ^= a2;
+    a2 &= a0;
+    a0 = ~a0;
+    a2 ^= a1;
+    a1 |= a3;
+    tmp ^= a1;
+    a3 ^= a2;
+    a2 &= a1;
+    a1 ^= a0;
+    a0 = tmp;
+}
+
+LANES_INLINE void LuffaMixWord(vu32& u, vu32& v)
+{
+    v ^= u;
+    u = ROTL32(u, 2) ^ v;
+    v = ROTL32(v, 14) ^ u;
+    u = ROTL32(u, 10) ^ v;
+    v = ROTL32(v, 1);
+}
+
+/** Message injection of m into V, followed by the permutation */
+LANES_INLINE void LuffaBlock(vu32 V[5][8], vu32* m)
+{
+    vu32 a[8], b[8];
+    for (int i = 0; i < 8; i++)
+        a[i] = V[0][i] ^ V[1][i] ^ V[2][i] ^ V[3][i] ^ V[4][i];
+    LuffaM2(a, a);
+    for (int j = 0; j < 5; j++)
+        LuffaXor(V[j], a);
+    LuffaM2(b, V[0]);
+    LuffaXor(b, V[1]);
+    LuffaM2(V[1], V[1]);
+    LuffaXor(V[1], V[2]);
+    LuffaM2(V[2], V[2]);
+    LuffaXor(V[2], V[3]);
+    LuffaM2(V[3], V[3]);
+    LuffaXor(V[3], V[4]);
+    LuffaM2(V[4], V[4]);
+    LuffaXor(V[4], V[0]);
+    LuffaM2(V[0], b);
+    LuffaXor(V[0], V[4]);
+    LuffaM2(V[4], V[4]);
+    LuffaXor(V[4], V[3]);
+    LuffaM2(V[3], V[3]);
+    LuffaXor(V[3], V[2]);
+    LuffaM2(V[2], V[2]);
+    LuffaXor(V[2], V[1]);
+    LuffaM2(V[1], V[1]);
+    LuffaXor(V[1], b);
+    for (int j = 0; j < 5; j++) {
+        if (j > 0)
+            LuffaM2(m, m);
+        LuffaXor(V[j], m);
+    }
+
+    // Tweak, then the eight steps of each of the five sub-permutations
+    for (int j = 1; j < 5; j++)
+        for (int i = 4; i < 8; i++)
+            V[j][i] = ROTL32(V[j][i], j);
+    for (int j = 0; j < 5; j++) {
+        vu32* v = V[j];
+        LANES_UNROLL
+        for (int r = 0; r < 8; r++) {
+            LuffaSubCrumb(v[0], v[1], v[2], v[3]);
+            LuffaSubCrumb(v[5], v[6], v[7], v[4]);
+            LANES_UNROLL
+            for (int i = 0; i < 4; i++)
+                LuffaMixWord(v[i], v[i + 4]);
+            v[0] ^= LUFFA_RC[j][0][r];
+            v[4] ^= LUFFA_RC[j][1][r];
+        }
+    }
+}
+
+LANES_INLINE void LuffaOutput(const vu32 V[5][8], vu32* out)
+{
+    for (int i = 0; i < 8; i++)
+        out[i] = V[0][i] ^ V[1][i] ^ V[2][i] ^ V[3][i] ^ V[4][i];
+}
+
+LANES_INLINE void Luffa512(const unsigned char* const* ppdata, size_t nLen, uint512* phash)
+{
+    const vu32 zero = {};
+    vu32 V[5][8], m[8], out[8];
+    const unsigned char* ppblock[HASH_LANES];
+    unsigned char buf[HASH_LANES][32];
+    for (int j = 0; j < 5; j++)
+        for (int i = 0; i < 8; i++)
+            V[j][i] = zero + LUFFA_IV[j][i];
+    // The last block holds the padding
+    for (size_t nOffset = 0; nOffset <= nLen; nOffset += 32) {
+        GetBlock32(ppblock, buf, ppdata, nLen, nOffset);
+        LoadBE32(m, ppblock, 8);
+        LuffaBlock(V, m);
+    }
+    // Two blank rounds, each of which produces half of the output
+    for (int i = 0; i < 8; i++)
+        m[i] = zero;
+    LuffaBlock(V, m);
+    LuffaOutput(V, out);
+    StoreBE32(phash, 0, out, 8);
+    for (int i = 0; i < 8; i++)
+        m[i] = zero;
+    LuffaBlock(V, m);
+    LuffaOutput(V, out);
+    StoreBE32(phash, 32, out, 8);
+}
+
+#undef ROTL32
+
+void CubeHash512Generic(const unsigned char* const* ppdata, size_t nLen, uint512* phash) { CubeHash512(ppdata, nLen, phash); }
+void JH512Generic(const unsigned char* const* ppdata, size_t nLen, uint512* phash) { JH512(ppdata, nLen, phash); }
+void Luffa512Generic(const unsigned char* const* ppdata, size_t nLen, uint512* phash) { Luffa512(ppdata, nLen, phash); }
+
+#ifdef ENABLE_HASH_LANES_AVX2
+__attribute__((target("avx2"))) void CubeHash512AVX2(const unsigned char* const* ppdata, size_t nLen, uint512* phash) { CubeHash512(ppdata, nLen, phash); }
+__attribute__((target("avx2"))) void JH512AVX2(const unsigned char* const* ppdata, size_t nLen, uint512* phash) { JH512(ppdata, nLen, phash); }
+__attribute__((target("avx2"))) void Luffa512AVX2(const unsigned char* const* ppdata, size_t nLen, uint512* phash) { Luffa512(ppdata, nLen, phash); }
+#endif
+
+#endif // ENABLE_HASH_LANES
+
+/** Set kernels to implementation impl, or return false if it is not available */
+bool SelectLaneKernels(HashLanesImpl impl, CLaneKernels& kernels)
+{
+    if (impl == HASH_LANES_AUTO || impl == HASH_LANES_AVX2) {
+#if defined(ENABLE_HASH_LANES_AVX2)
+        if (__builtin_cpu_supports("avx2")) {
+            kernels.strName = "avx2 (8 lanes)";
+            kernels.cubehash = CubeHash512AVX2;
+            kernels.jh = JH512AVX2;
+            kernels.luffa = Luffa512AVX2;
+            kernels.nMinPartialLanes = 2;
+            return true;
+        }
+#endif
+        if (impl == HASH_LANES_AVX2)
+            return false;
+    }
+    if (impl == HASH_LANES_AUTO || impl == HASH_LANES_GENERIC) {
+#if defined(ENABLE_HASH_LANES)
+        kernels.strName = "generic vectors (8 lanes)";
+        kernels.cubehash = CubeHash512Generic;
+        kernels.jh = JH512Generic;
+        kernels.luffa = Luffa512Generic;
+        kernels.nMinPartialLanes = 5;
+        return true;
+#endif
+        if (impl == HASH_LANES_GENERIC)
+            return false;
+    }
+    kernels.strName = "scalar";
+    kernels.cubehash = NULL;
+    kernels.jh = NULL;
+    kernels.luffa = NULL;
+    kernels.nMinPartialLanes = HASH_LANES;
+    return true;
+}
+
+CLaneKernels AutoLaneKernels()
+{
+    CLaneKernels kernels;
+    SelectLaneKernels(HASH_LANES_AUTO, kernels);
+    return kernels;
+}
+
+CLaneKernels& GetLaneKernels()
+{
+    static CLaneKernels kernels = AutoLaneKernels();
+    return kernels;
+}
+
+} // namespace
+
+std::string HashLanesImplementation()
+{
+    return GetLaneKernels().strName;
+}
+
+bool SetHashLanesImplementation(HashLanesImpl impl)
+{
+    CLaneKernels kernels;
+    if (!SelectLaneKernels(impl, kernels))
+        return false;
+    GetLaneKernels() = kernels;
+    return true;
+}
+
+void CubeHash512Lanes(const unsigned char* const* ppdata, size_t nLen, uint512* phash, size_t nCount)
+{
+    const CLaneKernels& kernels = GetLaneKernels();
+    RunLanes(kernels.cubehash, kernels.nMinPartialLanes, HashOneByOne<sph_cubehash512_context, sph_cubehash512_init, sph_cubehash512, sph_cubehash512_close>, ppdata, nLen, phash, nCount);
+}
+
+void JH512Lanes(const unsigned char* const* ppdata, size_t nLen, uint512* phash, size_t nCount)
+{
+    const CLaneKernels& kernels = GetLaneKernels();
+    RunLanes(nLen % 64 == 0 ? kernels.jh : NULL, kernels.nMinPartialLanes, HashOneByOne<sph_jh512_context, sph_jh512_init, sph_jh512, sph_jh512_close>, ppdata, nLen, phash, nCount);
+}
+
+void Luffa512Lanes(const unsigned char* const* ppdata, size_t nLen, uint512* phash, size_t nCount)
+{
+    const CLaneKernels& kernels = GetLaneKernels();
+    RunLanes(kernels.luffa, kernels.nMinPartialLanes, HashOneByOne<sph_luffa512_context, sph_luffa512_init, sph_luffa512, sph_luffa512_close>, ppdata, nLen, phash, nCount);
+}
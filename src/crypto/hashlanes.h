@@ -0,0 +1,47 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_CRYPTO_HASHLANES_H
+#define BITCOIN_CRYPTO_HASHLANES_H
+
+#include "uint256.h"
+
+#include <stddef.h>
+#include <string>
+
+/** Number of inputs the multi-lane kernels hash at once */
+static const size_t HASH_LANES = 8;
+
+/** Multi-lane implementations */
+enum HashLanesImpl {
+    HASH_LANES_AUTO,    //!< the fastest one for this CPU, selected by default
+    HASH_LANES_SCALAR,  //!< the sph code, one input at a time
+    HASH_LANES_GENERIC, //!< generic vectors for the baseline instruction set
+    HASH_LANES_AVX2,    //!< generic vectors compiled for AVX2
+};
+
+/** Name of the multi-lane implementation selected for this CPU */
+std::string HashLanesImplementation();
+
+/**
+ * Use implementation impl from now on, so that tests can check each of
+ * them. Returns false, leaving the selection unchanged, if impl is not
+ * available in this build or on this CPU. Not thread safe: no hashing may
+ * run at the same time.
+ */
+bool SetHashLanesImplementation(HashLanesImpl impl);
+
+/**
+ * Hash nCount inputs of nLen bytes each, at ppdata[0] to ppdata[nCount - 1],
+ * to phash[0] to phash[nCount - 1] as the sph_*512 functions would. Groups
+ * of HASH_LANES inputs are hashed together in SIMD lanes where the compiler
+ * and CPU support it, the rest one by one with the sph code. ppdata[i] may
+ * point into phash[i]. JH512Lanes uses lanes only if nLen is a multiple of
+ * 64.
+ */
+void CubeHash512Lanes(const unsigned char* const* ppdata, size_t nLen, uint512* phash, size_t nCount);
+void JH512Lanes(const unsigned char* const* ppdata, size_t nLen, uint512* phash, size_t nCount);
+void Luffa512Lanes(const unsigned char* const* ppdata, size_t nLen, uint512* phash, size_t nCount);
+
+#endif // BITCOIN_CRYPTO_HASHLANES_H
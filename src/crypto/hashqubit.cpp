@@ -0,0 +1,44 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "crypto/hashqubit.h"
+
+#include "crypto/hashlanes.h"
+
+#include <algorithm>
+
+void HashQubitBatch(const unsigned char* const* ppdata, size_t nLen, uint256* phash, size_t nCount)
+{
+    sph_shavite512_context   ctx_shavite;
+    sph_simd512_context      ctx_simd;
+    sph_echo512_context      ctx_echo;
+
+    uint512 hash[HASH_LANES];
+    const unsigned char* pphash[HASH_LANES];
+    for (size_t i = 0; i < HASH_LANES; i++)
+        pphash[i] = hash[i].begin();
+
+    for (size_t nStart = 0; nStart < nCount; nStart += HASH_LANES) {
+        const size_t n = std::min(HASH_LANES, nCount - nStart);
+
+        Luffa512Lanes(ppdata + nStart, nLen, hash, n);
+        CubeHash512Lanes(pphash, 64, hash, n);
+
+        for (size_t i = 0; i < n; i++) {
+            sph_shavite512_init(&ctx_shavite);
+            sph_shavite512(&ctx_shavite, hash[i].begin(), 64);
+            sph_shavite512_close(&ctx_shavite, hash[i].begin());
+
+            sph_simd512_init(&ctx_simd);
+            sph_simd512(&ctx_simd, hash[i].begin(), 64);
+            sph_simd512_close(&ctx_simd, hash[i].begin());
+
+            sph_echo512_init(&ctx_echo);
+            sph_echo512(&ctx_echo, hash[i].begin(), 64);
+            sph_echo512_close(&ctx_echo, hash[i].begin());
+
+            phash[nStart + i] = hash[i].trim256();
+        }
+    }
+}
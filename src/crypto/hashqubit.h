@@ -60,4 +60,12 @@ inline uint256 HashQubit(const T1 pbegin, const T1 pend)
     return hash[4].trim256();
 }
 
+/**
+ * Qubit hash of nCount inputs of nLen bytes each, at ppdata[0] to
+ * ppdata[nCount - 1], as HashQubit computes it. The inputs go through the
+ * chain HASH_LANES at a time, so that the Luffa and CubeHash stages hash them
+ * together in SIMD lanes.
+ */
+void HashQubitBatch(const unsigned char* const* ppdata, size_t nLen, uint256* phash, size_t nCount);
+
 #endif
@@ -7,6 +7,7 @@
 #include "base58.h"
 #include "chainparams.h"
 #include "httpserver.h"
+#include "rpc/jsonwriter.h"
 #include "rpc/protocol.h"
 #include "rpc/server.h"
 #include "random.h"
@@ -18,12 +19,22 @@
 #include <stdio.h>
 #include "utilstrencodings.h"
 
+#include <memory>
+#include <mutex>
+
 #include <boost/algorithm/string.hpp> // boost::trim
 #include <boost/foreach.hpp> //BOOST_FOREACH
 
 /** WWW-Authenticate to present with 401 Unauthorized response */
 static const char* WWW_AUTH_HEADER_DATA = "Basic realm=\"jsonrpc\"";
 
+/** Methods used by miners and pools. They run ahead of other RPC traffic by
+ * default, so that block templates and submissions are not held up behind it.
+ */
+static const char* const MINING_RPC_METHODS[] = {
+    "getauxblock", "createauxblock", "submitauxblock", "getblocktemplate", "submitblock",
+};
+
 /** Simple one-shot callback timer to be used by the RPC mechanism to e.g.
  * re-lock the wallet.
  */
@@ -147,6 +158,123 @@ static bool RPCAuthorized(const std::string& strAuth, std::string& strAuthUserna
     return multiUserAuthorized(strUserPass);
 }
 
+/** Run a parsed JSON-RPC request and send its reply.
+ * Handlers may write large results straight into a chunked reply; the
+ * reply is only started once the first chunk of the result is complete.
+ */
+static void JSONRPCExecRequest(HTTPRequest* req, const JSONRPCRequest& jreqIn)
+{
+    JSONRPCRequest jreq(jreqIn);
+    bool fStarted = false;
+    JSONStreamWriter writer([req, &fStarted](const std::string& chunk) {
+        if (!fStarted) {
+            req->WriteHeader("Content-Type", "application/json");
+            req->StartChunkedReply(HTTP_OK);
+            fStarted = true;
+        }
+        req->WriteReplyChunk(chunk);
+    });
+    writer.Raw("{\"result\":");
+    jreq.resultWriter = &writer;
+    UniValue objError;
+    try {
+        UniValue result = tableRPC.execute(jreq);
+        if (writer.TopLevelValues() == 0) {
+            // Send reply
+            std::string strReply = JSONRPCReply(result, NullUniValue, jreq.id);
+            req->WriteHeader("Content-Type", "application/json");
+            req->WriteReply(HTTP_OK, strReply);
+        } else {
+            writer.Raw(",\"error\":null,\"id\":" + jreq.id.write() + "}\n");
+            writer.Flush();
+            req->EndChunkedReply();
+        }
+        return;
+    } catch (const UniValue& e) {
+        objError = e;
+    } catch (const std::exception& e) {
+        objError = JSONRPCError(RPC_PARSE_ERROR, e.what());
+    }
+    if (writer.Flushed()) {
+        // Part of the result has been sent, so the error cannot be reported
+        LogPrintf("%s: %s failed after sending part of its result: %s\n", __func__, SanitizeString(jreq.strMethod), objError.write());
+        req->EndChunkedReply();
+        return;
+    }
+    JSONErrorReply(req, objError, jreq.id);
+}
+
+static UniValue WorkQueueExceededError(const std::string& strMethod)
+{
+    LogPrintf("WARNING: %s request rejected because its work queue depth was exceeded, it can be increased with the -rpcworkqueue= setting\n", SanitizeString(strMethod));
+    return JSONRPCError(RPC_MISC_ERROR, "Work queue depth exceeded");
+}
+
+/** Replies to a JSON-RPC batch whose entries run as separate work items.
+ * The reply is sent once every entry has completed.
+ */
+class JSONRPCBatch
+{
+private:
+    std::unique_ptr<HTTPRequest> req;
+    std::mutex cs;
+    std::vector<UniValue> vReplies;
+    size_t nPending;
+
+public:
+    //! Entries are completed with SetReply, the caller completes once with Done
+    JSONRPCBatch(std::unique_ptr<HTTPRequest> _req, size_t nEntries) :
+        req(std::move(_req)), vReplies(nEntries), nPending(nEntries + 1)
+    {
+    }
+
+    void SetReply(size_t nEntry, const UniValue& reply)
+    {
+        {
+            std::lock_guard<std::mutex> lock(cs);
+            vReplies[nEntry] = reply;
+        }
+        Done();
+    }
+
+    void Done()
+    {
+        {
+            std::lock_guard<std::mutex> lock(cs);
+            if (--nPending > 0)
+                return;
+        }
+        UniValue ret(UniValue::VARR);
+        for (const UniValue& reply : vReplies)
+            ret.push_back(reply);
+        req->WriteHeader("Content-Type", "application/json");
+        req->WriteReply(HTTP_OK, ret.write() + "\n");
+    }
+};
+
+/** Queue each entry of a JSON-RPC batch under its method, so that the
+ * entries run in parallel and in the order their priorities dictate. The
+ * batch was admitted as one request, so its entries are not held to the
+ * depth limit of their method; otherwise any batch larger than that limit
+ * would fail.
+ */
+static void JSONRPCQueueBatch(HTTPRequest* req, const UniValue& vReq)
+{
+    std::shared_ptr<JSONRPCBatch> batch = std::make_shared<JSONRPCBatch>(req->Detach(), vReq.size());
+    for (size_t i = 0; i < vReq.size(); i++) {
+        const UniValue& entry = vReq[i];
+        const UniValue& method = find_value(entry, "method");
+        if (method.isStr() && tableRPC[method.get_str()]) {
+            if (!QueueHTTPWork(method.get_str(), [batch, i, entry]() { batch->SetReply(i, JSONRPCExecOne(entry)); }, false))
+                batch->SetReply(i, JSONRPCReplyObj(NullUniValue, WorkQueueExceededError(method.get_str()), find_value(entry, "id")));
+        } else {
+            // Malformed entries and unknown methods only produce an error
+            batch->SetReply(i, JSONRPCExecOne(entry));
+        }
+    }
+    batch->Done();
+}
+
 static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
 {
     // JSONRPC handles only POST
@@ -185,24 +313,27 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
         // Set the URI
         jreq.URI = req->GetURI();
 
-        std::string strReply;
         // singleton request
         if (valRequest.isObject()) {
             jreq.parse(valRequest);
 
-            UniValue result = tableRPC.execute(jreq);
-
-            // Send reply
-            strReply = JSONRPCReply(result, NullUniValue, jreq.id);
+            // Run the call as a work item of its method, unknown methods
+            // only produce an error
+            if (!tableRPC[jreq.strMethod]) {
+                JSONRPCExecRequest(req, jreq);
+                return true;
+            }
+            std::shared_ptr<HTTPRequest> pending(req->Detach());
+            if (!QueueHTTPWork(jreq.strMethod, [pending, jreq]() { JSONRPCExecRequest(pending.get(), jreq); })) {
+                JSONErrorReply(pending.get(), WorkQueueExceededError(jreq.strMethod), jreq.id);
+                return false;
+            }
 
         // array of requests
         } else if (valRequest.isArray())
-            strReply = JSONRPCExecBatch(valRequest.get_array());
+            JSONRPCQueueBatch(req, valRequest.get_array());
         else
             throw JSONRPCError(RPC_PARSE_ERROR, "Top-level object parse error");
-
-        req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTP_OK, strReply);
     } catch (const UniValue& objError) {
         JSONErrorReply(req, objError, jreq.id);
         return false;
@@ -231,11 +362,89 @@ static bool InitRPCAuthentication()
     return true;
 }
 
+static bool ParseRPCPriority(const std::string& strLevel, HTTPWorkPriority& priority)
+{
+    if (strLevel == "high")
+        priority = HTTP_PRIORITY_HIGH;
+    else if (strLevel == "normal")
+        priority = HTTP_PRIORITY_NORMAL;
+    else if (strLevel == "low")
+        priority = HTTP_PRIORITY_LOW;
+    else
+        return false;
+    return true;
+}
+
+/** Split a -rpcpriority or -rpcmethodthreads value into a known method and its setting */
+static bool ParseRPCMethodArg(const std::string& strArg, const std::string& strValue, std::string& strMethod, std::string& strSetting)
+{
+    size_t pos = strValue.find(':');
+    if (pos != std::string::npos) {
+        strMethod = strValue.substr(0, pos);
+        strSetting = strValue.substr(pos + 1);
+        if (tableRPC[strMethod])
+            return true;
+    }
+    uiInterface.ThreadSafeMessageBox(
+        strprintf("Invalid %s setting %s: expected <method>:<value> for a known RPC method.", strArg, strValue),
+        "", CClientUIInterface::MSG_ERROR);
+    return false;
+}
+
+/** Set up the work queue limits of RPC methods */
+static bool InitRPCWorkLimits()
+{
+    const HTTPWorkLimits defaultLimits = GetHTTPWorkDefaultLimits();
+    std::map<std::string, HTTPWorkLimits> mapLimits;
+    for (const char* method : MINING_RPC_METHODS) {
+        if (tableRPC[method])
+            mapLimits.emplace(method, HTTPWorkLimits(HTTP_PRIORITY_HIGH, 0, defaultLimits.maxDepth));
+    }
+
+    std::string strMethod, strSetting;
+    if (mapMultiArgs.count("-rpcpriority")) {
+        for (const std::string& strValue : mapMultiArgs.at("-rpcpriority")) {
+            if (!ParseRPCMethodArg("-rpcpriority", strValue, strMethod, strSetting))
+                return false;
+            HTTPWorkPriority priority;
+            if (!ParseRPCPriority(strSetting, priority)) {
+                uiInterface.ThreadSafeMessageBox(
+                    strprintf("Invalid -rpcpriority setting %s: priority must be high, normal or low.", strValue),
+                    "", CClientUIInterface::MSG_ERROR);
+                return false;
+            }
+            mapLimits.emplace(strMethod, defaultLimits).first->second.priority = priority;
+        }
+    }
+    if (mapMultiArgs.count("-rpcmethodthreads")) {
+        for (const std::string& strValue : mapMultiArgs.at("-rpcmethodthreads")) {
+            if (!ParseRPCMethodArg("-rpcmethodthreads", strValue, strMethod, strSetting))
+                return false;
+            int32_t nThreads;
+            if (!ParseInt32(strSetting, &nThreads) || nThreads < 0) {
+                uiInterface.ThreadSafeMessageBox(
+                    strprintf("Invalid -rpcmethodthreads setting %s: expected a number of threads, 0 for no limit.", strValue),
+                    "", CClientUIInterface::MSG_ERROR);
+                return false;
+            }
+            mapLimits.emplace(strMethod, defaultLimits).first->second.maxActive = nThreads;
+        }
+    }
+
+    for (const auto& entry : mapLimits) {
+        LogPrint("rpc", "RPC method %s: priority %d, thread limit %d\n", entry.first, entry.second.priority, entry.second.maxActive);
+        SetHTTPWorkLimits(entry.first, entry.second);
+    }
+    return true;
+}
+
 bool StartHTTPRPC()
 {
     LogPrint("rpc", "Starting HTTP RPC server\n");
     if (!InitRPCAuthentication())
         return false;
+    if (!InitRPCWorkLimits())
+        return false;
 
     RegisterHTTPHandler("/", true, HTTPReq_JSONRPC);
 
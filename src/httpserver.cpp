@@ -58,19 +58,40 @@ private:
     HTTPRequestHandler func;
 };
 
-/** Simple work queue for distributing work over multiple threads.
- * Work items are simply callable objects.
+/** Work queue for distributing work over multiple threads.
+ * Work items are simply callable objects, queued under a named class. Each
+ * class has its own FIFO queue, depth limit and limit on the number of its
+ * items running at once. Workers take the next item from the highest
+ * priority class that may run another item, and classes of equal priority
+ * take turns, so one class cannot starve the others.
  */
 template <typename WorkItem>
 class WorkQueue
 {
 private:
+    struct WorkClass
+    {
+        HTTPWorkLimits limits;
+        //! Queued items with the time they were queued
+        std::deque<std::pair<int64_t, std::unique_ptr<WorkItem>>> queue;
+        int active;
+        //! Value of nRunSequence when an item of this class last started
+        uint64_t nLastRun;
+        HTTPWorkStats stats;
+
+        WorkClass(const HTTPWorkLimits& _limits) : limits(_limits), active(0), nLastRun(0)
+        {
+            memset(&stats, 0, sizeof(stats));
+        }
+    };
+
     /** Mutex protects entire object */
     std::mutex cs;
     std::condition_variable cond;
-    std::deque<std::unique_ptr<WorkItem>> queue;
+    std::map<std::string, WorkClass> classes;
+    HTTPWorkLimits defaultLimits;
+    uint64_t nRunSequence;
     bool running;
-    size_t maxDepth;
     int numThreads;
 
     /** RAII object to keep track of number of running worker threads */
@@ -91,10 +112,34 @@ private:
         }
     };
 
+    WorkClass& GetClass(const std::string& strClass)
+    {
+        auto it = classes.find(strClass);
+        if (it == classes.end())
+            it = classes.emplace(strClass, WorkClass(defaultLimits)).first;
+        return it->second;
+    }
+
+    /** Return the class to take the next item from, or nullptr if none may run now */
+    WorkClass* NextClass()
+    {
+        WorkClass* best = nullptr;
+        for (auto& entry : classes) {
+            WorkClass& wc = entry.second;
+            if (wc.queue.empty() || (wc.limits.maxActive > 0 && wc.active >= wc.limits.maxActive))
+                continue;
+            if (!best || wc.limits.priority > best->limits.priority ||
+                (wc.limits.priority == best->limits.priority && wc.nLastRun < best->nLastRun))
+                best = &wc;
+        }
+        return best;
+    }
+
 public:
-    WorkQueue(size_t _maxDepth) : running(true),
-                                 maxDepth(_maxDepth),
-                                 numThreads(0)
+    WorkQueue(const HTTPWorkLimits& _defaultLimits) : defaultLimits(_defaultLimits),
+                                                      nRunSequence(0),
+                                                      running(true),
+                                                      numThreads(0)
     {
     }
     /** Precondition: worker threads have all stopped
@@ -103,14 +148,29 @@ public:
     ~WorkQueue()
     {
     }
-    /** Enqueue a work item */
-    bool Enqueue(WorkItem* item)
+    /** Set the limits of a class */
+    void SetLimits(const std::string& strClass, const HTTPWorkLimits& limits)
+    {
+        std::unique_lock<std::mutex> lock(cs);
+        GetClass(strClass).limits = limits;
+        cond.notify_all();
+    }
+    /** Return the limits for classes without limits of their own */
+    HTTPWorkLimits DefaultLimits()
+    {
+        std::unique_lock<std::mutex> lock(cs);
+        return defaultLimits;
+    }
+    /** Enqueue a work item, unless fLimitDepth and the queue of its class is full */
+    bool Enqueue(const std::string& strClass, WorkItem* item, bool fLimitDepth)
     {
         std::unique_lock<std::mutex> lock(cs);
-        if (queue.size() >= maxDepth) {
+        WorkClass& wc = GetClass(strClass);
+        if (fLimitDepth && wc.queue.size() >= wc.limits.maxDepth) {
+            wc.stats.nRejected++;
             return false;
         }
-        queue.emplace_back(std::unique_ptr<WorkItem>(item));
+        wc.queue.emplace_back(GetTimeMicros(), std::unique_ptr<WorkItem>(item));
         cond.notify_one();
         return true;
     }
@@ -120,16 +180,34 @@ public:
         ThreadCounter count(*this);
         while (true) {
             std::unique_ptr<WorkItem> i;
+            WorkClass* wc = nullptr;
             {
                 std::unique_lock<std::mutex> lock(cs);
-                while (running && queue.empty())
+                while (running && !(wc = NextClass()))
                     cond.wait(lock);
                 if (!running)
                     break;
-                i = std::move(queue.front());
-                queue.pop_front();
+                int64_t nWait = GetTimeMicros() - wc->queue.front().first;
+                i = std::move(wc->queue.front().second);
+                wc->queue.pop_front();
+                wc->active++;
+                wc->nLastRun = ++nRunSequence;
+                wc->stats.nWaitTotal += nWait;
+                wc->stats.nWaitMax = std::max(wc->stats.nWaitMax, nWait);
             }
+            int64_t nStart = GetTimeMicros();
             (*i)();
+            int64_t nRun = GetTimeMicros() - nStart;
+            {
+                std::unique_lock<std::mutex> lock(cs);
+                wc->active--;
+                wc->stats.nProcessed++;
+                wc->stats.nRunTotal += nRun;
+                wc->stats.nRunMax = std::max(wc->stats.nRunMax, nRun);
+                // A class may have dropped below its limit of running items
+                if (!wc->queue.empty())
+                    cond.notify_one();
+            }
         }
     }
     /** Interrupt and exit loops */
@@ -151,20 +229,42 @@ public:
     size_t Depth()
     {
         std::unique_lock<std::mutex> lock(cs);
-        return queue.size();
+        size_t depth = 0;
+        for (const auto& entry : classes)
+            depth += entry.second.queue.size();
+        return depth;
+    }
+
+    /** Return the counters of every class */
+    std::map<std::string, HTTPWorkStats> Stats()
+    {
+        std::unique_lock<std::mutex> lock(cs);
+        std::map<std::string, HTTPWorkStats> stats;
+        for (const auto& entry : classes) {
+            const WorkClass& wc = entry.second;
+            HTTPWorkStats& s = stats[entry.first];
+            s = wc.stats;
+            s.priority = wc.limits.priority;
+            s.maxActive = wc.limits.maxActive;
+            s.maxDepth = wc.limits.maxDepth;
+            s.depth = wc.queue.size();
+            s.active = wc.active;
+        }
+        return stats;
     }
 };
 
 struct HTTPPathHandler
 {
     HTTPPathHandler() {}
-    HTTPPathHandler(std::string _prefix, bool _exactMatch, HTTPRequestHandler _handler):
-        prefix(_prefix), exactMatch(_exactMatch), handler(_handler)
+    HTTPPathHandler(std::string _prefix, bool _exactMatch, HTTPRequestHandler _handler, std::string _workClass):
+        prefix(_prefix), exactMatch(_exactMatch), handler(_handler), workClass(_workClass)
     {
     }
     std::string prefix;
     bool exactMatch;
     HTTPRequestHandler handler;
+    std::string workClass;
 };
 
 /** HTTP module state */
@@ -286,7 +386,7 @@ static void http_request_cb(struct evhttp_request* req, void* arg)
     if (i != iend) {
         std::unique_ptr<HTTPWorkItem> item(new HTTPWorkItem(std::move(hreq), path, i->handler));
         assert(workQueue);
-        if (workQueue->Enqueue(item.get()))
+        if (workQueue->Enqueue(i->workClass, item.get(), true))
             item.release(); /* if true, queue took ownership */
         else {
             LogPrintf("WARNING: request rejected because http work queue depth exceeded, it can be increased with the -rpcworkqueue= setting\n");
@@ -435,7 +535,12 @@ bool InitHTTPServer()
     int workQueueDepth = std::max((long)GetArg("-rpcworkqueue", DEFAULT_HTTP_WORKQUEUE), 1L);
     LogPrintf("HTTP: creating work queue of depth %d\n", workQueueDepth);
 
-    workQueue = new WorkQueue<HTTPClosure>(workQueueDepth);
+    // By default no single class of work may occupy every worker thread
+    int rpcThreads = std::max((long)GetArg("-rpcthreads", DEFAULT_HTTP_THREADS), 1L);
+    workQueue = new WorkQueue<HTTPClosure>(HTTPWorkLimits(HTTP_PRIORITY_NORMAL, std::max(rpcThreads - 1, 1), workQueueDepth));
+    // Incoming requests only need to be read and routed before handlers can
+    // queue the actual work under a class of their own, so take them first.
+    workQueue->SetLimits(HTTP_REQUEST_WORK_CLASS, HTTPWorkLimits(HTTP_PRIORITY_HIGH, 0, workQueueDepth));
     eventBase = base;
     eventHTTP = http;
     return true;
@@ -482,6 +587,7 @@ void StopHTTPServer()
         LogPrint("http", "Waiting for HTTP worker threads to exit\n");
         workQueue->WaitExit();
         delete workQueue;
+        workQueue = 0;
     }
     if (eventBase) {
         LogPrint("http", "Waiting for HTTP event thread to exit\n");
@@ -508,6 +614,50 @@ void StopHTTPServer()
     LogPrint("http", "Stopped HTTP server\n");
 }
 
+void SetHTTPWorkLimits(const std::string& strClass, const HTTPWorkLimits& limits)
+{
+    assert(workQueue);
+    workQueue->SetLimits(strClass, limits);
+}
+
+HTTPWorkLimits GetHTTPWorkDefaultLimits()
+{
+    assert(workQueue);
+    return workQueue->DefaultLimits();
+}
+
+/** Work item running a closure queued with QueueHTTPWork */
+class HTTPFunctionItem : public HTTPClosure
+{
+public:
+    HTTPFunctionItem(const std::function<void()>& _func) : func(_func) {}
+    void operator()()
+    {
+        func();
+    }
+
+private:
+    std::function<void()> func;
+};
+
+bool QueueHTTPWork(const std::string& strClass, const std::function<void()>& func, bool fLimitDepth)
+{
+    if (!workQueue)
+        return false;
+    std::unique_ptr<HTTPFunctionItem> item(new HTTPFunctionItem(func));
+    if (!workQueue->Enqueue(strClass, item.get(), fLimitDepth))
+        return false;
+    item.release(); /* queue took ownership */
+    return true;
+}
+
+std::map<std::string, HTTPWorkStats> GetHTTPWorkStats()
+{
+    if (!workQueue)
+        return std::map<std::string, HTTPWorkStats>();
+    return workQueue->Stats();
+}
+
 struct event_base* EventBase()
 {
     return eventBase;
@@ -540,12 +690,17 @@ void HTTPEvent::trigger(struct timeval* tv)
         evtimer_add(ev, tv); // trigger after timeval passed
 }
 HTTPRequest::HTTPRequest(struct evhttp_request* _req) : req(_req),
-                                                       replySent(false)
+                                                       replySent(false),
+                                                       chunkedReply(false)
 {
 }
 HTTPRequest::~HTTPRequest()
 {
-    if (!replySent) {
+    if (chunkedReply && !replySent) {
+        // The body is incomplete, but the status has been sent already
+        LogPrintf("%s: Unfinished chunked reply\n", __func__);
+        EndChunkedReply();
+    } else if (!replySent) {
         // Keep track of whether reply was sent to avoid request leaks
         LogPrintf("%s: Unhandled request\n", __func__);
         WriteReply(HTTP_INTERNAL, "Unhandled request");
@@ -598,7 +753,7 @@ void HTTPRequest::WriteHeader(const std::string& hdr, const std::string& value)
  */
 void HTTPRequest::WriteReply(int nStatus, const std::string& strReply)
 {
-    assert(!replySent && req);
+    assert(!replySent && !chunkedReply && req);
     // Send event to main http thread to send reply message
     struct evbuffer* evb = evhttp_request_get_output_buffer(req);
     assert(evb);
@@ -610,6 +765,52 @@ void HTTPRequest::WriteReply(int nStatus, const std::string& strReply)
     req = 0; // transferred back to main thread
 }
 
+/** Chunked replies are sent from the main http thread like WriteReply. Events
+ * are handled in the order they are triggered, so the chunks stay in order.
+ */
+void HTTPRequest::StartChunkedReply(int nStatus)
+{
+    assert(!replySent && !chunkedReply && req);
+    HTTPEvent* ev = new HTTPEvent(eventBase, true,
+        std::bind(evhttp_send_reply_start, req, nStatus, (const char*)NULL));
+    ev->trigger(0);
+    chunkedReply = true;
+}
+
+static void http_send_reply_chunk(struct evhttp_request* req, struct evbuffer* evb)
+{
+    evhttp_send_reply_chunk(req, evb);
+    evbuffer_free(evb);
+}
+
+void HTTPRequest::WriteReplyChunk(const std::string& strChunk)
+{
+    assert(!replySent && chunkedReply && req);
+    struct evbuffer* evb = evbuffer_new();
+    assert(evb);
+    evbuffer_add(evb, strChunk.data(), strChunk.size());
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, std::bind(http_send_reply_chunk, req, evb));
+    ev->trigger(0);
+}
+
+void HTTPRequest::EndChunkedReply()
+{
+    assert(!replySent && chunkedReply && req);
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, std::bind(evhttp_send_reply_end, req));
+    ev->trigger(0);
+    replySent = true;
+    req = 0; // transferred back to main thread
+}
+
+std::unique_ptr<HTTPRequest> HTTPRequest::Detach()
+{
+    assert(!replySent && !chunkedReply && req);
+    std::unique_ptr<HTTPRequest> detached(new HTTPRequest(req));
+    replySent = true;
+    req = 0; // owned by the new object
+    return detached;
+}
+
 CService HTTPRequest::GetPeer()
 {
     evhttp_connection* con = evhttp_request_get_connection(req);
@@ -650,10 +851,10 @@ HTTPRequest::RequestMethod HTTPRequest::GetRequestMethod()
     }
 }
 
-void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler)
+void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler, const std::string& strClass)
 {
-    LogPrint("http", "Registering HTTP handler for %s (exactmatch %d)\n", prefix, exactMatch);
-    pathHandlers.push_back(HTTPPathHandler(prefix, exactMatch, handler));
+    LogPrint("http", "Registering HTTP handler for %s (exactmatch %d, class %s)\n", prefix, exactMatch, strClass);
+    pathHandlers.push_back(HTTPPathHandler(prefix, exactMatch, handler, strClass));
 }
 
 void UnregisterHTTPHandler(const std::string &prefix, bool exactMatch)
@@ -8,11 +8,52 @@
 #include <string>
 #include <stdint.h>
 #include <functional>
+#include <map>
+#include <memory>
 
 static const int DEFAULT_HTTP_THREADS=4;
 static const int DEFAULT_HTTP_WORKQUEUE=16;
 static const int DEFAULT_HTTP_SERVER_TIMEOUT=30;
 
+/** Default work class that incoming HTTP requests are queued under before their handler runs */
+static const char* const HTTP_REQUEST_WORK_CLASS = "http";
+
+/** Scheduling priority of a class of work items, higher runs first */
+enum HTTPWorkPriority {
+    HTTP_PRIORITY_LOW = 0,
+    HTTP_PRIORITY_NORMAL = 1,
+    HTTP_PRIORITY_HIGH = 2,
+};
+
+/** Limits for a class of work items on the HTTP work queue */
+struct HTTPWorkLimits
+{
+    HTTPWorkPriority priority;
+    //! Maximum number of items of this class running at once, 0 for no limit
+    int maxActive;
+    //! Maximum number of items of this class waiting to run
+    size_t maxDepth;
+
+    HTTPWorkLimits(HTTPWorkPriority _priority, int _maxActive, size_t _maxDepth) :
+        priority(_priority), maxActive(_maxActive), maxDepth(_maxDepth) {}
+};
+
+/** Counters for a class of work items on the HTTP work queue. Times are in microseconds. */
+struct HTTPWorkStats
+{
+    HTTPWorkPriority priority;
+    int maxActive;
+    size_t maxDepth;
+    size_t depth;
+    int active;
+    uint64_t nProcessed;
+    uint64_t nRejected;
+    int64_t nWaitTotal;
+    int64_t nWaitMax;
+    int64_t nRunTotal;
+    int64_t nRunMax;
+};
+
 struct evhttp_request;
 struct event_base;
 class CService;
@@ -36,12 +77,31 @@ void StopHTTPServer();
 typedef std::function<bool(HTTPRequest* req, const std::string &)> HTTPRequestHandler;
 /** Register handler for prefix.
  * If multiple handlers match a prefix, the first-registered one will
- * be invoked.
+ * be invoked. Requests for the prefix are queued under work class strClass.
+ * Handlers that do the work of a request themselves, rather than queueing
+ * it under a class of their own, should not use the high priority,
+ * unlimited HTTP_REQUEST_WORK_CLASS.
  */
-void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler);
+void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler, const std::string& strClass = HTTP_REQUEST_WORK_CLASS);
 /** Unregister handler for prefix */
 void UnregisterHTTPHandler(const std::string &prefix, bool exactMatch);
 
+/** Set the limits of a class of work items. Classes without limits of their
+ * own use the defaults derived from -rpcthreads and -rpcworkqueue.
+ */
+void SetHTTPWorkLimits(const std::string& strClass, const HTTPWorkLimits& limits);
+/** Return the default limits for a class of work items */
+HTTPWorkLimits GetHTTPWorkDefaultLimits();
+/** Queue func to run on an HTTP worker thread as part of class strClass.
+ * Items of one class run in order; items of higher priority classes run
+ * first and classes of equal priority take turns.
+ * Returns false if the work queue is stopped, or if fLimitDepth is set and
+ * the queue of that class is full.
+ */
+bool QueueHTTPWork(const std::string& strClass, const std::function<void()>& func, bool fLimitDepth = true);
+/** Return the counters of every class of work items seen so far */
+std::map<std::string, HTTPWorkStats> GetHTTPWorkStats();
+
 /** Return evhttp event base. This can be used by submodules to
  * queue timers or custom events.
  */
@@ -55,6 +115,7 @@ class HTTPRequest
 private:
     struct evhttp_request* req;
     bool replySent;
+    bool chunkedReply;
 
 public:
     HTTPRequest(struct evhttp_request* req);
@@ -110,6 +171,34 @@ public:
      * main thread, do not call any other HTTPRequest methods after calling this.
      */
     void WriteReply(int nStatus, const std::string& strReply = "");
+
+    /**
+     * Start a reply whose body is sent in pieces with WriteReplyChunk, using
+     * chunked transfer encoding, and completed with EndChunkedReply.
+     *
+     * @note call WriteHeader before this, and do not call WriteReply.
+     */
+    void StartChunkedReply(int nStatus);
+
+    /** Send a piece of the body of a reply started with StartChunkedReply */
+    void WriteReplyChunk(const std::string& strChunk);
+
+    /**
+     * Complete a reply started with StartChunkedReply.
+     *
+     * @note As this gives the request back to the main thread, do not call
+     * any other HTTPRequest methods after calling this.
+     */
+    void EndChunkedReply();
+
+    /**
+     * Move the underlying request into a new object, so that a handler can
+     * finish it later from other work items.
+     *
+     * @note This object is left without a request; do not call any other
+     * HTTPRequest methods on it afterwards.
+     */
+    std::unique_ptr<HTTPRequest> Detach();
 };
 
 /** Event handler closure.
@@ -0,0 +1,201 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "index/base.h"
+
+#include "chainparams.h"
+#include "init.h"
+#include "txdb.h"
+#include "ui_interface.h"
+#include "util.h"
+#include "validation.h"
+#include "warnings.h"
+
+#include <functional>
+
+/** How often the sync thread logs its progress and records it on disk (seconds) */
+static const int64_t SYNC_LOG_INTERVAL = 30;
+static const int64_t SYNC_LOCATOR_WRITE_INTERVAL = 30;
+
+static void FatalError(const std::string& strMessage)
+{
+    SetMiscWarning(strMessage);
+    LogPrintf("*** %s\n", strMessage);
+    uiInterface.ThreadSafeMessageBox(
+        _("Error: A fatal internal error occurred, see debug.log for details"),
+        "", CClientUIInterface::MSG_ERROR);
+    StartShutdown();
+}
+
+/** Next block of the active chain to process after pindexPrev, following a
+ *  reorg if pindexPrev is no longer part of it. Requires cs_main. */
+static const CBlockIndex* NextSyncBlock(const CBlockIndex* pindexPrev)
+{
+    AssertLockHeld(cs_main);
+
+    if (!pindexPrev)
+        return chainActive.Genesis();
+
+    const CBlockIndex* pindex = chainActive.Next(pindexPrev);
+    if (pindex)
+        return pindex;
+
+    return chainActive.Next(chainActive.FindFork(pindexPrev));
+}
+
+BaseIndex::BaseIndex() : fSynced(false), pbestBlockIndex(NULL)
+{
+}
+
+BaseIndex::~BaseIndex()
+{
+    Interrupt();
+    Stop();
+}
+
+bool BaseIndex::Init()
+{
+    CBlockLocator locator;
+    if (!pblocktree->ReadIndexBestBlock(GetName(), locator))
+        locator.SetNull();
+
+    LOCK(cs_main);
+    pbestBlockIndex = locator.IsNull() ? NULL : FindForkInGlobalIndex(chainActive, locator);
+    fSynced = pbestBlockIndex.load() == chainActive.Tip();
+    return true;
+}
+
+bool BaseIndex::WriteBestBlock(const CBlockIndex* pindex)
+{
+    if (!pindex)
+        return true;
+
+    LOCK(cs_main);
+    if (!pblocktree->WriteIndexBestBlock(GetName(), chainActive.GetLocator(pindex)))
+        return error("%s: Failed to write locator of %s to disk", __func__, GetName());
+    return true;
+}
+
+void BaseIndex::ThreadSync()
+{
+    const Consensus::Params& consensusParams = Params().GetConsensus();
+    const CBlockIndex* pindex = pbestBlockIndex.load();
+    if (!fSynced) {
+        int64_t nLastLog = 0;
+        int64_t nLastLocatorWrite = GetTime();
+        while (true) {
+            if (interruptSync) {
+                WriteBestBlock(pindex);
+                return;
+            }
+
+            {
+                LOCK(cs_main);
+                const CBlockIndex* pindexNext = NextSyncBlock(pindex);
+                if (!pindexNext) {
+                    fSynced = true;
+                    break;
+                }
+                pindex = pindexNext;
+            }
+
+            int64_t nNow = GetTime();
+            if (nLastLog + SYNC_LOG_INTERVAL < nNow) {
+                LogPrintf("Syncing %s with block chain from height %d\n", GetName(), pindex->nHeight);
+                nLastLog = nNow;
+            }
+            if (nLastLocatorWrite + SYNC_LOCATOR_WRITE_INTERVAL < nNow) {
+                WriteBestBlock(pindex->pprev);
+                nLastLocatorWrite = nNow;
+            }
+
+            CBlock block;
+            if (!ReadBlockFromDisk(block, pindex, consensusParams)) {
+                FatalError(strprintf("%s: Failed to read block %s from disk", __func__, pindex->GetBlockHash().ToString()));
+                return;
+            }
+            if (!WriteBlock(block, pindex)) {
+                FatalError(strprintf("%s: Failed to write block %s to %s", __func__, pindex->GetBlockHash().ToString(), GetName()));
+                return;
+            }
+            pbestBlockIndex = pindex;
+        }
+    }
+
+    if (pindex)
+        LogPrintf("%s is enabled at height %d\n", GetName(), pindex->nHeight);
+    else
+        LogPrintf("%s is enabled\n", GetName());
+}
+
+void BaseIndex::BlockConnected(const std::shared_ptr<const CBlock> &block, const CBlockIndex *pindex)
+{
+    if (!fSynced)
+        return;
+
+    // Notifications are delivered asynchronously, so blocks connected while
+    // the sync thread was catching up may arrive after it wrote them
+    const CBlockIndex* pindexBest = pbestBlockIndex.load();
+    if (pindexBest && pindexBest->GetAncestor(pindex->nHeight) == pindex)
+        return;
+
+    // Disconnected blocks move the best block back, so this only happens if
+    // the index missed a notification. Entries are keyed by content, so
+    // writing the block anyway leaves the index consistent.
+    if (pindex->pprev != pindexBest)
+        LogPrintf("%s: WARNING: Block %s does not connect to the best block of %s\n", __func__, pindex->GetBlockHash().ToString(), GetName());
+
+    if (!WriteBlock(*block, pindex)) {
+        FatalError(strprintf("%s: Failed to write block %s to %s", __func__, pindex->GetBlockHash().ToString(), GetName()));
+        return;
+    }
+    pbestBlockIndex = pindex;
+}
+
+void BaseIndex::BlockDisconnected(const std::shared_ptr<const CBlock> &block, const CBlockIndex *pindex)
+{
+    if (!fSynced)
+        return;
+
+    if (pbestBlockIndex.load() == pindex)
+        pbestBlockIndex = pindex->pprev;
+}
+
+void BaseIndex::SetBestChain(const CBlockLocator &locator)
+{
+    if (!fSynced)
+        return;
+
+    WriteBestBlock(pbestBlockIndex);
+}
+
+bool BaseIndex::Start()
+{
+    if (!Init())
+        return false;
+
+    // Subscribe before the sync thread can declare the index synced, so
+    // that BlockConnected picks up right after the last block it read.
+    // Index writes then happen on the scheduler thread rather than while
+    // the block is connected.
+    RegisterValidationInterface(this, true);
+    threadSync = std::thread(&TraceThread<std::function<void()> >, GetName(), std::function<void()>(std::bind(&BaseIndex::ThreadSync, this)));
+    return true;
+}
+
+void BaseIndex::Interrupt()
+{
+    interruptSync();
+}
+
+void BaseIndex::Stop()
+{
+    UnregisterValidationInterface(this);
+
+    if (threadSync.joinable()) {
+        threadSync.join();
+        if (fSynced)
+            WriteBestBlock(pbestBlockIndex);
+    }
+}
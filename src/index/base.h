@@ -0,0 +1,77 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_INDEX_BASE_H
+#define BITCOIN_INDEX_BASE_H
+
+#include "threadinterrupt.h"
+#include "validationinterface.h"
+
+#include <atomic>
+#include <thread>
+
+class CBlock;
+class CBlockIndex;
+
+/**
+ * Base class for indexes that are built from the stored blocks by a
+ * background thread, so that they can be enabled on a node that is already
+ * synced. The index records the locator of the last block it processed in
+ * the block tree database and resumes from there after a restart. Once it
+ * has caught up with the active chain, it is kept current through the
+ * validation interface.
+ */
+class BaseIndex : public CValidationInterface
+{
+private:
+    /** Whether the index has caught up with the active chain. Set with
+     *  cs_main held, so that every block connected afterwards reaches
+     *  BlockConnected; blocks the sync thread already wrote are skipped
+     *  there. */
+    std::atomic<bool> fSynced;
+
+    /** Last block whose entries have been written to the index */
+    std::atomic<const CBlockIndex*> pbestBlockIndex;
+
+    std::thread threadSync;
+    CThreadInterrupt interruptSync;
+
+    /** Catch up with the active chain, reading blocks from disk */
+    void ThreadSync();
+
+    /** Record pindex as the last block processed by the index */
+    bool WriteBestBlock(const CBlockIndex* pindex);
+
+protected:
+    void BlockConnected(const std::shared_ptr<const CBlock> &block, const CBlockIndex *pindex) override;
+    void BlockDisconnected(const std::shared_ptr<const CBlock> &block, const CBlockIndex *pindex) override;
+    void SetBestChain(const CBlockLocator &locator) override;
+
+    /** Load the last block processed by the index. Called by Start(). */
+    virtual bool Init();
+
+    /** Write the index entries of a block of the active chain */
+    virtual bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) = 0;
+
+    /** Name of the index, used in the log and as its key in the block tree database */
+    virtual const char* GetName() const = 0;
+
+public:
+    BaseIndex();
+    virtual ~BaseIndex();
+
+    /** Subscribe to the validation interface and start the sync thread */
+    bool Start();
+
+    /** Ask the sync thread to stop at the next block */
+    void Interrupt();
+
+    /** Unsubscribe, wait for the sync thread and record the last block processed */
+    void Stop();
+
+    bool IsSynced() const { return fSynced; }
+    const CBlockIndex* GetBestBlock() const { return pbestBlockIndex; }
+};
+
+#endif // BITCOIN_INDEX_BASE_H
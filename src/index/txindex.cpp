@@ -0,0 +1,61 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "index/txindex.h"
+
+#include "chain.h"
+#include "txdb.h"
+#include "util.h"
+#include "validation.h"
+
+static const char* const TXINDEX_NAME = "txindex";
+
+std::unique_ptr<TxIndex> g_txindex;
+
+bool TxIndex::Init()
+{
+    // Before it was built in the background, the index was written by
+    // ConnectBlock and only marked by the "txindex" flag. Such an index is
+    // complete up to the tip, so record that as its best block.
+    CBlockLocator locator;
+    bool fLegacy = false;
+    if (!pblocktree->ReadIndexBestBlock(GetName(), locator) && pblocktree->ReadFlag(TXINDEX_NAME, fLegacy) && fLegacy) {
+        LOCK(cs_main);
+        LogPrintf("%s: using transaction index built up to height %d\n", __func__, chainActive.Height());
+        if (chainActive.Tip() && !pblocktree->WriteIndexBestBlock(GetName(), chainActive.GetLocator()))
+            return error("%s: Failed to write locator of %s to disk", __func__, GetName());
+        if (!pblocktree->WriteFlag(TXINDEX_NAME, false))
+            return error("%s: Failed to write flag to disk", __func__);
+    }
+
+    return BaseIndex::Init();
+}
+
+bool TxIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex)
+{
+    CDiskTxPos pos(pindex->GetBlockPos(), GetSizeOfCompactSize(block.vtx.size()));
+    std::vector<std::pair<uint256, CDiskTxPos> > vPos;
+    vPos.reserve(block.vtx.size());
+    for (const auto& tx : block.vtx) {
+        vPos.push_back(std::make_pair(tx->GetHash(), pos));
+        pos.nTxOffset += ::GetSerializeSize(*tx, SER_DISK, CLIENT_VERSION);
+    }
+    return pblocktree->WriteTxIndex(vPos);
+}
+
+const char* TxIndex::GetName() const
+{
+    return TXINDEX_NAME;
+}
+
+bool DropTxIndex()
+{
+    CBlockLocator locator;
+    bool fLegacy = false;
+    if (!pblocktree->ReadIndexBestBlock(TXINDEX_NAME, locator) && !(pblocktree->ReadFlag(TXINDEX_NAME, fLegacy) && fLegacy))
+        return true;
+
+    LogPrintf("Disabling transaction index, enabling it again rebuilds it\n");
+    return pblocktree->EraseIndexBestBlock(TXINDEX_NAME) && pblocktree->WriteFlag(TXINDEX_NAME, false);
+}
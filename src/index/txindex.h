@@ -0,0 +1,32 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_INDEX_TXINDEX_H
+#define BITCOIN_INDEX_TXINDEX_H
+
+#include "index/base.h"
+
+#include <memory>
+
+/**
+ * The -txindex transaction index: the position on disk of every transaction
+ * of the active chain, keyed by txid, used by GetTransaction.
+ */
+class TxIndex : public BaseIndex
+{
+protected:
+    bool Init() override;
+    bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) override;
+    const char* GetName() const override;
+};
+
+/** The transaction index, when enabled with -txindex */
+extern std::unique_ptr<TxIndex> g_txindex;
+
+/** Forget how far the transaction index was built, so that enabling it
+ *  again rebuilds it from the genesis block. The entries are left in place
+ *  and overwritten by the rebuild. */
+bool DropTxIndex();
+
+#endif // BITCOIN_INDEX_TXINDEX_H
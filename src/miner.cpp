@@ -6,12 +6,14 @@
 #include "miner.h"
 
 #include "amount.h"
+#include "auxpow.h"
 #include "chain.h"
 #include "chainparams.h"
 #include "coins.h"
 #include "consensus/consensus.h"
 #include "consensus/merkle.h"
 #include "consensus/validation.h"
+#include "crypto/hashlanes.h"
 #include "hash.h"
 #include "validation.h"
 #include "net.h"
@@ -26,6 +28,10 @@
 #include "validationinterface.h"
 
 #include <algorithm>
+#include <atomic>
+#include <limits>
+#include <mutex>
+#include <thread>
 #include <boost/thread.hpp>
 #include <boost/tuple/tuple.hpp>
 #include <queue>
@@ -638,6 +644,16 @@ void BlockAssembler::addPriorityTxs()
     fNeedSizeAccounting = fSizeAccounting;
 }
 
+void SetExtraNonce(CBlock* pblock, int nHeight, unsigned int nExtraNonce)
+{
+    CMutableTransaction txCoinbase(*pblock->vtx[0]);
+    txCoinbase.vin[0].scriptSig = (CScript() << nHeight << CScriptNum(nExtraNonce)) + COINBASE_FLAGS;
+    assert(txCoinbase.vin[0].scriptSig.size() <= 100);
+
+    pblock->vtx[0] = MakeTransactionRef(std::move(txCoinbase));
+    pblock->hashMerkleRoot = BlockMerkleRoot(*pblock);
+}
+
 void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned int& nExtraNonce)
 {
     // Update nExtraNonce
@@ -648,11 +664,113 @@ void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned
         hashPrevBlock = pblock->hashPrevBlock;
     }
     ++nExtraNonce;
-    unsigned int nHeight = pindexPrev->nHeight+1; // Height first in coinbase required for block.version=2
-    CMutableTransaction txCoinbase(*pblock->vtx[0]);
-    txCoinbase.vin[0].scriptSig = (CScript() << nHeight << CScriptNum(nExtraNonce)) + COINBASE_FLAGS;
-    assert(txCoinbase.vin[0].scriptSig.size() <= 100);
+    SetExtraNonce(pblock, pindexPrev->nHeight+1, nExtraNonce); // Height first in coinbase required for block.version=2
+}
 
-    pblock->vtx[0] = MakeTransactionRef(std::move(txCoinbase));
-    pblock->hashMerkleRoot = BlockMerkleRoot(*pblock);
+namespace {
+
+/** Shared state of the workers of one SolveBlock call */
+struct CSolveState
+{
+    const CBlock* pblockTemplate;
+    const CBlockIndex* pindexPrev;
+    int algo;
+    const Consensus::Params* pparams;
+
+    std::atomic<unsigned int> nExtraNonce;
+    std::atomic<int64_t> nTriesLeft;
+    std::atomic<bool> fStop;
+    bool fStale;
+
+    std::mutex mutexResult;
+    bool fFound;
+    CBlock blockFound;
+};
+
+void SolveBlockWorker(CSolveState& state)
+{
+    const int nHeight = state.pindexPrev->nHeight + 1;
+    while (!state.fStop) {
+        // Each pass works on an extranonce no other worker uses, so the
+        // parent header nonce ranges of the workers never overlap.
+        CBlock block(*state.pblockTemplate);
+        SetExtraNonce(&block, nHeight, ++state.nExtraNonce);
+        CAuxPow::initAuxPow(block);
+        CPureBlockHeader& miningHeader = block.auxpow->parentBlock;
+        // Let the parent header select the hash function of the current era.
+        miningHeader.nTime = block.nTime;
+
+        // Hash HASH_LANES nonces at once where the algo has a batch PoW hash.
+        const unsigned int nBatch = miningHeader.HasBatchPoWHash(state.algo, *state.pparams) ? HASH_LANES : 1;
+        CPureBlockHeader vHeaders[HASH_LANES];
+        const CPureBlockHeader* vpHeaders[HASH_LANES];
+        uint256 vHashPoW[HASH_LANES];
+        for (unsigned int i = 0; i < nBatch; i++)
+            vpHeaders[i] = &vHeaders[i];
+
+        for (uint32_t nNonce = 0; nNonce < SOLVE_INNER_LOOP_COUNT; nNonce += nBatch) {
+            if (state.fStop)
+                return;
+            if ((state.nTriesLeft -= nBatch) < 0) {
+                state.fStop = true;
+                return;
+            }
+            for (unsigned int i = 0; i < nBatch; i++) {
+                vHeaders[i] = miningHeader;
+                vHeaders[i].nNonce = nNonce + i;
+            }
+            GetPoWHashes(vpHeaders, nBatch, state.algo, *state.pparams, vHashPoW);
+            for (unsigned int i = 0; i < nBatch; i++) {
+                if (CheckProofOfWork(vHashPoW[i], state.algo, block.nBits, *state.pparams)) {
+                    miningHeader.nNonce = vHeaders[i].nNonce;
+                    std::lock_guard<std::mutex> lock(state.mutexResult);
+                    if (!state.fFound) {
+                        state.fFound = true;
+                        state.blockFound = block;
+                    }
+                    state.fStop = true;
+                    return;
+                }
+            }
+            if (((nNonce + nBatch) & 0xff) == 0) {
+                LOCK(cs_main);
+                if (chainActive.Tip() != state.pindexPrev) {
+                    std::lock_guard<std::mutex> lock(state.mutexResult);
+                    state.fStale = true;
+                    state.fStop = true;
+                    return;
+                }
+            }
+        }
+    }
+}
+
+} // anon namespace
+
+bool SolveBlock(CBlock& block, const CBlockIndex* pindexPrev, int algo, const Consensus::Params& consensusParams, int nThreads, unsigned int& nExtraNonce, uint64_t& nMaxTries)
+{
+    assert(nThreads > 0);
+    CSolveState state;
+    state.pblockTemplate = &block;
+    state.pindexPrev = pindexPrev;
+    state.algo = algo;
+    state.pparams = &consensusParams;
+    state.nExtraNonce = nExtraNonce;
+    state.nTriesLeft = std::min(nMaxTries, (uint64_t)std::numeric_limits<int64_t>::max());
+    state.fStop = false;
+    state.fStale = false;
+    state.fFound = false;
+
+    std::vector<std::thread> vWorkers;
+    for (int i = 1; i < nThreads; i++)
+        vWorkers.push_back(std::thread(SolveBlockWorker, std::ref(state)));
+    SolveBlockWorker(state);
+    for (std::thread& worker : vWorkers)
+        worker.join();
+
+    nExtraNonce = state.nExtraNonce;
+    nMaxTries = std::max<int64_t>(state.nTriesLeft, 0);
+    if (state.fFound)
+        block = state.blockFound;
+    return state.fFound;
 }
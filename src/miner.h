@@ -23,6 +23,10 @@ class CWallet;
 namespace Consensus { struct Params; };
 
 static const bool DEFAULT_PRINTPRIORITY = false;
+/** Default for -genproclimit, the number of threads used by the generate RPCs */
+static const int DEFAULT_GENERATE_THREADS = 1;
+/** Number of parent header nonces tried per extranonce by SolveBlock */
+static const unsigned int SOLVE_INNER_LOOP_COUNT = 0x10000;
 
 struct CBlockTemplate
 {
@@ -73,7 +77,7 @@ struct modifiedentry_iter {
 // except operating on CTxMemPoolModifiedEntry.
 // TODO: refactor to avoid duplication of this logic.
 struct CompareModifiedEntry {
-    bool operator()(const CTxMemPoolModifiedEntry &a, const CTxMemPoolModifiedEntry &b)
+    bool operator()(const CTxMemPoolModifiedEntry &a, const CTxMemPoolModifiedEntry &b) const
     {
         double f1 = (double)a.nModFeesWithAncestors * b.nSizeWithAncestors;
         double f2 = (double)b.nModFeesWithAncestors * a.nSizeWithAncestors;
@@ -209,8 +213,21 @@ private:
     int UpdatePackagesForAdded(const CTxMemPool::setEntries& alreadyAdded, indexed_modified_transaction_set &mapModifiedTx);
 };
 
+/** Set the extranonce in the coinbase of a block at height nHeight and update its merkle root */
+void SetExtraNonce(CBlock* pblock, int nHeight, unsigned int nExtraNonce);
 /** Modify the extranonce in a block */
 void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned int& nExtraNonce);
+/**
+ * Solve the proof of work of a block template on top of pindexPrev as a
+ * merge-mined block, grinding the auxpow parent header with the PoW hash of
+ * algo on nThreads threads. Every worker takes the next extranonce after
+ * nExtraNonce whenever it has tried SOLVE_INNER_LOOP_COUNT nonces.
+ * Returns true and stores the solved block in block if a solution is found.
+ * Returns false once nMaxTries hashes have been tried (nMaxTries is then
+ * zero) or if the tip moved away from pindexPrev. nExtraNonce and nMaxTries
+ * are updated with what has been used up.
+ */
+bool SolveBlock(CBlock& block, const CBlockIndex* pindexPrev, int algo, const Consensus::Params& consensusParams, int nThreads, unsigned int& nExtraNonce, uint64_t& nMaxTries);
 int64_t UpdateTime(CBlockHeader* pblock, const Consensus::Params& consensusParams, const CBlockIndex* pindexPrev);
 
 #endif // BITCOIN_MINER_H
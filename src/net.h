@@ -26,6 +26,7 @@
 #include <stdint.h>
 #include <thread>
 #include <memory>
+#include <set>
 #include <condition_variable>
 
 #ifndef WIN32
@@ -93,6 +94,26 @@ static const bool DEFAULT_FORCEDNSSEED = false;
 static const size_t DEFAULT_MAXRECEIVEBUFFER = 5 * 1000;
 static const size_t DEFAULT_MAXSENDBUFFER    = 1 * 1000;
 
+/** Default number of message handler threads */
+static const int DEFAULT_MESSAGE_HANDLER_THREADS = 1;
+/** Maximum number of message handler threads */
+static const int MAX_MESSAGE_HANDLER_THREADS = 16;
+
+/** How the socket handler thread waits for socket readiness */
+enum SocketEventsMode
+{
+    SOCKETEVENTS_SELECT, // select(), limited to descriptors below FD_SETSIZE
+    SOCKETEVENTS_EPOLL,  // edge-triggered epoll (Linux), no descriptor limit
+};
+/** -socketevents default */
+#ifdef HAVE_SYS_EPOLL_H
+static const char* const DEFAULT_SOCKETEVENTS = "epoll";
+#else
+static const char* const DEFAULT_SOCKETEVENTS = "select";
+#endif
+/** Parse a -socketevents value, returns false if it is unknown or unsupported on this platform */
+bool ParseSocketEventsMode(const std::string& str, SocketEventsMode& mode);
+
 static const ServiceFlags REQUIRED_SERVICES = NODE_NETWORK;
 
 // NOTE: When adjusting this, update rpcnet:setban's help ("24h")
@@ -151,6 +172,8 @@ public:
         unsigned int nReceiveFloodSize = 0;
         uint64_t nMaxOutboundTimeframe = 0;
         uint64_t nMaxOutboundLimit = 0;
+        SocketEventsMode socketEventsMode = SOCKETEVENTS_SELECT;
+        int nMessageHandlerThreads = DEFAULT_MESSAGE_HANDLER_THREADS;
     };
     CConnman(uint64_t seed0, uint64_t seed1);
     ~CConnman();
@@ -291,7 +314,10 @@ public:
 
     unsigned int GetReceiveFloodSize() const;
 
+    /** Wake up all message handler threads */
     void WakeMessageHandler();
+    /** Wake up the message handler thread that serves pnode */
+    void WakeMessageHandler(const CNode* pnode);
 private:
     struct ListenSocket {
         SOCKET socket;
@@ -300,12 +326,34 @@ private:
         ListenSocket(SOCKET socket_, bool whitelisted_) : socket(socket_), whitelisted(whitelisted_) {}
     };
 
+    /** A message handler thread. Each peer is served by exactly one of them,
+     *  picked by its id, so its messages are processed in order. */
+    struct MessageHandler {
+        std::string strName;
+        std::thread thread;
+        std::mutex mutex;
+        std::condition_variable cond;
+        /** flag for waking the message processor. */
+        bool fWake;
+
+        MessageHandler(const std::string& strNameIn) : strName(strNameIn), fWake(false) {}
+    };
+
     void ThreadOpenAddedConnections();
     void ProcessOneShot();
     void ThreadOpenConnections();
-    void ThreadMessageHandler();
+    void ThreadMessageHandler(MessageHandler* handler);
+    MessageHandler* GetMessageHandler(const CNode* pnode) const;
     void AcceptConnection(const ListenSocket& hListenSocket);
     void ThreadSocketHandler();
+    void SocketHandlerSelect();
+    void SocketHandlerEpoll();
+    /** Add a new connection to vNodes and start watching its socket */
+    void InsertNode(CNode* pnode);
+    bool AddSocketEvents(SOCKET hSocket, uint64_t nData, uint32_t nEvents);
+    /** Read once from the node's socket; returns true if the read filled the buffer, so more data may be pending */
+    bool SocketRecvData(CNode* pnode);
+    void InactivityCheck(CNode* pnode);
     void ThreadDNSAddressSeed();
 
     uint64_t CalculateKeyedNetGroup(const CAddress& ad) const;
@@ -375,6 +423,18 @@ private:
     std::vector<CNode*> vNodes;
     std::list<CNode*> vNodesDisconnected;
     mutable CCriticalSection cs_vNodes;
+    /** The nodes in vNodes, by id (guarded by cs_vNodes) */
+    std::map<NodeId, CNode*> mapNodesById;
+
+    SocketEventsMode socketEventsMode;
+    int epollfd;
+    /** Nodes whose socket reported readable data which has not been drained
+     *  yet (epoll only, socket handler thread only) */
+    std::set<CNode*> setNodesRecvReady;
+    /** Nodes whose send queue was not flushed by the optimistic write (epoll only) */
+    std::set<CNode*> setNodesSendPending;
+    CCriticalSection cs_setNodesSendPending;
+    int64_t nLastInactivityCheck;
     std::atomic<NodeId> nLastNodeId;
 
     /** Services this instance offers */
@@ -395,11 +455,7 @@ private:
     /** SipHasher seeds for deterministic randomness */
     const uint64_t nSeed0, nSeed1;
 
-    /** flag for waking the message processor. */
-    bool fMsgProcWake;
-
-    std::condition_variable condMsgProc;
-    std::mutex mutexMsgProc;
+    std::vector<std::unique_ptr<MessageHandler> > vMessageHandlers;
     std::atomic<bool> flagInterruptMsgProc;
 
     CThreadInterrupt interruptNet;
@@ -408,7 +464,6 @@ private:
     std::thread threadSocketHandler;
     std::thread threadOpenAddedConnections;
     std::thread threadOpenConnections;
-    std::thread threadMessageHandler;
 };
 extern std::unique_ptr<CConnman> g_connman;
 void Discover(boost::thread_group& threadGroup);
@@ -636,6 +691,9 @@ public:
     std::atomic<int> nStartingHeight;
 
     // flood relay
+    // vAddrToSend and addrKnown are also written by the message handler
+    // threads of other peers (address relay), so they need their own lock.
+    CCriticalSection cs_addrSend;
     std::vector<CAddress> vAddrToSend;
     CRollingBloomFilter addrKnown;
     bool fGetAddr;
@@ -758,6 +816,7 @@ public:
 
     void AddAddressKnown(const CAddress& _addr)
     {
+        LOCK(cs_addrSend);
         addrKnown.insert(_addr.GetKey());
     }
 
@@ -766,6 +825,7 @@ public:
         // Known checking here is only to save space from duplicates.
         // SendMessages will filter it again for knowns that were added
         // after addresses were pushed.
+        LOCK(cs_addrSend);
         if (_addr.IsValid() && !addrKnown.contains(_addr.GetKey())) {
             if (vAddrToSend.size() >= MAX_ADDR_TO_SEND) {
                 vAddrToSend[insecure_rand.rand32() % vAddrToSend.size()] = _addr;
@@ -62,6 +62,9 @@ unsigned int GetNextWorkRequired(const CBlockIndex* pindexLast, const CBlockHead
     const CBlockIndex* pindexPrev = GetLastBlockIndexForAlgo(pindexLast, algo);
     if (pindexPrev == NULL)
         return nProofOfWorkLimit.GetCompact();
+
+    if (params.fPowNoRetargeting)
+        return pindexPrev->nBits;
     
     const CBlockIndex* pindexFirst = pindexPrev;
    
@@ -65,6 +65,46 @@ uint256 CPureBlockHeader::GetPoWHash(int algo, const Consensus::Params& consensu
         return HashBlake(BEGIN(nVersion), END(nNonce));
 }
 
+bool CPureBlockHeader::HasBatchPoWHash(int algo, const Consensus::Params& consensusParams) const
+{
+    switch (algo)
+    {
+        case ALGO_SLOT3:
+            return nTime < consensusParams.nTimeArgon2dStart;
+        case ALGO_SLOT5:
+            return true;
+    }
+    return false;
+}
+
+void GetPoWHashes(const CPureBlockHeader* const* ppheaders, size_t nCount, int algo, const Consensus::Params& consensusParams, uint256* phashes)
+{
+    std::vector<const unsigned char*> vpdata;
+    std::vector<size_t> vIndex;
+    vpdata.reserve(nCount);
+    vIndex.reserve(nCount);
+    for (size_t i = 0; i < nCount; i++) {
+        const CPureBlockHeader& header = *ppheaders[i];
+        if (header.HasBatchPoWHash(algo, consensusParams)) {
+            vpdata.push_back((const unsigned char*)BEGIN(header.nVersion));
+            vIndex.push_back(i);
+        } else {
+            phashes[i] = header.GetPoWHash(algo, consensusParams);
+        }
+    }
+    if (vpdata.empty())
+        return;
+
+    const size_t nLen = END(ppheaders[0]->nNonce) - BEGIN(ppheaders[0]->nVersion);
+    std::vector<uint256> vHash(vpdata.size());
+    if (algo == ALGO_SLOT5)
+        HashX11Batch(&vpdata[0], nLen, &vHash[0], vpdata.size());
+    else
+        HashQubitBatch(&vpdata[0], nLen, &vHash[0], vpdata.size());
+    for (size_t i = 0; i < vIndex.size(); i++)
+        phashes[vIndex[i]] = vHash[i];
+}
+
 void CPureBlockHeader::SetBaseVersion(int32_t nBaseVersion, int32_t nChainId)
 {
     assert(nBaseVersion >= 1 && nBaseVersion < VERSION_AUXPOW);
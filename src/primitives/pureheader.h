@@ -98,6 +98,9 @@ public:
     uint256 GetHash() const;
 
     uint256 GetPoWHash(int algo, const Consensus::Params& consensusParams) const;
+
+    /** Whether GetPoWHashes hashes this header for algo together with others */
+    bool HasBatchPoWHash(int algo, const Consensus::Params& consensusParams) const;
     
     int64_t GetBlockTime() const
     {
@@ -213,4 +216,11 @@ public:
     }
 };
 
+/**
+ * Set phashes[i] to ppheaders[i]->GetPoWHash(algo, consensusParams) for the
+ * nCount headers. Those with HasBatchPoWHash are hashed together, several at
+ * a time, which is faster than hashing them one by one.
+ */
+void GetPoWHashes(const CPureBlockHeader* const* ppheaders, size_t nCount, int algo, const Consensus::Params& consensusParams, uint256* phashes);
+
 #endif // BITCOIN_PRIMITIVES_PUREHEADER_H
@@ -0,0 +1,194 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "rpc/auxpow_miner.h"
+
+#include "chain.h"
+#include "chainparams.h"
+#include "miner.h"
+#include "rpc/server.h"
+#include "txmempool.h"
+#include "util.h"
+#include "utiltime.h"
+#include "validation.h"
+
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/thread.hpp>
+
+std::unique_ptr<CAuxpowMiner> g_auxpow_miner;
+
+CAuxpowMiner::CAuxpowMiner() : pindexTip(NULL), nExtraNonce(0)
+{
+}
+
+void CAuxpowMiner::Start(boost::thread_group& threadGroup)
+{
+    threadGroup.create_thread(boost::bind(&TraceThread<boost::function<void()> >, "auxwork", boost::function<void()>(boost::bind(&CAuxpowMiner::ThreadBuild, this))));
+}
+
+const CBlockIndex* CAuxpowMiner::GetTip()
+{
+    const CBlockIndex* pindex = pindexTip;
+    if (pindex == NULL) {
+        LOCK(cs_main);
+        pindex = chainActive.Tip();
+        pindexTip = pindex;
+    }
+    return pindex;
+}
+
+void CAuxpowMiner::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload)
+{
+    pindexTip = pindexNew;
+
+    // Rebuild the work that is still being asked for, and forget the rest.
+    const int64_t nNow = GetTime();
+    for (int algo = 0; algo < NUM_ALGOS; algo++) {
+        CAlgoWork& work = vAlgoWork[algo];
+        LOCK(work.cs);
+        std::map<CScript, CCurrentWork>::iterator it = work.mapCurrent.begin();
+        while (it != work.mapCurrent.end()) {
+            if (it->second.nLastRequest < nNow - MAX_AUXBLOCK_AGE) {
+                work.mapCurrent.erase(it++);
+            } else {
+                QueueBuild(algo, it->first);
+                ++it;
+            }
+        }
+    }
+}
+
+void CAuxpowMiner::QueueBuild(int algo, const CScript& scriptPubKey)
+{
+    boost::unique_lock<boost::mutex> lock(mutexPending);
+    setPending.insert(std::make_pair(algo, scriptPubKey));
+    condPending.notify_one();
+}
+
+void CAuxpowMiner::ThreadBuild()
+{
+    while (true) {
+        std::pair<int, CScript> job;
+        {
+            boost::unique_lock<boost::mutex> lock(mutexPending);
+            while (setPending.empty())
+                condPending.wait(lock);
+            job = *setPending.begin();
+            setPending.erase(setPending.begin());
+        }
+
+        CAlgoWork& work = vAlgoWork[job.first];
+        LOCK(work.csBuild);
+        const CBlockIndex* pindexPrev = GetTip();
+        int64_t nLastRequest;
+        {
+            LOCK(work.cs);
+            std::map<CScript, CCurrentWork>::const_iterator it = work.mapCurrent.find(job.second);
+            if (it == work.mapCurrent.end())
+                continue;
+            // A request may have built it already in the meantime.
+            if (it->second.pindexPrev == pindexPrev && it->second.nTransactionsUpdated == mempool.GetTransactionsUpdated())
+                continue;
+            nLastRequest = it->second.nLastRequest;
+        }
+        try {
+            Build(job.first, job.second, nLastRequest);
+        } catch (const std::exception& e) {
+            LogPrintf("%s: failed to create auxpow block: %s\n", __func__, e.what());
+        } catch (const UniValue& objError) {
+            LogPrintf("%s: failed to create auxpow block: %s\n", __func__, find_value(objError, "message").get_str());
+        }
+    }
+}
+
+std::shared_ptr<const CBlock> CAuxpowMiner::Build(int algo, const CScript& scriptPubKey, int64_t nLastRequest)
+{
+    CAlgoWork& work = vAlgoWork[algo];
+    AssertLockHeld(work.csBuild);
+
+    CCurrentWork current;
+    current.nTransactionsUpdated = mempool.GetTransactionsUpdated();
+    std::unique_ptr<CBlockTemplate> pblocktemplate(BlockAssembler(Params()).CreateNewBlock(scriptPubKey, algo));
+    if (!pblocktemplate)
+        throw JSONRPCError(RPC_OUT_OF_MEMORY, "out of memory");
+    CBlock& block = pblocktemplate->block;
+    {
+        LOCK(cs_main);
+        BlockMap::const_iterator mi = mapBlockIndex.find(block.hashPrevBlock);
+        assert(mi != mapBlockIndex.end());
+        current.pindexPrev = mi->second;
+    }
+
+    // Finalise it by setting the version and building the merkle root
+    SetExtraNonce(&block, current.pindexPrev->nHeight + 1, ++nExtraNonce);
+    block.SetAuxpowVersion(true);
+
+    std::shared_ptr<const CBlock> pblock = std::make_shared<const CBlock>(block);
+    current.pblock = pblock;
+    current.nTime = GetTime();
+    current.nLastRequest = nLastRequest;
+
+    LOCK(work.cs);
+    work.mapCurrent[scriptPubKey] = current;
+    const uint256 hash = pblock->GetHash();
+    CSavedBlock& saved = work.mapSaved[hash];
+    saved.pblock = pblock;
+    saved.nTime = current.nTime;
+    work.dequeSaved.push_back(hash);
+    while (work.dequeSaved.size() > MAX_AUXBLOCKS_SAVED || work.mapSaved[work.dequeSaved.front()].nTime < current.nTime - MAX_AUXBLOCK_AGE) {
+        work.mapSaved.erase(work.dequeSaved.front());
+        work.dequeSaved.pop_front();
+    }
+    return pblock;
+}
+
+std::shared_ptr<const CBlock> CAuxpowMiner::GetCurrentBlock(int algo, const CScript& scriptPubKey, const CBlockIndex*& pindexPrev)
+{
+    assert(algo >= 0 && algo < NUM_ALGOS);
+    CAlgoWork& work = vAlgoWork[algo];
+    const int64_t nNow = GetTime();
+    pindexPrev = GetTip();
+
+    {
+        LOCK(work.cs);
+        std::map<CScript, CCurrentWork>::iterator it = work.mapCurrent.find(scriptPubKey);
+        if (it != work.mapCurrent.end() && it->second.pindexPrev == pindexPrev) {
+            it->second.nLastRequest = nNow;
+            if (it->second.nTransactionsUpdated != mempool.GetTransactionsUpdated()
+                && nNow - it->second.nTime > AUXBLOCK_MEMPOOL_REFRESH)
+                QueueBuild(algo, scriptPubKey);
+            return it->second.pblock;
+        }
+    }
+
+    // There is no work on the current tip yet. Build it here, unless another
+    // request or the background thread did so while we waited for csBuild.
+    LOCK(work.csBuild);
+    pindexPrev = GetTip();
+    {
+        LOCK(work.cs);
+        std::map<CScript, CCurrentWork>::iterator it = work.mapCurrent.find(scriptPubKey);
+        if (it != work.mapCurrent.end() && it->second.pindexPrev == pindexPrev) {
+            it->second.nLastRequest = nNow;
+            return it->second.pblock;
+        }
+    }
+    std::shared_ptr<const CBlock> pblock = Build(algo, scriptPubKey, nNow);
+    LOCK(work.cs);
+    pindexPrev = work.mapCurrent[scriptPubKey].pindexPrev;
+    return pblock;
+}
+
+std::shared_ptr<const CBlock> CAuxpowMiner::LookupSavedBlock(const uint256& hash)
+{
+    for (int algo = 0; algo < NUM_ALGOS; algo++) {
+        CAlgoWork& work = vAlgoWork[algo];
+        LOCK(work.cs);
+        std::map<uint256, CSavedBlock>::const_iterator it = work.mapSaved.find(hash);
+        if (it != work.mapSaved.end())
+            return it->second.pblock;
+    }
+    return NULL;
+}
@@ -0,0 +1,125 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_RPC_AUXPOW_MINER_H
+#define BITCOIN_RPC_AUXPOW_MINER_H
+
+#include "primitives/block.h"
+#include "primitives/pureheader.h"
+#include "script/script.h"
+#include "sync.h"
+#include "uint256.h"
+#include "validationinterface.h"
+
+#include <atomic>
+#include <deque>
+#include <map>
+#include <memory>
+#include <set>
+#include <utility>
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+class CBlockIndex;
+
+namespace boost {
+    class thread_group;
+} // namespace boost
+
+/** Maximum number of created auxpow blocks per algo that can be submitted */
+static const unsigned int MAX_AUXBLOCKS_SAVED = 1024;
+/** Created auxpow blocks older than this (in seconds) can no longer be submitted */
+static const int64_t MAX_AUXBLOCK_AGE = 60 * 60;
+/** Minimum time (in seconds) before work is rebuilt for mempool changes */
+static const int64_t AUXBLOCK_MEMPOOL_REFRESH = 60;
+
+/**
+ * Hands out merge-mining work for getauxblock and createauxblock and looks
+ * up the blocks that solutions are submitted for.
+ *
+ * Work is kept separately for every algo, each with its own lock, and for
+ * every coinbase script. When the tip changes, or the mempool has changed
+ * and the work is older than AUXBLOCK_MEMPOOL_REFRESH, the work that is
+ * being requested is rebuilt on a background thread. Requests are thus
+ * served from memory without cs_main, except for the first request of a
+ * coinbase script or one that comes in before the rebuild has finished.
+ */
+class CAuxpowMiner : public CValidationInterface
+{
+private:
+    /** Current work for one coinbase script */
+    struct CCurrentWork
+    {
+        std::shared_ptr<const CBlock> pblock;
+        const CBlockIndex* pindexPrev;
+        unsigned int nTransactionsUpdated;
+        int64_t nTime;
+        int64_t nLastRequest;
+    };
+
+    /** Created block that a solution can be submitted for */
+    struct CSavedBlock
+    {
+        std::shared_ptr<const CBlock> pblock;
+        int64_t nTime;
+    };
+
+    /** Work for one algo */
+    struct CAlgoWork
+    {
+        /** Held while building work, so that concurrent requests build it only once */
+        CCriticalSection csBuild;
+        /** Protects the members below */
+        CCriticalSection cs;
+        std::map<CScript, CCurrentWork> mapCurrent;
+        std::map<uint256, CSavedBlock> mapSaved;
+        /** Hashes of mapSaved, oldest first */
+        std::deque<uint256> dequeSaved;
+    };
+
+    CAlgoWork vAlgoWork[NUM_ALGOS];
+
+    /** The active tip, as last announced by UpdatedBlockTip */
+    std::atomic<const CBlockIndex*> pindexTip;
+
+    /** Extranonce of the last created block */
+    std::atomic<unsigned int> nExtraNonce;
+
+    /** Work to rebuild on the background thread */
+    boost::mutex mutexPending;
+    boost::condition_variable condPending;
+    std::set<std::pair<int, CScript> > setPending;
+
+    void QueueBuild(int algo, const CScript& scriptPubKey);
+    /** Create a new block and make it the current work of algo and scriptPubKey */
+    std::shared_ptr<const CBlock> Build(int algo, const CScript& scriptPubKey, int64_t nLastRequest);
+    void ThreadBuild();
+
+protected:
+    void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) override;
+
+public:
+    CAuxpowMiner();
+
+    /** Start the background thread that rebuilds work */
+    void Start(boost::thread_group& threadGroup);
+
+    /** The active chain tip as last notified; cs_main is only taken before the first notification */
+    const CBlockIndex* GetTip();
+
+    /**
+     * Return the block to merge-mine for algo that pays to scriptPubKey, and
+     * set pindexPrev to its parent. Throws a JSON-RPC error if no block can
+     * be created.
+     */
+    std::shared_ptr<const CBlock> GetCurrentBlock(int algo, const CScript& scriptPubKey, const CBlockIndex*& pindexPrev);
+
+    /** Look up a block returned by GetCurrentBlock, or return NULL if it is unknown or has been evicted */
+    std::shared_ptr<const CBlock> LookupSavedBlock(const uint256& hash);
+};
+
+extern std::unique_ptr<CAuxpowMiner> g_auxpow_miner;
+
+#endif // BITCOIN_RPC_AUXPOW_MINER_H
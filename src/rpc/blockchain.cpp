@@ -4,6 +4,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "amount.h"
+#include "base58.h"
 #include "chain.h"
 #include "chainparams.h"
 #include "checkpoints.h"
@@ -13,9 +14,11 @@
 #include "validation.h"
 #include "policy/policy.h"
 #include "primitives/transaction.h"
+#include "rpc/jsonwriter.h"
 #include "rpc/server.h"
 #include "streams.h"
 #include "sync.h"
+#include "txdb.h"
 #include "txmempool.h"
 #include "util.h"
 #include "utilstrencodings.h"
@@ -156,7 +159,17 @@ UniValue blockheaderToJSON(const CBlockIndex* blockindex)
     return result;
 }
 
-UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false)
+static UniValue blockTxToJSON(const CTransaction& tx, bool txDetails)
+{
+    if (!txDetails)
+        return tx.GetHash().GetHex();
+    UniValue objTx(UniValue::VOBJ);
+    TxToJSON(tx, uint256(), objTx);
+    return objTx;
+}
+
+/** Fields of blockToJSON, with txs as the transactions */
+static UniValue blockFieldsToJSON(const CBlock& block, const CBlockIndex* blockindex, const UniValue& txs)
 {
     UniValue result(UniValue::VOBJ);
     result.push_back(Pair("hash", blockindex->GetBlockHash().GetHex()));
@@ -172,25 +185,17 @@ UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool tx
     result.push_back(Pair("version", block.nVersion));
     result.push_back(Pair("versionHex", strprintf("%08x", block.nVersion)));
     result.push_back(Pair("merkleroot", block.hashMerkleRoot.GetHex()));
-    UniValue txs(UniValue::VARR);
-    for(const auto& tx : block.vtx)
-    {
-        if(txDetails)
-        {
-            UniValue objTx(UniValue::VOBJ);
-            TxToJSON(*tx, uint256(), objTx);
-            txs.push_back(objTx);
-        }
-        else
-            txs.push_back(tx->GetHash().GetHex());
-    }
     result.push_back(Pair("tx", txs));
     result.push_back(Pair("time", block.GetBlockTime()));
     result.push_back(Pair("mediantime", (int64_t)blockindex->GetMedianTimePast()));
     result.push_back(Pair("nonce", (uint64_t)block.nNonce));
     result.push_back(Pair("bits", strprintf("%08x", block.nBits)));
     int algo = GetAlgo(block.nVersion);
-    if (block.auxpow)
+    if (!blockindex->hashPoW.IsNull())
+    {
+        result.push_back(Pair("pow_hash", blockindex->hashPoW.GetHex()));
+    }
+    else if (block.auxpow)
     {
         result.push_back(Pair("pow_hash", block.auxpow->getParentBlockPoWHash(algo, Params().GetConsensus()).GetHex()));
     }
@@ -214,6 +219,35 @@ UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool tx
     return result;
 }
 
+UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false)
+{
+    UniValue txs(UniValue::VARR);
+    for (const auto& tx : block.vtx)
+        txs.push_back(blockTxToJSON(*tx, txDetails));
+    return blockFieldsToJSON(block, blockindex, txs);
+}
+
+/** Write the blockToJSON result to writer, converting one transaction at a time */
+void blockToJSON(JSONStreamWriter& writer, const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false)
+{
+    UniValue result = blockFieldsToJSON(block, blockindex, UniValue(UniValue::VARR));
+    const std::vector<std::string>& keys = result.getKeys();
+    const std::vector<UniValue>& values = result.getValues();
+    writer.BeginObject();
+    for (size_t i = 0; i < keys.size(); i++) {
+        if (keys[i] != "tx") {
+            writer.Pair(keys[i], values[i]);
+            continue;
+        }
+        writer.Key(keys[i]);
+        writer.BeginArray();
+        for (const auto& tx : block.vtx)
+            writer.Value(blockTxToJSON(*tx, txDetails));
+        writer.EndArray();
+    }
+    writer.EndObject();
+}
+
 UniValue getblockcount(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() != 0)
@@ -479,6 +513,26 @@ UniValue mempoolToJSON(bool fVerbose = false)
     }
 }
 
+/** Write the mempoolToJSON result to writer, converting one entry at a time */
+void mempoolToJSON(JSONStreamWriter& writer, bool fVerbose = false)
+{
+    if (!fVerbose) {
+        writer.Value(mempoolToJSON(false));
+        return;
+    }
+
+    LOCK(mempool.cs);
+    writer.BeginObject();
+    BOOST_FOREACH(const CTxMemPoolEntry& e, mempool.mapTx)
+    {
+        const uint256& hash = e.GetTx().GetHash();
+        UniValue info(UniValue::VOBJ);
+        entryToJSON(info, e);
+        writer.Pair(hash.ToString(), info);
+    }
+    writer.EndObject();
+}
+
 UniValue getrawmempool(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() > 1)
@@ -507,6 +561,10 @@ UniValue getrawmempool(const JSONRPCRequest& request)
     if (request.params.size() > 0)
         fVerbose = request.params[0].get_bool();
 
+    if (fVerbose && request.resultWriter) {
+        mempoolToJSON(*request.resultWriter, fVerbose);
+        return NullUniValue;
+    }
     return mempoolToJSON(fVerbose);
 }
 
@@ -842,6 +900,10 @@ UniValue getblock(const JSONRPCRequest& request)
         return strHex;
     }
 
+    if (request.resultWriter) {
+        blockToJSON(*request.resultWriter, block, pblockindex);
+        return NullUniValue;
+    }
     return blockToJSON(block, pblockindex);
 }
 
@@ -858,6 +920,21 @@ struct CCoinsStats
     CCoinsStats() : nHeight(0), nTransactions(0), nTransactionOutputs(0), nSerializedSize(0), nTotalAmount(0) {}
 };
 
+//! Hash and count the unspent outputs of one transaction, in the same layout the per-transaction UTXO set used
+static void ApplyStats(CCoinsStats &stats, CHashWriter& ss, const uint256& hash, const std::map<uint32_t, Coin>& outputs)
+{
+    assert(!outputs.empty());
+    ss << hash;
+    stats.nTransactions++;
+    for (const auto& output : outputs) {
+        ss << VARINT(output.first + 1);
+        ss << output.second.out;
+        stats.nTransactionOutputs++;
+        stats.nTotalAmount += output.second.out.nValue;
+    }
+    ss << VARINT(0);
+}
+
 //! Calculate statistics about the unspent transaction output set
 static bool GetUTXOStats(CCoinsView *view, CCoinsStats &stats)
 {
@@ -870,32 +947,29 @@ static bool GetUTXOStats(CCoinsView *view, CCoinsStats &stats)
         stats.nHeight = mapBlockIndex.find(stats.hashBlock)->second->nHeight;
     }
     ss << stats.hashBlock;
-    CAmount nTotalAmount = 0;
+    uint256 prevkey;
+    std::map<uint32_t, Coin> outputs;
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
-        uint256 key;
-        CCoins coins;
-        if (pcursor->GetKey(key) && pcursor->GetValue(coins)) {
-            stats.nTransactions++;
-            ss << key;
-            for (unsigned int i=0; i<coins.vout.size(); i++) {
-                const CTxOut &out = coins.vout[i];
-                if (!out.IsNull()) {
-                    stats.nTransactionOutputs++;
-                    ss << VARINT(i+1);
-                    ss << out;
-                    nTotalAmount += out.nValue;
-                }
+        COutPoint key;
+        Coin coin;
+        if (pcursor->GetKey(key) && pcursor->GetValue(coin)) {
+            if (!outputs.empty() && key.hash != prevkey) {
+                ApplyStats(stats, ss, prevkey, outputs);
+                outputs.clear();
             }
+            prevkey = key.hash;
+            outputs[key.n] = std::move(coin);
             stats.nSerializedSize += 32 + pcursor->GetValueSize();
-            ss << VARINT(0);
         } else {
             return error("%s: unable to read value", __func__);
         }
         pcursor->Next();
     }
+    if (!outputs.empty()) {
+        ApplyStats(stats, ss, prevkey, outputs);
+    }
     stats.hashSerialized = ss.GetHash();
-    stats.nTotalAmount = nTotalAmount;
     return true;
 }
 
@@ -1013,7 +1087,6 @@ UniValue gettxout(const JSONRPCRequest& request)
             "        ,...\n"
             "     ]\n"
             "  },\n"
-            "  \"version\" : n,            (numeric) The version\n"
             "  \"coinbase\" : true|false   (boolean) Coinbase or not\n"
             "}\n"
 
@@ -1037,33 +1110,30 @@ UniValue gettxout(const JSONRPCRequest& request)
     if (request.params.size() > 2)
         fMempool = request.params[2].get_bool();
 
-    CCoins coins;
+    COutPoint out(hash, n);
+    Coin coin;
     if (fMempool) {
         LOCK(mempool.cs);
         CCoinsViewMemPool view(pcoinsTip, mempool);
-        if (!view.GetCoins(hash, coins))
+        if (!view.GetCoin(out, coin) || mempool.isSpent(out)) // TODO: filtering spent coins should be done by the CCoinsViewMemPool
             return NullUniValue;
-        mempool.pruneSpent(hash, coins); // TODO: this should be done by the CCoinsViewMemPool
     } else {
-        if (!pcoinsTip->GetCoins(hash, coins))
+        if (!pcoinsTip->GetCoin(out, coin))
             return NullUniValue;
     }
-    if (n<0 || (unsigned int)n>=coins.vout.size() || coins.vout[n].IsNull())
-        return NullUniValue;
 
     BlockMap::iterator it = mapBlockIndex.find(pcoinsTip->GetBestBlock());
     CBlockIndex *pindex = it->second;
     ret.push_back(Pair("bestblock", pindex->GetBlockHash().GetHex()));
-    if ((unsigned int)coins.nHeight == MEMPOOL_HEIGHT)
+    if (coin.nHeight == MEMPOOL_HEIGHT)
         ret.push_back(Pair("confirmations", 0));
     else
-        ret.push_back(Pair("confirmations", pindex->nHeight - coins.nHeight + 1));
-    ret.push_back(Pair("value", ValueFromAmount(coins.vout[n].nValue)));
+        ret.push_back(Pair("confirmations", (int64_t)(pindex->nHeight - coin.nHeight + 1)));
+    ret.push_back(Pair("value", ValueFromAmount(coin.out.nValue)));
     UniValue o(UniValue::VOBJ);
-    ScriptPubKeyToJSON(coins.vout[n].scriptPubKey, o, true);
+    ScriptPubKeyToJSON(coin.out.scriptPubKey, o, true);
     ret.push_back(Pair("scriptPubKey", o));
-    ret.push_back(Pair("version", coins.nVersion));
-    ret.push_back(Pair("coinbase", coins.fCoinBase));
+    ret.push_back(Pair("coinbase", (bool)coin.fCoinBase));
 
     return ret;
 }
@@ -1525,6 +1595,85 @@ UniValue reconsiderblock(const JSONRPCRequest& request)
     return NullUniValue;
 }
 
+UniValue addressIndexToJSON(const std::vector<std::pair<CAddressIndexKey, CAddressIndexValue> >& vEntries)
+{
+    UniValue result(UniValue::VARR);
+    for (const auto& entry : vEntries) {
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("txid", entry.first.txid.GetHex()));
+        obj.push_back(Pair("vout", (int64_t)entry.first.n));
+        obj.push_back(Pair("height", entry.first.nHeight));
+        obj.push_back(Pair("value", ValueFromAmount(entry.second.nValue)));
+        obj.push_back(Pair("spent", entry.second.IsSpent()));
+        if (entry.second.IsSpent()) {
+            obj.push_back(Pair("spenttxid", entry.second.spentTxid.GetHex()));
+            obj.push_back(Pair("spentheight", entry.second.nSpentHeight));
+        }
+        result.push_back(obj);
+    }
+    return result;
+}
+
+UniValue getaddressoutputs(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 4)
+        throw runtime_error(
+            "getaddressoutputs \"address\" ( unspentonly skip count )\n"
+            "\nReturns the outputs paying to an address in the active chain, ordered by height.\n"
+            "Requires -addressindex.\n"
+            "\nArguments:\n"
+            "1. \"address\"      (string, required) The unitus address\n"
+            "2. unspentonly      (boolean, optional, default=false) Only return unspent outputs\n"
+            "3. skip             (numeric, optional, default=0) Number of outputs to skip, for paging\n"
+            + strprintf("4. count            (numeric, optional, default=%u) Maximum number of outputs to return, at most %u\n", DEFAULT_ADDRESSINDEX_PAGE_SIZE, MAX_ADDRESSINDEX_PAGE_SIZE) +
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    \"txid\" : \"hash\",        (string) The transaction id\n"
+            "    \"vout\" : n,             (numeric) The output index\n"
+            "    \"height\" : n,           (numeric) The height of the block containing the transaction\n"
+            "    \"value\" : x.xxx,        (numeric) The value in " + CURRENCY_UNIT + "\n"
+            "    \"spent\" : true|false,   (boolean) Whether the output is spent in the active chain\n"
+            "    \"spenttxid\" : \"hash\",   (string, if spent) The spending transaction id\n"
+            "    \"spentheight\" : n       (numeric, if spent) The height of the block containing the spending transaction\n"
+            "  }\n"
+            "  ,...\n"
+            "]\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getaddressoutputs", "\"UPSSGeFHDnKNxiEyFrD1wcEaHr9hrQDDWc\" true")
+            + HelpExampleRpc("getaddressoutputs", "\"UPSSGeFHDnKNxiEyFrD1wcEaHr9hrQDDWc\", true, 0, 100")
+        );
+
+    if (!fAddressIndex)
+        throw JSONRPCError(RPC_MISC_ERROR, "Address index not enabled, restart with -addressindex and -reindex-chainstate");
+
+    CBitcoinAddress address(request.params[0].get_str());
+    if (!address.IsValid())
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid Unitus address");
+
+    bool fUnspentOnly = false;
+    if (request.params.size() > 1)
+        fUnspentOnly = request.params[1].get_bool();
+    int nSkip = 0;
+    if (request.params.size() > 2)
+        nSkip = request.params[2].get_int();
+    int nCount = DEFAULT_ADDRESSINDEX_PAGE_SIZE;
+    if (request.params.size() > 3)
+        nCount = request.params[3].get_int();
+    if (nSkip < 0)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Negative skip");
+    if (nCount < 0 || nCount > (int)MAX_ADDRESSINDEX_PAGE_SIZE)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Count out of range");
+
+    // No cs_main: the read sees one snapshot of the index, in which every
+    // block is either fully applied or not at all, so a large skip does not
+    // stall validation
+    std::vector<std::pair<CAddressIndexKey, CAddressIndexValue> > vEntries;
+    if (!pblocktree->ReadAddressIndex(GetAddressIndexHash(GetScriptForDestination(address.Get())), fUnspentOnly, nSkip, nCount, vEntries))
+        throw JSONRPCError(RPC_DATABASE_ERROR, "Unable to read address index");
+    return addressIndexToJSON(vEntries);
+}
+
 static const CRPCCommand commands[] =
 { //  category              name                      actor (function)         okSafe argNames
   //  --------------------- ------------------------  -----------------------  ------ ----------
@@ -1534,6 +1683,7 @@ static const CRPCCommand commands[] =
     { "blockchain",         "getblock",               &getblock,               true,  {"blockhash","verbose","auxpow"} },
     { "blockchain",         "getblockhash",           &getblockhash,           true,  {"height"} },
     { "blockchain",         "getblockheader",         &getblockheader,         true,  {"blockhash","verbose"} },
+    { "blockchain",         "getaddressoutputs",      &getaddressoutputs,      true,  {"address","unspentonly","skip","count"} },
     { "blockchain",         "getchaintips",           &getchaintips,           true,  {} },
     { "blockchain",         "getdifficulty",          &getdifficulty,          true,  {} },
     { "blockchain",         "getmempoolancestors",    &getmempoolancestors,    true,  {"txid","verbose"} },
@@ -36,6 +36,7 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "generate", 1, "maxtries" },
     { "generatetoaddress", 0, "nblocks" },
     { "generatetoaddress", 2, "maxtries" },
+    { "createauxblock", 1, "algo" },
     { "getnetworkhashps", 0, "nblocks" },
     { "getnetworkhashps", 1, "height" },
     { "sendtoaddress", 1, "amount" },
@@ -82,6 +83,9 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "getblock", 1, "verbose" },
     { "getblock", 2, "auxpow" },
     { "getblockheader", 1, "verbose" },
+    { "getaddressoutputs", 1, "unspentonly" },
+    { "getaddressoutputs", 2, "skip" },
+    { "getaddressoutputs", 3, "count" },
     { "gettransaction", 1, "include_watchonly" },
     { "getrawtransaction", 1, "verbose" },
     { "createrawtransaction", 0, "inputs" },
@@ -0,0 +1,94 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "rpc/jsonwriter.h"
+
+#include <assert.h>
+
+JSONStreamWriter::JSONStreamWriter(const Sink& _sink, size_t _nChunkSize) :
+    sink(_sink), nChunkSize(_nChunkSize), fAfterKey(false), fFlushed(false), nTopLevelValues(0)
+{
+    buf.reserve(nChunkSize);
+}
+
+void JSONStreamWriter::Separate()
+{
+    if (fAfterKey) {
+        fAfterKey = false;
+        return;
+    }
+    if (vHasElements.empty())
+        return;
+    if (vHasElements.back())
+        buf += ',';
+    vHasElements.back() = true;
+}
+
+void JSONStreamWriter::EndValue()
+{
+    if (vHasElements.empty())
+        nTopLevelValues++;
+    if (buf.size() >= nChunkSize)
+        Flush();
+}
+
+void JSONStreamWriter::BeginObject()
+{
+    Separate();
+    buf += '{';
+    vHasElements.push_back(false);
+}
+
+void JSONStreamWriter::EndObject()
+{
+    assert(!vHasElements.empty() && !fAfterKey);
+    vHasElements.pop_back();
+    buf += '}';
+    EndValue();
+}
+
+void JSONStreamWriter::BeginArray()
+{
+    Separate();
+    buf += '[';
+    vHasElements.push_back(false);
+}
+
+void JSONStreamWriter::EndArray()
+{
+    assert(!vHasElements.empty() && !fAfterKey);
+    vHasElements.pop_back();
+    buf += ']';
+    EndValue();
+}
+
+void JSONStreamWriter::Key(const std::string& key)
+{
+    assert(!vHasElements.empty() && !fAfterKey);
+    Separate();
+    buf += UniValue(key).write();
+    buf += ':';
+    fAfterKey = true;
+}
+
+void JSONStreamWriter::Value(const UniValue& value)
+{
+    Separate();
+    buf += value.write();
+    EndValue();
+}
+
+void JSONStreamWriter::Raw(const std::string& text)
+{
+    buf += text;
+}
+
+void JSONStreamWriter::Flush()
+{
+    if (buf.empty())
+        return;
+    sink(buf);
+    fFlushed = true;
+    buf.clear();
+}
@@ -0,0 +1,66 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_RPCJSONWRITER_H
+#define BITCOIN_RPCJSONWRITER_H
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <univalue.h>
+
+/** Amount of JSON text buffered before it is passed on */
+static const size_t DEFAULT_JSON_CHUNK_SIZE = 64 * 1024;
+
+/**
+ * Writes compact JSON, identical to UniValue::write(), piece by piece.
+ * Large results can be produced one element at a time instead of building
+ * a complete UniValue tree and string first. Text is handed to the sink in
+ * chunks of about nChunkSize bytes, and at Flush().
+ */
+class JSONStreamWriter
+{
+public:
+    typedef std::function<void(const std::string&)> Sink;
+
+    explicit JSONStreamWriter(const Sink& sink, size_t nChunkSize = DEFAULT_JSON_CHUNK_SIZE);
+
+    void BeginObject();
+    void EndObject();
+    void BeginArray();
+    void EndArray();
+    /** Write the key of the next object member */
+    void Key(const std::string& key);
+    /** Write a complete value */
+    void Value(const UniValue& value);
+    void Pair(const std::string& key, const UniValue& value) { Key(key); Value(value); }
+    /** Write text as is, outside of the JSON structure */
+    void Raw(const std::string& text);
+
+    /** Pass all buffered text to the sink */
+    void Flush();
+
+    /** Number of complete values written at the top level */
+    unsigned int TopLevelValues() const { return nTopLevelValues; }
+    /** Whether any text has been passed to the sink */
+    bool Flushed() const { return fFlushed; }
+
+private:
+    Sink sink;
+    size_t nChunkSize;
+    std::string buf;
+    //! Whether the open arrays and objects already have an element
+    std::vector<bool> vHasElements;
+    bool fAfterKey;
+    bool fFlushed;
+    unsigned int nTopLevelValues;
+
+    /** Write the separator needed before the next element */
+    void Separate();
+    /** Account for a completed value and flush if the buffer is full */
+    void EndValue();
+};
+
+#endif // BITCOIN_RPCJSONWRITER_H
@@ -5,6 +5,7 @@
 
 #include "base58.h"
 #include "clientversion.h"
+#include "httpserver.h"
 #include "init.h"
 #include "validation.h"
 #include "net.h"
@@ -510,6 +511,55 @@ UniValue getmemoryinfo(const JSONRPCRequest& request)
     return obj;
 }
 
+UniValue getrpcinfo(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 0)
+        throw runtime_error(
+            "getrpcinfo\n"
+            "Returns the state of the RPC work queues. Incoming requests are queued under \"http\" until\n"
+            "they are read, after which each call is queued under its method.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"name\": {                 (json object) Work queue of a method, or \"http\" for incoming requests\n"
+            "    \"priority\": \"xxx\",     (string) Scheduling priority: high, normal or low\n"
+            "    \"threadlimit\": n,       (numeric) Maximum number of calls running at once, 0 for no limit\n"
+            "    \"maxdepth\": n,          (numeric) Maximum number of calls waiting to run\n"
+            "    \"depth\": n,             (numeric) Number of calls waiting to run\n"
+            "    \"active\": n,            (numeric) Number of calls running\n"
+            "    \"processed\": n,         (numeric) Number of calls run\n"
+            "    \"rejected\": n,          (numeric) Number of calls rejected because the queue was full\n"
+            "    \"avgwait\": x.xxx,       (numeric) Average time calls waited in the queue, in milliseconds\n"
+            "    \"maxwait\": x.xxx,       (numeric) Longest time a call waited in the queue, in milliseconds\n"
+            "    \"avgrun\": x.xxx,        (numeric) Average run time of calls, in milliseconds\n"
+            "    \"maxrun\": x.xxx,        (numeric) Longest run time of a call, in milliseconds\n"
+            "  },\n"
+            "  ...\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getrpcinfo", "")
+            + HelpExampleRpc("getrpcinfo", "")
+        );
+
+    UniValue obj(UniValue::VOBJ);
+    for (const auto& entry : GetHTTPWorkStats()) {
+        const HTTPWorkStats& stats = entry.second;
+        UniValue queue(UniValue::VOBJ);
+        queue.push_back(Pair("priority", stats.priority == HTTP_PRIORITY_HIGH ? "high" : stats.priority == HTTP_PRIORITY_LOW ? "low" : "normal"));
+        queue.push_back(Pair("threadlimit", stats.maxActive));
+        queue.push_back(Pair("maxdepth", (uint64_t)stats.maxDepth));
+        queue.push_back(Pair("depth", (uint64_t)stats.depth));
+        queue.push_back(Pair("active", stats.active));
+        queue.push_back(Pair("processed", stats.nProcessed));
+        queue.push_back(Pair("rejected", stats.nRejected));
+        queue.push_back(Pair("avgwait", stats.nProcessed ? 0.001 * stats.nWaitTotal / stats.nProcessed : 0.0));
+        queue.push_back(Pair("maxwait", 0.001 * stats.nWaitMax));
+        queue.push_back(Pair("avgrun", stats.nProcessed ? 0.001 * stats.nRunTotal / stats.nProcessed : 0.0));
+        queue.push_back(Pair("maxrun", 0.001 * stats.nRunMax));
+        obj.push_back(Pair(entry.first, queue));
+    }
+    return obj;
+}
+
 UniValue echo(const JSONRPCRequest& request)
 {
     if (request.fHelp)
@@ -528,6 +578,7 @@ static const CRPCCommand commands[] =
   //  --------------------- ------------------------  -----------------------  ----------
     { "control",            "getinfo",                &getinfo,                true,  {} }, /* uses wallet if enabled */
     { "control",            "getmemoryinfo",          &getmemoryinfo,          true,  {} },
+    { "control",            "getrpcinfo",             &getrpcinfo,             true,  {} },
     { "util",               "validateaddress",        &validateaddress,        true,  {"address"} }, /* uses wallet if enabled */
     { "util",               "createmultisig",         &createmultisig,         true,  {"nrequired","keys"} },
     { "util",               "verifymessage",          &verifymessage,          true,  {"address","signature","message"} },
@@ -33,6 +33,7 @@ namespace RPCServer
 
 class CBlockIndex;
 class CNetAddr;
+class JSONStreamWriter;
 
 /** Wrapper for UniValue::VType, which includes typeAny:
  * Used to denote don't care type. Only used by RPCTypeCheckObj */
@@ -52,8 +53,11 @@ public:
     bool fHelp;
     std::string URI;
     std::string authUser;
+    /** Where a handler may write a large result directly instead of returning
+     * it, if set. Handlers that do so return NullUniValue. */
+    JSONStreamWriter* resultWriter;
 
-    JSONRPCRequest() { id = NullUniValue; params = NullUniValue; fHelp = false; }
+    JSONRPCRequest() { id = NullUniValue; params = NullUniValue; fHelp = false; resultWriter = nullptr; }
     void parse(const UniValue& valRequest);
 };
 
@@ -203,7 +207,7 @@ extern void EnsureWalletIsUnlocked();
 bool StartRPC();
 void InterruptRPC();
 void StopRPC();
-std::string JSONRPCExecBatch(const UniValue& vReq);
+UniValue JSONRPCExecOne(const UniValue& req);
 void RPCNotifyBlockChange(bool ibd, const CBlockIndex *);
 
 // Retrieves any serialization flags requested in command line argument
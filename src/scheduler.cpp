@@ -131,3 +131,81 @@ size_t CScheduler::getQueueInfo(boost::chrono::system_clock::time_point &first,
     }
     return result;
 }
+
+bool CScheduler::AreThreadsServicingQueue() const
+{
+    boost::unique_lock<boost::mutex> lock(newTaskMutex);
+    return nThreadsServicingQueue;
+}
+
+
+void SingleThreadedSchedulerClient::MaybeScheduleProcessQueue()
+{
+    {
+        LOCK(cs_callbacksPending);
+        // Try to avoid scheduling too many copies here, but if we
+        // accidentally have two ProcessQueue's scheduled at once its
+        // not a big deal.
+        if (fCallbacksRunning || callbacksPending.empty())
+            return;
+    }
+    pscheduler->schedule(boost::bind(&SingleThreadedSchedulerClient::ProcessQueue, this), boost::chrono::system_clock::now());
+}
+
+void SingleThreadedSchedulerClient::ProcessQueue()
+{
+    std::function<void (void)> callback;
+    {
+        LOCK(cs_callbacksPending);
+        if (fCallbacksRunning || callbacksPending.empty())
+            return;
+        fCallbacksRunning = true;
+        callback = std::move(callbacksPending.front());
+        callbacksPending.pop_front();
+    }
+
+    // Clear fCallbacksRunning and schedule the next callback even if
+    // this one throws.
+    struct RAIICallbacksRunning {
+        SingleThreadedSchedulerClient* instance;
+        explicit RAIICallbacksRunning(SingleThreadedSchedulerClient* _instance) : instance(_instance) {}
+        ~RAIICallbacksRunning()
+        {
+            {
+                LOCK(instance->cs_callbacksPending);
+                instance->fCallbacksRunning = false;
+            }
+            instance->MaybeScheduleProcessQueue();
+        }
+    } raiicallbacksrunning(this);
+
+    callback();
+}
+
+void SingleThreadedSchedulerClient::AddToProcessQueue(std::function<void (void)> func)
+{
+    assert(pscheduler);
+
+    {
+        LOCK(cs_callbacksPending);
+        callbacksPending.emplace_back(std::move(func));
+    }
+    MaybeScheduleProcessQueue();
+}
+
+void SingleThreadedSchedulerClient::EmptyQueue()
+{
+    assert(!pscheduler->AreThreadsServicingQueue());
+    bool fContinue = true;
+    while (fContinue) {
+        ProcessQueue();
+        LOCK(cs_callbacksPending);
+        fContinue = !callbacksPending.empty();
+    }
+}
+
+size_t SingleThreadedSchedulerClient::CallbacksPending()
+{
+    LOCK(cs_callbacksPending);
+    return callbacksPending.size();
+}
@@ -13,8 +13,12 @@
 #include <boost/function.hpp>
 #include <boost/chrono/chrono.hpp>
 #include <boost/thread.hpp>
+#include <functional>
+#include <list>
 #include <map>
 
+#include "sync.h"
+
 //
 // Simple class for background tasks that should be run
 // periodically or once "after a while"
@@ -70,6 +74,9 @@ public:
     size_t getQueueInfo(boost::chrono::system_clock::time_point &first,
                         boost::chrono::system_clock::time_point &last) const;
 
+    // Returns true if there are threads actively running in serviceQueue()
+    bool AreThreadsServicingQueue() const;
+
 private:
     std::multimap<boost::chrono::system_clock::time_point, Function> taskQueue;
     boost::condition_variable newTaskScheduled;
@@ -80,4 +87,34 @@ private:
     bool shouldStop() { return stopRequested || (stopWhenEmpty && taskQueue.empty()); }
 };
 
+/**
+ * Runs callbacks on a CScheduler one at a time, in the order they were
+ * added, even when the scheduler has several threads. Callbacks of
+ * different clients may still run in parallel.
+ */
+class SingleThreadedSchedulerClient
+{
+private:
+    CScheduler* pscheduler;
+
+    CCriticalSection cs_callbacksPending;
+    std::list<std::function<void (void)> > callbacksPending;
+    bool fCallbacksRunning;
+
+    void MaybeScheduleProcessQueue();
+    void ProcessQueue();
+
+public:
+    explicit SingleThreadedSchedulerClient(CScheduler* pschedulerIn) : pscheduler(pschedulerIn), fCallbacksRunning(false) {}
+
+    // Add a callback to be run after all callbacks added before it
+    void AddToProcessQueue(std::function<void (void)> func);
+
+    // Run all pending callbacks on the calling thread. Only to be used when
+    // no thread is servicing the scheduler any more, e.g. at shutdown.
+    void EmptyQueue();
+
+    size_t CallbacksPending();
+};
+
 #endif
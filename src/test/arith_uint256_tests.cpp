@@ -13,6 +13,8 @@
 #include <string>
 #include "version.h"
 #include "test/test_bitcoin.h"
+#include "test/test_random.h"
+#include "bignum.h"
 
 BOOST_FIXTURE_TEST_SUITE(arith_uint256_tests, BasicTestingSetup)
 
@@ -564,4 +566,63 @@ BOOST_AUTO_TEST_CASE( getmaxcoverage ) // some more tests just to get 100% cover
     CHECKBITWISEOPERATOR(R1,~R2,&)
 }
 
+/// Reference for GetProductNthRoot: the CBigNum computation formerly used by
+/// GetGeometricMeanPrevWork.
+static arith_uint256 CBigNumProductNthRoot(const arith_uint256* pvalues, unsigned int nValues, int n)
+{
+    CBigNum bnProduct = 1;
+    for (unsigned int i = 0; i < nValues; i++)
+        bnProduct *= CBigNum(ArithToUint256(pvalues[i]));
+    return UintToArith256(bnProduct.nthRoot(n).getuint256());
+}
+
+/// Random value shaped like per-algo block work, plus edge cases.
+static arith_uint256 RandomWork()
+{
+    switch (insecure_rand() % 8) {
+    case 0: return ZeroL;
+    case 1: return MaxL;
+    case 2: return OneL << (insecure_rand() % 256);
+    case 3: {
+        // Perfect fifth power, off by one in either direction
+        arith_uint256 r = (arith_uint256(insecure_rand()) << 19) | (insecure_rand() & 0x7ffff);
+        arith_uint256 p = r * r * r * r * r;
+        switch (insecure_rand() % 3) {
+        case 0: return p - 1;
+        case 1: return p;
+        default: return p + 1;
+        }
+    }
+    case 4: return arith_uint256(insecure_rand() % 1000);
+    default: {
+        arith_uint256 r;
+        for (int i = 0; i < 8; i++)
+            r = (r << 32) | insecure_rand();
+        return r >> (insecure_rand() % 256);
+    }
+    }
+}
+
+BOOST_AUTO_TEST_CASE( product_nthroot )
+{
+    const arith_uint256 vEdge[] = {ZeroL, OneL, OneL + 1, HalfL, HalfL - 1, MaxL, R1L, R2L, arith_uint256(31), arith_uint256(32), arith_uint256(33)};
+    for (const arith_uint256& a : vEdge) {
+        for (int n = 2; n <= 5; n++) {
+            BOOST_CHECK_EQUAL(GetProductNthRoot(&a, 1, n).GetHex(), CBigNumProductNthRoot(&a, 1, n).GetHex());
+            arith_uint256 v[MAX_PRODUCT_NTHROOT_VALUES] = {a, a, a, a, a};
+            BOOST_CHECK_EQUAL(GetProductNthRoot(v, MAX_PRODUCT_NTHROOT_VALUES, n).GetHex(), CBigNumProductNthRoot(v, MAX_PRODUCT_NTHROOT_VALUES, n).GetHex());
+        }
+    }
+    BOOST_CHECK(GetProductNthRoot(NULL, 0, 5) == OneL);
+
+    for (int i = 0; i < 10000; i++) {
+        arith_uint256 v[MAX_PRODUCT_NTHROOT_VALUES];
+        unsigned int nValues = 1 + insecure_rand() % MAX_PRODUCT_NTHROOT_VALUES;
+        for (unsigned int j = 0; j < nValues; j++)
+            v[j] = RandomWork();
+        int n = 2 + insecure_rand() % 6;
+        BOOST_CHECK_EQUAL(GetProductNthRoot(v, nValues, n).GetHex(), CBigNumProductNthRoot(v, nValues, n).GetHex());
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -43,6 +43,38 @@ BOOST_AUTO_TEST_CASE(dbwrapper)
     }
 }
 
+BOOST_AUTO_TEST_CASE(dbwrapper_profiles)
+{
+    DBProfile profile;
+    BOOST_CHECK(!ParseDBProfile("", profile));
+    BOOST_CHECK(!ParseDBProfile("nvme", profile));
+
+    const char* names[] = {"default", "fast", "compact"};
+    for (const char* name : names) {
+        BOOST_CHECK(ParseDBProfile(name, profile));
+        BOOST_CHECK_EQUAL(GetDBProfileName(profile), name);
+
+        // On disk, so that tables are written with the profile's block size and compression
+        boost::filesystem::path ph = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+        {
+            CDBWrapper dbw(ph, (1 << 20), false, false, true, profile);
+            std::vector<unsigned char> value(1000, 'x');
+            CDBBatch batch(dbw);
+            for (int i = 0; i < 1000; i++)
+                batch.Write(i, value);
+            BOOST_CHECK(dbw.WriteBatch(batch, true));
+            dbw.CompactRange(0, 1000);
+
+            std::vector<unsigned char> res;
+            for (int i = 0; i < 1000; i++) {
+                BOOST_CHECK(dbw.Read(i, res));
+                BOOST_CHECK(res == value);
+            }
+        }
+        boost::filesystem::remove_all(ph);
+    }
+}
+
 // Test batch operations
 BOOST_AUTO_TEST_CASE(dbwrapper_batch)
 {
@@ -3,6 +3,10 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "hash.h"
+#include "crypto/hashX11.h"
+#include "crypto/hashlanes.h"
+#include "crypto/hashqubit.h"
+#include "random.h"
 #include "utilstrencodings.h"
 #include "test/test_bitcoin.h"
 
@@ -105,6 +109,13 @@ BOOST_AUTO_TEST_CASE(siphash)
 
     BOOST_CHECK_EQUAL(SipHashUint256(0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL, uint256S("1f1e1d1c1b1a191817161514131211100f0e0d0c0b0a09080706050403020100")), 0x7127512f72f27cceull);
 
+    // The outpoint hash must equal the generic hasher over the 36 serialized bytes
+    uint256 outpointHash = uint256S("1f1e1d1c1b1a191817161514131211100f0e0d0c0b0a09080706050403020100");
+    const unsigned char outpointIndex[4] = {0x24, 0x23, 0x22, 0x21};
+    CSipHasher hasherOutpoint(0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL);
+    hasherOutpoint.Write(outpointHash.begin(), 32).Write(outpointIndex, 4);
+    BOOST_CHECK_EQUAL(SipHashUint256Extra(0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL, outpointHash, 0x21222324), hasherOutpoint.Finalize());
+
     // Check test vectors from spec, one byte at a time
     CSipHasher hasher2(0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL);
     for (uint8_t x=0; x<ARRAYLEN(siphash_4_2_testvec); ++x)
@@ -130,4 +141,103 @@ BOOST_AUTO_TEST_CASE(siphash)
     BOOST_CHECK_EQUAL(SipHashUint256(1, 2, ss.GetHash()), 0x79751e980c2a0a35ULL);
 }
 
+BOOST_AUTO_TEST_CASE(bmw256)
+{
+    // BMW-256 closes each message with its 64-bit bit count, which
+    // Lyra2RE2 depends on. The inputs are the bytes 00 01 02 ..., in lengths
+    // around the 56 bytes after which the count needs a block of its own.
+    std::vector<unsigned char> vData(80);
+    for (size_t i = 0; i < vData.size(); i++)
+        vData[i] = i;
+
+#define T(expected, len) \
+    do { \
+        uint256 hash; \
+        sph_bmw256_context ctx_bmw; \
+        sph_bmw256_init(&ctx_bmw); \
+        sph_bmw256(&ctx_bmw, vData.data(), len); \
+        sph_bmw256_close(&ctx_bmw, static_cast<void*>(&hash)); \
+        BOOST_CHECK_EQUAL(HexStr(hash.begin(), hash.end()), expected); \
+    } while (0)
+
+    T("82cac4bf6f4c2b41fbcc0e0984e9d8b76d7662f8e1789cdfbd85682acc55577a", 0);
+    T("58efe426847d2834913b2a0074f2ade6fabe99a02b644f656375be05fa762a5e", 1);
+    T("05d15a40411b68a1d64e190f58a089178a014c25fd40f37f12fd84be3de07dc2", 32);
+    T("8c1d1014c3a3daf448c7180473a6c1ee6b190c0f9ae0140cf54de79ed4bd9472", 55);
+    T("693d3adc06137fdc8d48b7bda099fd85302d82053e01f9b48a6367f2fc14fcb5", 56);
+    T("007a7b7f61cefbe883ffa9ebeb950e37ba2130e282b19fbf045c7779a2fcd4c1", 64);
+    T("57044d8df78b85ff8609e27383a8e4c1b29ca9389e20c2f688a8479bcc8b7a4a", 80);
+#undef T
+}
+
+/** Check the lane kernels of the selected implementation against the sph code */
+static void CheckHashLanes()
+{
+    // The lane kernels and the batch functions must match the one by one
+    // hashes for any count, including partial groups, and for input lengths
+    // around the block sizes of the kernels (32 bytes for CubeHash and Luffa,
+    // 64 for JH).
+    const size_t vLen[] = {0, 1, 31, 32, 33, 63, 64, 65, 80, 127, 128, 200};
+    for (size_t nLen : vLen) {
+        for (size_t nCount = 0; nCount <= 2 * HASH_LANES + 3; nCount++) {
+            std::vector<std::vector<unsigned char> > vData(nCount);
+            std::vector<const unsigned char*> vpData(nCount);
+            for (size_t i = 0; i < nCount; i++) {
+                vData[i].resize(nLen);
+                vData[i].reserve(1);
+                GetRandBytes(vData[i].data(), nLen);
+                vpData[i] = vData[i].data();
+            }
+
+            std::vector<uint512> vCubeHash(nCount), vJH(nCount), vLuffa(nCount);
+            CubeHash512Lanes(vpData.data(), nLen, vCubeHash.data(), nCount);
+            JH512Lanes(vpData.data(), nLen, vJH.data(), nCount);
+            Luffa512Lanes(vpData.data(), nLen, vLuffa.data(), nCount);
+            std::vector<uint256> vX11(nCount), vQubit(nCount);
+            HashX11Batch(vpData.data(), nLen, vX11.data(), nCount);
+            HashQubitBatch(vpData.data(), nLen, vQubit.data(), nCount);
+
+            for (size_t i = 0; i < nCount; i++) {
+                uint512 hash;
+                sph_cubehash512_context ctx_cubehash;
+                sph_cubehash512_init(&ctx_cubehash);
+                sph_cubehash512(&ctx_cubehash, vpData[i], nLen);
+                sph_cubehash512_close(&ctx_cubehash, static_cast<void*>(&hash));
+                BOOST_CHECK(vCubeHash[i] == hash);
+
+                sph_jh512_context ctx_jh;
+                sph_jh512_init(&ctx_jh);
+                sph_jh512(&ctx_jh, vpData[i], nLen);
+                sph_jh512_close(&ctx_jh, static_cast<void*>(&hash));
+                BOOST_CHECK(vJH[i] == hash);
+
+                sph_luffa512_context ctx_luffa;
+                sph_luffa512_init(&ctx_luffa);
+                sph_luffa512(&ctx_luffa, vpData[i], nLen);
+                sph_luffa512_close(&ctx_luffa, static_cast<void*>(&hash));
+                BOOST_CHECK(vLuffa[i] == hash);
+
+                BOOST_CHECK(vX11[i] == HashX11(vData[i].begin(), vData[i].end()));
+                BOOST_CHECK(vQubit[i] == HashQubit(vData[i].begin(), vData[i].end()));
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(hash_lanes)
+{
+    // Each implementation this build and CPU support, not only the one
+    // picked for the CPU
+    const HashLanesImpl vImpl[] = {HASH_LANES_SCALAR, HASH_LANES_GENERIC, HASH_LANES_AVX2};
+    for (HashLanesImpl impl : vImpl) {
+        if (!SetHashLanesImplementation(impl)) {
+            BOOST_TEST_MESSAGE("Hash lanes implementation " << impl << " not available");
+            continue;
+        }
+        BOOST_TEST_MESSAGE("Checking hash lanes implementation " << HashLanesImplementation());
+        CheckHashLanes();
+    }
+    BOOST_CHECK(SetHashLanesImplementation(HASH_LANES_AUTO));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,98 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "rpc/jsonwriter.h"
+#include "test/test_bitcoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(jsonwriter_tests, BasicTestingSetup)
+
+/** Write value through writer the way a streaming caller would, one element at a time */
+static void WriteStreamed(JSONStreamWriter& writer, const UniValue& value)
+{
+    if (value.isObject()) {
+        writer.BeginObject();
+        for (size_t i = 0; i < value.size(); i++) {
+            writer.Key(value.getKeys()[i]);
+            WriteStreamed(writer, value.getValues()[i]);
+        }
+        writer.EndObject();
+    } else if (value.isArray()) {
+        writer.BeginArray();
+        for (size_t i = 0; i < value.size(); i++)
+            WriteStreamed(writer, value[i]);
+        writer.EndArray();
+    } else {
+        writer.Value(value);
+    }
+}
+
+static UniValue TestValue()
+{
+    UniValue inner(UniValue::VOBJ);
+    inner.push_back(Pair("quote\"key", "line\nbreak"));
+    inner.push_back(Pair("empty", UniValue(UniValue::VARR)));
+    inner.push_back(Pair("null", NullUniValue));
+
+    UniValue arr(UniValue::VARR);
+    for (int i = 0; i < 50; i++)
+        arr.push_back(i);
+    arr.push_back(inner);
+    arr.push_back(UniValue(UniValue::VOBJ));
+
+    UniValue obj(UniValue::VOBJ);
+    obj.push_back(Pair("hash", "00ff"));
+    obj.push_back(Pair("size", 1234));
+    obj.push_back(Pair("tx", arr));
+    obj.push_back(Pair("flag", true));
+    obj.push_back(Pair("nested", inner));
+    return obj;
+}
+
+BOOST_AUTO_TEST_CASE(jsonwriter_matches_univalue)
+{
+    UniValue value = TestValue();
+    std::string out;
+    JSONStreamWriter writer([&out](const std::string& chunk) { out += chunk; });
+    WriteStreamed(writer, value);
+    BOOST_CHECK_EQUAL(writer.TopLevelValues(), 1U);
+    BOOST_CHECK(!writer.Flushed());
+    writer.Flush();
+    BOOST_CHECK(writer.Flushed());
+    BOOST_CHECK_EQUAL(out, value.write());
+
+    // Whole values written at once give the same text
+    std::string outWhole;
+    JSONStreamWriter writerWhole([&outWhole](const std::string& chunk) { outWhole += chunk; });
+    writerWhole.BeginObject();
+    for (size_t i = 0; i < value.size(); i++)
+        writerWhole.Pair(value.getKeys()[i], value.getValues()[i]);
+    writerWhole.EndObject();
+    writerWhole.Flush();
+    BOOST_CHECK_EQUAL(outWhole, value.write());
+}
+
+BOOST_AUTO_TEST_CASE(jsonwriter_chunks)
+{
+    UniValue value = TestValue();
+    std::vector<std::string> chunks;
+    JSONStreamWriter writer([&chunks](const std::string& chunk) { chunks.push_back(chunk); }, 16);
+    writer.Raw("{\"result\":");
+    WriteStreamed(writer, value);
+    writer.Raw("}");
+    writer.Flush();
+
+    BOOST_CHECK(chunks.size() > 1);
+    std::string out;
+    for (const std::string& chunk : chunks) {
+        BOOST_CHECK(!chunk.empty());
+        out += chunk;
+    }
+    BOOST_CHECK_EQUAL(out, "{\"result\":" + value.write() + "}");
+    // Raw text does not count as a value
+    BOOST_CHECK_EQUAL(writer.TopLevelValues(), 1U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
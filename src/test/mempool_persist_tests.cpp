@@ -0,0 +1,308 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "consensus/validation.h"
+#include "key.h"
+#include "policy/policy.h"
+#include "script/standard.h"
+#include "streams.h"
+#include "txmempool.h"
+#include "util.h"
+#include "utiltime.h"
+#include "validation.h"
+
+#include "test/test_bitcoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+namespace {
+
+/** Outputs of each transaction splitting a coinbase, within the descendant limit */
+const unsigned int SPLIT_OUTPUTS = 20;
+/** Value of an output of a split, and of the transaction spending it, which
+ *  both pay the minimum fee of 0.01 per started kB and stay above dust */
+const CAmount SPLIT_VALUE = 4.5 * CENT;
+const CAmount SPEND_VALUE = 3.5 * CENT;
+
+/** Outputs pay to a script anyone can spend by revealing it */
+const CScript REDEEM_SCRIPT = CScript() << OP_TRUE;
+
+bool ToMemPool(const CMutableTransaction& tx)
+{
+    LOCK(cs_main);
+    CValidationState state;
+    return AcceptToMemoryPool(mempool, state, MakeTransactionRef(tx), false, NULL, NULL, true, 0);
+}
+
+/** A transaction spending output n of prev to nOutputs outputs of nValue */
+CMutableTransaction Spend(const CTransaction& prev, unsigned int n, unsigned int nOutputs, CAmount nValue)
+{
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout = COutPoint(prev.GetHash(), n);
+    tx.vout.resize(nOutputs, CTxOut(nValue, GetScriptForDestination(CScriptID(REDEEM_SCRIPT))));
+    return tx;
+}
+
+boost::filesystem::path MempoolPath()
+{
+    return GetDataDir() / "mempool.dat";
+}
+
+std::vector<unsigned char> ReadMempoolFile()
+{
+    std::vector<unsigned char> vch(boost::filesystem::file_size(MempoolPath()));
+    FILE* file = fopen(MempoolPath().string().c_str(), "rb");
+    BOOST_REQUIRE(file);
+    BOOST_REQUIRE_EQUAL(fread(vch.data(), 1, vch.size(), file), vch.size());
+    fclose(file);
+    return vch;
+}
+
+void WriteMempoolFile(const std::vector<unsigned char>& vch)
+{
+    FILE* file = fopen(MempoolPath().string().c_str(), "wb");
+    BOOST_REQUIRE(file);
+    BOOST_REQUIRE_EQUAL(fwrite(vch.data(), 1, vch.size(), file), vch.size());
+    fclose(file);
+}
+
+/** Write mempool.dat as it was before the transactions were checksummed */
+void WriteMempoolFileV1(const std::vector<TxMempoolInfo>& vinfo)
+{
+    CAutoFile file(fopen(MempoolPath().string().c_str(), "wb"), SER_DISK, CLIENT_VERSION);
+    BOOST_REQUIRE(!file.IsNull());
+    file << (uint64_t)1;
+    file << (uint64_t)vinfo.size();
+    for (const TxMempoolInfo& info : vinfo) {
+        file << *info.tx;
+        file << (int64_t)info.nTime;
+        file << (int64_t)info.nFeeDelta;
+    }
+    file << std::map<uint256, CAmount>();
+}
+
+} // anon namespace
+
+struct MempoolPersistSetup : public TestChain100Setup {
+    std::vector<CMutableTransaction> vtx;
+
+    /** Split mature coinbases into outputs, then add nSpends transactions
+     *  spending them. vtx holds the splits first. */
+    void FillMempool(unsigned int nSpends)
+    {
+        // Mature enough coinbases: the first one already is
+        CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+        unsigned int nSplits = (nSpends + SPLIT_OUTPUTS - 1) / SPLIT_OUTPUTS;
+        for (unsigned int i = 1; i < nSplits; i++)
+            coinbaseTxns.push_back(*CreateAndProcessBlock(std::vector<CMutableTransaction>(), scriptPubKey).vtx[0]);
+
+        for (unsigned int i = 0; i < nSplits; i++) {
+            CMutableTransaction split = Spend(coinbaseTxns[i], 0, SPLIT_OUTPUTS, SPLIT_VALUE);
+            std::vector<unsigned char> vchSig;
+            uint256 hash = SignatureHash(scriptPubKey, split, 0, SIGHASH_ALL, 0, SIGVERSION_BASE);
+            BOOST_REQUIRE(coinbaseKey.Sign(hash, vchSig));
+            vchSig.push_back((unsigned char)SIGHASH_ALL);
+            split.vin[0].scriptSig << vchSig;
+            BOOST_REQUIRE(ToMemPool(split));
+            vtx.push_back(split);
+        }
+
+        for (unsigned int i = 0; i < nSpends; i++)
+            AddSpend(vtx[i / SPLIT_OUTPUTS], i % SPLIT_OUTPUTS);
+        BOOST_REQUIRE_EQUAL(mempool.size(), vtx.size());
+    }
+
+    void AddSpend(const CTransaction& prev, unsigned int n)
+    {
+        CMutableTransaction tx = Spend(prev, n, 1, SPEND_VALUE);
+        tx.vin[0].scriptSig << ToByteVector(REDEEM_SCRIPT);
+        BOOST_REQUIRE(ToMemPool(tx));
+        vtx.push_back(tx);
+    }
+
+    /** Empty the mempool, as on a restart, and load it from mempool.dat */
+    bool Reload()
+    {
+        {
+            LOCK(mempool.cs);
+            mempool.mapDeltas.clear();
+        }
+        mempool.clear();
+        return LoadMempool();
+    }
+
+    /** Whether the mempool holds exactly the transactions of vtx */
+    bool HasAll()
+    {
+        if (mempool.size() != vtx.size())
+            return false;
+        for (const CMutableTransaction& tx : vtx) {
+            if (!mempool.exists(tx.GetHash()))
+                return false;
+        }
+        return true;
+    }
+};
+
+BOOST_FIXTURE_TEST_SUITE(mempool_persist_tests, MempoolPersistSetup)
+
+BOOST_AUTO_TEST_CASE(mempool_persist_roundtrip)
+{
+    FillMempool(2);
+    SetMockTime(GetTime() - 60);
+    AddSpend(vtx[0], 2);
+    SetMockTime(0);
+
+    double prioritydummy = 0;
+    uint256 hashAbsent = GetRandHash();
+    mempool.PrioritiseTransaction(vtx[1].GetHash(), vtx[1].GetHash().ToString(), prioritydummy, 1000);
+    mempool.PrioritiseTransaction(hashAbsent, hashAbsent.ToString(), prioritydummy, -2000);
+    std::vector<TxMempoolInfo> vinfo = mempool.infoAll();
+
+    DumpMempool();
+    BOOST_REQUIRE(Reload());
+    BOOST_CHECK(HasAll());
+
+    // Entry times and fee deltas are kept, including deltas of transactions
+    // that are not in the mempool
+    for (const TxMempoolInfo& info : vinfo) {
+        TxMempoolInfo infoLoaded = mempool.info(info.tx->GetHash());
+        BOOST_CHECK_EQUAL(infoLoaded.nTime, info.nTime);
+        BOOST_CHECK_EQUAL(infoLoaded.nFeeDelta, info.nFeeDelta);
+    }
+    BOOST_CHECK_EQUAL(mempool.info(vtx[1].GetHash()).nFeeDelta, 1000);
+    LOCK(mempool.cs);
+    BOOST_CHECK_EQUAL(mempool.mapDeltas.count(hashAbsent), 1);
+    BOOST_CHECK_EQUAL(mempool.mapDeltas[hashAbsent].second, -2000);
+}
+
+BOOST_AUTO_TEST_CASE(mempool_persist_chunks)
+{
+    // The splits and most of the transactions spending them are written in
+    // the first chunk, the last transactions in the second one
+    FillMempool(1001);
+    DumpMempool();
+
+    std::vector<unsigned char> vch = ReadMempoolFile();
+    CDataStream s(vch, SER_DISK, CLIENT_VERSION);
+    uint64_t version, num;
+    s >> version >> num;
+    BOOST_REQUIRE_EQUAL(num, vtx.size());
+    CDataStream chunk(SER_DISK, CLIENT_VERSION);
+    chunk.resize(ReadCompactSize(s));
+    s.read(chunk.data(), chunk.size());
+    std::set<uint256> setFirstChunk;
+    while (!chunk.empty()) {
+        CTransactionRef tx;
+        int64_t nTime, nFeeDelta;
+        chunk >> tx >> nTime >> nFeeDelta;
+        setFirstChunk.insert(tx->GetHash());
+    }
+    BOOST_CHECK_EQUAL(setFirstChunk.size(), 1000);
+    for (const CMutableTransaction& tx : vtx) {
+        if (!setFirstChunk.count(tx.GetHash()))
+            BOOST_CHECK(setFirstChunk.count(tx.vin[0].prevout.hash));
+    }
+
+    BOOST_REQUIRE(Reload());
+    BOOST_CHECK(HasAll());
+}
+
+BOOST_AUTO_TEST_CASE(mempool_persist_v1)
+{
+    FillMempool(2);
+    double prioritydummy = 0;
+    mempool.PrioritiseTransaction(vtx[2].GetHash(), vtx[2].GetHash().ToString(), prioritydummy, 500);
+    std::vector<TxMempoolInfo> vinfo = mempool.infoAll();
+
+    WriteMempoolFileV1(vinfo);
+
+    BOOST_REQUIRE(Reload());
+    BOOST_CHECK(HasAll());
+    BOOST_CHECK_EQUAL(mempool.info(vtx[2].GetHash()).nFeeDelta, 500);
+
+    // The next dump uses the current version
+    DumpMempool();
+    std::vector<unsigned char> vch = ReadMempoolFile();
+    CDataStream s(vch, SER_DISK, CLIENT_VERSION);
+    uint64_t version;
+    s >> version;
+    BOOST_CHECK_EQUAL(version, 2);
+    BOOST_REQUIRE(Reload());
+    BOOST_CHECK(HasAll());
+}
+
+BOOST_AUTO_TEST_CASE(mempool_persist_invalid)
+{
+    FillMempool(2);
+    std::vector<TxMempoolInfo> vinfo = mempool.infoAll();
+
+    // A transaction revealing the wrong script fails its check ahead of the
+    // others of the batch, which are still checked and loaded
+    CMutableTransaction bad = Spend(vtx[0], 5, 1, SPEND_VALUE);
+    bad.vin[0].scriptSig << ToByteVector(CScript() << OP_2);
+    TxMempoolInfo infoBad;
+    infoBad.tx = MakeTransactionRef(bad);
+    infoBad.nTime = GetTime();
+    infoBad.nFeeDelta = 0;
+    vinfo.insert(vinfo.begin() + 1, infoBad);
+    WriteMempoolFileV1(vinfo);
+
+    BOOST_REQUIRE(Reload());
+    BOOST_CHECK(HasAll());
+    BOOST_CHECK(!mempool.exists(bad.GetHash()));
+
+    // The check of the bad transaction passes once told to ignore its
+    // failure, but still records it
+    PrecomputedTransactionData txdata(*infoBad.tx);
+    CScriptCheck check(vtx[0].vout[5], *infoBad.tx, 0, STANDARD_SCRIPT_VERIFY_FLAGS, false, &txdata);
+    CScriptCheck checkIgnored(vtx[0].vout[5], *infoBad.tx, 0, STANDARD_SCRIPT_VERIFY_FLAGS, false, &txdata);
+    checkIgnored.IgnoreFailure();
+    BOOST_CHECK(!check());
+    BOOST_CHECK(checkIgnored());
+    BOOST_CHECK_EQUAL(checkIgnored.GetScriptError(), check.GetScriptError());
+    BOOST_CHECK(checkIgnored.GetScriptError() != SCRIPT_ERR_OK);
+}
+
+BOOST_AUTO_TEST_CASE(mempool_persist_corrupted)
+{
+    FillMempool(2);
+    double prioritydummy = 0;
+    mempool.PrioritiseTransaction(vtx[2].GetHash(), vtx[2].GetHash().ToString(), prioritydummy, 500);
+    DumpMempool();
+    const std::vector<unsigned char> vchGood = ReadMempoolFile();
+
+    // Find the first chunk: the version and the number of transactions, then
+    // the size of the chunk, its data and its hash
+    CDataStream s(vchGood, SER_DISK, CLIENT_VERSION);
+    uint64_t version, num;
+    s >> version >> num;
+    uint64_t nChunkSize = ReadCompactSize(s);
+    size_t nChunkEnd = vchGood.size() - s.size() + nChunkSize;
+    BOOST_REQUIRE_EQUAL(num, vtx.size());
+    BOOST_REQUIRE(nChunkEnd + 32 <= vchGood.size());
+
+    // The last byte of the chunk is the top byte of the fee delta of the
+    // last transaction: the chunk still parses, but must not be used
+    std::vector<unsigned char> vch = vchGood;
+    vch[nChunkEnd - 1] ^= 0x40;
+    WriteMempoolFile(vch);
+    BOOST_CHECK(!Reload());
+    BOOST_CHECK_EQUAL(mempool.size(), 0);
+
+    // A damaged hash rejects the chunk as well
+    vch = vchGood;
+    vch[nChunkEnd] ^= 0x01;
+    WriteMempoolFile(vch);
+    BOOST_CHECK(!Reload());
+    BOOST_CHECK_EQUAL(mempool.size(), 0);
+
+    WriteMempoolFile(vchGood);
+    BOOST_REQUIRE(Reload());
+    BOOST_CHECK(HasAll());
+    BOOST_CHECK_EQUAL(mempool.info(vtx[2].GetHash()).nFeeDelta, 500);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -114,4 +114,39 @@ BOOST_AUTO_TEST_CASE(manythreads)
     BOOST_CHECK_EQUAL(counterSum, 200);
 }
 
+BOOST_AUTO_TEST_CASE(singlethreadedclient_ordered)
+{
+    CScheduler scheduler;
+
+    // Each client runs its callbacks in order, one at a time, even though
+    // the scheduler has more threads than clients
+    SingleThreadedSchedulerClient client1(&scheduler);
+    SingleThreadedSchedulerClient client2(&scheduler);
+
+    boost::thread_group threads;
+    for (int i = 0; i < 5; i++)
+        threads.create_thread(boost::bind(&CScheduler::serviceQueue, &scheduler));
+
+    // Not atomic: only one callback of a client runs at a time
+    int counter1 = 0;
+    int counter2 = 0;
+    for (int i = 0; i < 100; i++) {
+        client1.AddToProcessQueue([i, &counter1]() { BOOST_CHECK_EQUAL(i, counter1++); });
+        client2.AddToProcessQueue([i, &counter2]() { BOOST_CHECK_EQUAL(i, counter2++); });
+    }
+
+    scheduler.stop(true);
+    threads.join_all();
+    BOOST_CHECK(!scheduler.AreThreadsServicingQueue());
+
+    // Callbacks added once the scheduler stopped run on EmptyQueue
+    client1.AddToProcessQueue([&counter1]() { counter1++; });
+    BOOST_CHECK_EQUAL(client1.CallbacksPending(), 1);
+    client1.EmptyQueue();
+    BOOST_CHECK_EQUAL(client1.CallbacksPending(), 0);
+
+    BOOST_CHECK_EQUAL(counter1, 101);
+    BOOST_CHECK_EQUAL(counter2, 100);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -44,6 +44,36 @@ BOOST_AUTO_TEST_CASE(skiplist_test)
     }
 }
 
+BOOST_AUTO_TEST_CASE(prevalgo_test)
+{
+    std::vector<CBlockIndex> vIndex(10000);
+
+    for (unsigned int i=0; i<vIndex.size(); i++) {
+        vIndex[i].nHeight = i;
+        vIndex[i].pprev = (i == 0) ? NULL : &vIndex[i - 1];
+        // Leave one algo unused for a long stretch of the chain.
+        int algo = insecure_rand() % (i < 5000 ? NUM_ALGOS - 1 : NUM_ALGOS);
+        CBlockHeader header;
+        header.nVersion = BLOCK_VERSION_DEFAULT;
+        header.SetAlgo(algo);
+        vIndex[i].nVersion = header.nVersion;
+        vIndex[i].BuildSkip();
+    }
+
+    for (unsigned int i=0; i < vIndex.size(); i++) {
+        for (int algo = 0; algo < NUM_ALGOS; algo++) {
+            // Compare against a linear walk over pprev.
+            const CBlockIndex* pindexWalk = &vIndex[i];
+            while (pindexWalk && pindexWalk->GetAlgo() != algo)
+                pindexWalk = pindexWalk->pprev;
+            BOOST_CHECK(GetLastBlockIndexForAlgo(&vIndex[i], algo) == pindexWalk);
+            if (i > 0) {
+                BOOST_CHECK(vIndex[i].pprevAlgo[algo] == GetLastBlockIndexForAlgo(&vIndex[i - 1], algo));
+            }
+        }
+    }
+}
+
 BOOST_AUTO_TEST_CASE(getlocator_test)
 {
     // Build a main chain 100000 blocks long.
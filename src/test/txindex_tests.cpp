@@ -0,0 +1,187 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "chainparams.h"
+#include "consensus/consensus.h"
+#include "index/txindex.h"
+#include "script/standard.h"
+#include "utiltime.h"
+#include "validation.h"
+
+#include "test/test_bitcoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+namespace {
+
+/** The index syncs on a background thread */
+bool WaitForSync(const TxIndex& txindex)
+{
+    int64_t nTimeout = GetTimeMillis() + 10000;
+    while (!txindex.IsSynced()) {
+        if (GetTimeMillis() > nTimeout)
+            return false;
+        MilliSleep(100);
+    }
+    return true;
+}
+
+/** Whether the index finds the coinbase of the block at pindex, at its place on disk */
+bool HasCoinbase(const CBlockIndex* pindex)
+{
+    CBlock block;
+    if (!ReadBlockFromDisk(block, pindex, Params().GetConsensus()))
+        return false;
+
+    CDiskTxPos pos;
+    if (!pblocktree->ReadTxIndex(block.vtx[0]->GetHash(), pos))
+        return false;
+
+    CTransactionRef tx;
+    uint256 hashBlock;
+    return GetTransaction(block.vtx[0]->GetHash(), tx, Params().GetConsensus(), hashBlock, false) &&
+        tx->GetHash() == block.vtx[0]->GetHash() && hashBlock == pindex->GetBlockHash();
+}
+
+/** Number of blocks from nHeight to the tip whose coinbase the index finds */
+int CountIndexed(int nHeight)
+{
+    LOCK(cs_main);
+    int nCount = 0;
+    for (int i = nHeight; i <= chainActive.Height(); i++)
+        nCount += HasCoinbase(chainActive[i]);
+    return nCount;
+}
+
+const CBlockIndex* GetTip()
+{
+    LOCK(cs_main);
+    return chainActive.Tip();
+}
+
+void InvalidateTip(int nBlocks)
+{
+    CValidationState state;
+    {
+        LOCK(cs_main);
+        InvalidateBlock(state, Params(), chainActive[chainActive.Height() - nBlocks + 1]);
+    }
+    ActivateBestChain(state, Params());
+}
+
+} // anon namespace
+
+struct TxIndexSetup : public TestChain100Setup {
+    CScript scriptPubKey;
+
+    TxIndexSetup()
+    {
+        // GetTransaction only uses the index with -txindex
+        fTxIndex = true;
+        scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    }
+
+    ~TxIndexSetup()
+    {
+        fTxIndex = false;
+    }
+
+    void MineBlocks(int nBlocks, const CScript& scriptPayTo)
+    {
+        for (int i = 0; i < nBlocks; i++)
+            CreateAndProcessBlock(std::vector<CMutableTransaction>(), scriptPayTo);
+    }
+
+    void MineBlocks(int nBlocks)
+    {
+        MineBlocks(nBlocks, scriptPubKey);
+    }
+};
+
+BOOST_FIXTURE_TEST_SUITE(txindex_tests, TxIndexSetup)
+
+BOOST_AUTO_TEST_CASE(txindex_initial_sync)
+{
+    TxIndex txindex;
+    BOOST_CHECK(!txindex.IsSynced());
+    BOOST_CHECK(txindex.GetBestBlock() == NULL);
+    BOOST_CHECK_EQUAL(CountIndexed(0), 0);
+
+    // The sync thread reads the blocks of the chain from disk
+    BOOST_REQUIRE(txindex.Start());
+    BOOST_REQUIRE(WaitForSync(txindex));
+    BOOST_CHECK(txindex.GetBestBlock() == GetTip());
+    BOOST_CHECK_EQUAL(CountIndexed(0), COINBASE_MATURITY + 1);
+
+    // Then the index follows the blocks being connected
+    MineBlocks(10);
+    BOOST_CHECK(txindex.GetBestBlock() == GetTip());
+    BOOST_CHECK_EQUAL(CountIndexed(0), COINBASE_MATURITY + 11);
+
+    txindex.Stop();
+}
+
+BOOST_AUTO_TEST_CASE(txindex_catch_up)
+{
+    {
+        TxIndex txindex;
+        BOOST_REQUIRE(txindex.Start());
+        BOOST_REQUIRE(WaitForSync(txindex));
+        txindex.Stop();
+    }
+
+    // Blocks connected while the index is stopped are indexed once it
+    // starts again, from the block it recorded on disk
+    MineBlocks(10);
+    BOOST_CHECK_EQUAL(CountIndexed(COINBASE_MATURITY + 1), 0);
+
+    TxIndex txindex;
+    BOOST_REQUIRE(txindex.Start());
+    BOOST_REQUIRE(WaitForSync(txindex));
+    BOOST_CHECK(txindex.GetBestBlock() == GetTip());
+    BOOST_CHECK_EQUAL(CountIndexed(0), COINBASE_MATURITY + 11);
+
+    txindex.Stop();
+}
+
+BOOST_AUTO_TEST_CASE(txindex_reorg)
+{
+    {
+        TxIndex txindex;
+        BOOST_REQUIRE(txindex.Start());
+        BOOST_REQUIRE(WaitForSync(txindex));
+
+        // Disconnected blocks move the best block of the index back
+        const CBlockIndex* pindexOld = GetTip();
+        InvalidateTip(3);
+        BOOST_CHECK_EQUAL(GetTip()->nHeight, pindexOld->nHeight - 3);
+        BOOST_CHECK(txindex.GetBestBlock() == GetTip());
+
+        // and the blocks of the new branch are indexed as they are connected.
+        // They pay elsewhere, or they would be the blocks just invalidated.
+        MineBlocks(4, CScript() << OP_TRUE);
+        BOOST_CHECK_EQUAL(GetTip()->nHeight, pindexOld->nHeight + 1);
+        BOOST_CHECK(txindex.GetBestBlock() == GetTip());
+        BOOST_CHECK_EQUAL(CountIndexed(0), COINBASE_MATURITY + 2);
+
+        txindex.Stop();
+    }
+
+    // A reorg while the index is stopped: it resumes from the fork point
+    const CBlockIndex* pindexOld = GetTip();
+    InvalidateTip(2);
+    MineBlocks(3, CScript() << OP_2);
+    BOOST_CHECK_EQUAL(GetTip()->nHeight, pindexOld->nHeight + 1);
+    BOOST_CHECK_EQUAL(CountIndexed(pindexOld->nHeight - 1), 0);
+
+    TxIndex txindex;
+    BOOST_REQUIRE(txindex.Start());
+    BOOST_REQUIRE(WaitForSync(txindex));
+    BOOST_CHECK(txindex.GetBestBlock() == GetTip());
+    BOOST_CHECK_EQUAL(CountIndexed(0), COINBASE_MATURITY + 3);
+
+    txindex.Stop();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,84 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "scheduler.h"
+#include "sync.h"
+#include "validation.h"
+#include "validationinterface.h"
+
+#include "test/test_bitcoin.h"
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <boost/test/unit_test.hpp>
+
+namespace {
+
+/** Counts tip updates, taking cs_main on delivery like the wallet and ZMQ do */
+class CTipCounter : public CValidationInterface
+{
+public:
+    int nTips; // guarded by cs_main
+
+    CTipCounter() : nTips(0) {}
+
+protected:
+    void UpdatedBlockTip(const CBlockIndex* pindexNew, const CBlockIndex* pindexFork, bool fInitialDownload) override
+    {
+        LOCK(cs_main);
+        nTips++;
+    }
+};
+
+void NotifyTips(int nCount)
+{
+    // Validation sends its notifications with cs_main held
+    LOCK(cs_main);
+    for (int i = 0; i < nCount; i++)
+        GetMainSignals().UpdatedBlockTip(NULL, NULL, false);
+}
+
+int GetTips(CTipCounter& counter)
+{
+    LOCK(cs_main);
+    return counter.nTips;
+}
+
+} // anon namespace
+
+BOOST_FIXTURE_TEST_SUITE(validationinterface_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(shutdown_with_queued_callbacks)
+{
+    CScheduler scheduler;
+    RegisterBackgroundSignalScheduler(scheduler);
+    CTipCounter counter;
+    RegisterValidationInterface(&counter, true);
+
+    // While running, the scheduler thread delivers the notifications and so
+    // takes the queue's lock before cs_main
+    boost::thread schedulerThread(boost::bind(&CScheduler::serviceQueue, &scheduler));
+    NotifyTips(10);
+    SyncWithValidationInterfaceQueue();
+    BOOST_CHECK_EQUAL(GetTips(counter), 10);
+
+    // Notifications sent once the scheduler has stopped stay queued
+    scheduler.stop(false);
+    schedulerThread.join();
+    NotifyTips(10);
+    BOOST_CHECK_EQUAL(GetTips(counter), 10);
+
+    // Shutdown() delivers them on its own thread, without holding cs_main,
+    // which would invert the lock order above (and assert with
+    // DEBUG_LOCKORDER)
+    FlushBackgroundCallbacks();
+    BOOST_CHECK_EQUAL(GetTips(counter), 20);
+
+    UnregisterValidationInterface(&counter);
+    UnregisterBackgroundSignalScheduler();
+    NotifyTips(1);
+    BOOST_CHECK_EQUAL(GetTips(counter), 20);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -67,19 +67,88 @@ struct CDiskTxPos : public CDiskBlockPos
     }
 };
 
+/** Key of an -addressindex entry: an output, listed under the hash of its
+ * scriptPubKey. Height and output index are stored big-endian so that the
+ * entries of a script sort by height, then txid and output index.
+ */
+struct CAddressIndexKey
+{
+    uint160 hashScript;
+    int nHeight;
+    uint256 txid;
+    uint32_t n;
+
+    CAddressIndexKey() : nHeight(0), n(0) {}
+    CAddressIndexKey(const uint160& hashScriptIn, int nHeightIn, const uint256& txidIn, uint32_t nIn) :
+        hashScript(hashScriptIn), nHeight(nHeightIn), txid(txidIn), n(nIn) {}
+
+    template<typename Stream>
+    void Serialize(Stream& s) const {
+        s << hashScript;
+        ser_writedata32be(s, nHeight);
+        s << txid;
+        ser_writedata32be(s, n);
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s) {
+        s >> hashScript;
+        nHeight = ser_readdata32be(s);
+        s >> txid;
+        n = ser_readdata32be(s);
+    }
+};
+
+/** Value of an -addressindex entry: the amount of the output and, once it is
+ * spent in the active chain, the spending transaction */
+struct CAddressIndexValue
+{
+    CAmount nValue;
+    uint256 spentTxid;
+    int nSpentHeight;
+
+    CAddressIndexValue() : nValue(0), nSpentHeight(0) {}
+    CAddressIndexValue(CAmount nValueIn, const uint256& spentTxidIn = uint256(), int nSpentHeightIn = 0) :
+        nValue(nValueIn), spentTxid(spentTxidIn), nSpentHeight(nSpentHeightIn) {}
+
+    bool IsSpent() const { return !spentTxid.IsNull(); }
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(nValue);
+        READWRITE(spentTxid);
+        READWRITE(nSpentHeight);
+    }
+};
+
+/** Changes to the address index made by connecting or disconnecting a block */
+struct CAddressIndexUpdate
+{
+    std::vector<std::pair<CAddressIndexKey, CAddressIndexValue> > vWrite;
+    std::vector<CAddressIndexKey> vErase;
+};
+
+/** Hash under which the outputs paying to scriptPubKey are indexed */
+uint160 GetAddressIndexHash(const CScript& scriptPubKey);
+
 /** CCoinsView backed by the coin database (chainstate/) */
 class CCoinsViewDB : public CCoinsView
 {
 protected:
     CDBWrapper db;
 public:
-    CCoinsViewDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+    CCoinsViewDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false, DBProfile profile = DBPROFILE_DEFAULT);
+
+    bool GetCoin(const COutPoint &outpoint, Coin &coin) const override;
+    bool HaveCoin(const COutPoint &outpoint) const override;
+    uint256 GetBestBlock() const override;
+    bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) override;
+    CCoinsViewCursor *Cursor() const override;
 
-    bool GetCoins(const uint256 &txid, CCoins &coins) const;
-    bool HaveCoins(const uint256 &txid) const;
-    uint256 GetBestBlock() const;
-    bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock);
-    CCoinsViewCursor *Cursor() const;
+    //! Attempt to update from an older database format. Returns whether an error occurred.
+    bool Upgrade();
 };
 
 /** Specialization of CCoinsViewCursor to iterate over a CCoinsViewDB */
@@ -88,8 +157,8 @@ class CCoinsViewDBCursor: public CCoinsViewCursor
 public:
     ~CCoinsViewDBCursor() {}
 
-    bool GetKey(uint256 &key) const;
-    bool GetValue(CCoins &coins) const;
+    bool GetKey(COutPoint &key) const;
+    bool GetValue(Coin &coin) const;
     unsigned int GetValueSize() const;
 
     bool Valid() const;
@@ -99,7 +168,7 @@ private:
     CCoinsViewDBCursor(CDBIterator* pcursorIn, const uint256 &hashBlockIn):
         CCoinsViewCursor(hashBlockIn), pcursor(pcursorIn) {}
     std::unique_ptr<CDBIterator> pcursor;
-    std::pair<char, uint256> keyTmp;
+    std::pair<char, COutPoint> keyTmp;
 
     friend class CCoinsViewDB;
 };
@@ -108,7 +177,7 @@ private:
 class CBlockTreeDB : public CDBWrapper
 {
 public:
-    CBlockTreeDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+    CBlockTreeDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false, DBProfile profile = DBPROFILE_DEFAULT);
 private:
     CBlockTreeDB(const CBlockTreeDB&);
     void operator=(const CBlockTreeDB&);
@@ -120,8 +189,18 @@ public:
     bool ReadReindexing(bool &fReindex);
     bool ReadTxIndex(const uint256 &txid, CDiskTxPos &pos);
     bool WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> > &list);
+    /** Apply a block's changes to the address index in one batch; entries are written before others are erased */
+    bool UpdateAddressIndex(const CAddressIndexUpdate &update);
+    /** Read up to nCount entries for hashScript, in key order, after skipping the first nSkip.
+     *  With fUnspentOnly, spent outputs are neither returned nor counted. The entries come from
+     *  a single snapshot of the database, so no lock is needed against blocks being connected. */
+    bool ReadAddressIndex(const uint160 &hashScript, bool fUnspentOnly, size_t nSkip, size_t nCount, std::vector<std::pair<CAddressIndexKey, CAddressIndexValue> > &vEntries);
     bool WriteFlag(const std::string &name, bool fValue);
     bool ReadFlag(const std::string &name, bool &fValue);
+    /** Locator of the last block processed by the background index called name */
+    bool ReadIndexBestBlock(const std::string &name, CBlockLocator &locator);
+    bool WriteIndexBestBlock(const std::string &name, const CBlockLocator &locator);
+    bool EraseIndexBestBlock(const std::string &name);
     bool LoadBlockIndexGuts(boost::function<CBlockIndex*(const uint256&)> insertBlockIndex);
 };
 
@@ -13,6 +13,7 @@
 #include "consensus/consensus.h"
 #include "consensus/merkle.h"
 #include "consensus/validation.h"
+#include "crypto/hashlanes.h"
 #include "hash.h"
 #include "init.h"
 #include "policy/fees.h"
@@ -38,7 +39,11 @@
 #include "warnings.h"
 
 #include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
 #include <sstream>
+#include <thread>
 
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/algorithm/string/join.hpp>
@@ -66,6 +71,7 @@ int nScriptCheckThreads = 0;
 std::atomic_bool fImporting(false);
 bool fReindex = false;
 bool fTxIndex = false;
+bool fAddressIndex = false;
 bool fHavePruned = false;
 bool fPruneMode = false;
 bool fIsBareMultisigStd = DEFAULT_PERMIT_BAREMULTISIG;
@@ -154,6 +160,9 @@ namespace {
 
     /** Dirty block file entries. */
     std::set<int> setDirtyFileInfo;
+
+    /** Block index entries that hold their auxpow in memory, oldest first. */
+    std::deque<CBlockIndex*> dequeAuxpowCached;
 } // anon namespace
 
 /* Use this class to start tracking transactions that are removed from the
@@ -183,7 +192,7 @@ public:
     ~MemPoolConflictRemovalTracker() {
         pool.NotifyEntryRemoved.disconnect(boost::bind(&MemPoolConflictRemovalTracker::NotifyEntryRemoved, this, _1, _2));
         for (const auto& tx : conflictedTxs) {
-            GetMainSignals().SyncTransaction(*tx, NULL, CMainSignals::SYNC_TRANSACTION_NOT_IN_BLOCK);
+            GetMainSignals().SyncTransaction(tx, NULL, CMainSignals::SYNC_TRANSACTION_NOT_IN_BLOCK);
         }
         conflictedTxs.clear();
     }
@@ -396,15 +405,15 @@ bool CheckSequenceLocks(const CTransaction &tx, int flags, LockPoints* lp, bool
         prevheights.resize(tx.vin.size());
         for (size_t txinIndex = 0; txinIndex < tx.vin.size(); txinIndex++) {
             const CTxIn& txin = tx.vin[txinIndex];
-            CCoins coins;
-            if (!viewMemPool.GetCoins(txin.prevout.hash, coins)) {
+            Coin coin;
+            if (!viewMemPool.GetCoin(txin.prevout, coin)) {
                 return error("%s: Missing input", __func__);
             }
-            if (coins.nHeight == MEMPOOL_HEIGHT) {
+            if (coin.nHeight == MEMPOOL_HEIGHT) {
                 // Assume all mempool transaction confirm in the next block
                 prevheights[txinIndex] = tip->nHeight + 1;
             } else {
-                prevheights[txinIndex] = coins.nHeight;
+                prevheights[txinIndex] = coin.nHeight;
             }
         }
         lockPair = CalculateSequenceLocks(tx, flags, &prevheights, index);
@@ -460,7 +469,9 @@ unsigned int GetP2SHSigOpCount(const CTransaction& tx, const CCoinsViewCache& in
     unsigned int nSigOps = 0;
     for (unsigned int i = 0; i < tx.vin.size(); i++)
     {
-        const CTxOut &prevout = inputs.GetOutputFor(tx.vin[i]);
+        const Coin& coin = inputs.AccessCoin(tx.vin[i].prevout);
+        assert(!coin.IsSpent());
+        const CTxOut &prevout = coin.out;
         if (prevout.scriptPubKey.IsPayToScriptHash())
             nSigOps += prevout.scriptPubKey.GetSigOpCount(tx.vin[i].scriptSig);
     }
@@ -480,7 +491,9 @@ int64_t GetTransactionSigOpCost(const CTransaction& tx, const CCoinsViewCache& i
 
     for (unsigned int i = 0; i < tx.vin.size(); i++)
     {
-        const CTxOut &prevout = inputs.GetOutputFor(tx.vin[i]);
+        const Coin& coin = inputs.AccessCoin(tx.vin[i].prevout);
+        assert(!coin.IsSpent());
+        const CTxOut &prevout = coin.out;
         nSigOps += CountWitnessSigOps(tx.vin[i].scriptSig, prevout.scriptPubKey, &tx.vin[i].scriptWitness, flags);
     }
     return nSigOps;
@@ -544,9 +557,9 @@ void LimitMempoolSize(CTxMemPool& pool, size_t limit, unsigned long age) {
     if (expired != 0)
         LogPrint("mempool", "Expired %i transactions from the memory pool\n", expired);
 
-    std::vector<uint256> vNoSpendsRemaining;
+    std::vector<COutPoint> vNoSpendsRemaining;
     pool.TrimToSize(limit, &vNoSpendsRemaining);
-    BOOST_FOREACH(const uint256& removed, vNoSpendsRemaining)
+    BOOST_FOREACH(const COutPoint& removed, vNoSpendsRemaining)
         pcoinsTip->Uncache(removed);
 }
 
@@ -573,7 +586,7 @@ static bool IsCurrentForFeeEstimation()
 
 bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState& state, const CTransactionRef& ptx, bool fLimitFree,
                               bool* pfMissingInputs, int64_t nAcceptTime, std::list<CTransactionRef>* plTxnReplaced,
-                              bool fOverrideMempoolLimit, const CAmount& nAbsurdFee, std::vector<uint256>& vHashTxnToUncache)
+                              bool fOverrideMempoolLimit, const CAmount& nAbsurdFee, std::vector<COutPoint>& coins_to_uncache)
 {
     const CTransaction& tx = *ptx;
     const uint256 hash = tx.GetHash();
@@ -666,22 +679,26 @@ bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState& state, const C
         view.SetBackend(viewMemPool);
 
         // do we already have it?
-        bool fHadTxInCache = pcoinsTip->HaveCoinsInCache(hash);
-        if (view.HaveCoins(hash)) {
-            if (!fHadTxInCache)
-                vHashTxnToUncache.push_back(hash);
-            return state.Invalid(false, REJECT_ALREADY_KNOWN, "txn-already-known");
+        for (size_t out = 0; out < tx.vout.size(); out++) {
+            COutPoint outpoint(hash, out);
+            bool had_coin_in_cache = pcoinsTip->HaveCoinInCache(outpoint);
+            if (view.HaveCoin(outpoint)) {
+                if (!had_coin_in_cache) {
+                    coins_to_uncache.push_back(outpoint);
+                }
+                return state.Invalid(false, REJECT_ALREADY_KNOWN, "txn-already-known");
+            }
         }
 
         // do all inputs exist?
-        // Note that this does not check for the presence of actual outputs (see the next check for that),
-        // and only helps with filling in pfMissingInputs (to determine missing vs spent).
         BOOST_FOREACH(const CTxIn txin, tx.vin) {
-            if (!pcoinsTip->HaveCoinsInCache(txin.prevout.hash))
-                vHashTxnToUncache.push_back(txin.prevout.hash);
-            if (!view.HaveCoins(txin.prevout.hash)) {
-                if (pfMissingInputs)
+            if (!pcoinsTip->HaveCoinInCache(txin.prevout)) {
+                coins_to_uncache.push_back(txin.prevout);
+            }
+            if (!view.HaveCoin(txin.prevout)) {
+                if (pfMissingInputs) {
                     *pfMissingInputs = true;
+                }
                 return false; // fMissingInputs and !state.IsInvalid() is used to detect this condition, don't set state.Invalid()
             }
         }
@@ -731,8 +748,8 @@ bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState& state, const C
         // during reorgs to ensure COINBASE_MATURITY is still met.
         bool fSpendsCoinbase = false;
         BOOST_FOREACH(const CTxIn &txin, tx.vin) {
-            const CCoins *coins = view.AccessCoins(txin.prevout.hash);
-            if (coins->IsCoinBase()) {
+            const Coin &coin = view.AccessCoin(txin.prevout);
+            if (coin.IsCoinBase()) {
                 fSpendsCoinbase = true;
                 break;
             }
@@ -1008,7 +1025,7 @@ bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState& state, const C
         }
     }
 
-    GetMainSignals().SyncTransaction(tx, NULL, CMainSignals::SYNC_TRANSACTION_NOT_IN_BLOCK);
+    GetMainSignals().SyncTransaction(ptx, NULL, CMainSignals::SYNC_TRANSACTION_NOT_IN_BLOCK);
 
     return true;
 }
@@ -1017,10 +1034,10 @@ bool AcceptToMemoryPoolWithTime(CTxMemPool& pool, CValidationState &state, const
                         bool* pfMissingInputs, int64_t nAcceptTime, std::list<CTransactionRef>* plTxnReplaced,
                         bool fOverrideMempoolLimit, const CAmount nAbsurdFee)
 {
-    std::vector<uint256> vHashTxToUncache;
-    bool res = AcceptToMemoryPoolWorker(pool, state, tx, fLimitFree, pfMissingInputs, nAcceptTime, plTxnReplaced, fOverrideMempoolLimit, nAbsurdFee, vHashTxToUncache);
+    std::vector<COutPoint> coins_to_uncache;
+    bool res = AcceptToMemoryPoolWorker(pool, state, tx, fLimitFree, pfMissingInputs, nAcceptTime, plTxnReplaced, fOverrideMempoolLimit, nAbsurdFee, coins_to_uncache);
     if (!res) {
-        BOOST_FOREACH(const uint256& hashTx, vHashTxToUncache)
+        BOOST_FOREACH(const COutPoint& hashTx, coins_to_uncache)
             pcoinsTip->Uncache(hashTx);
     }
     // After we've (potentially) uncached entries, ensure our coins cache is still within its size limits
@@ -1074,10 +1091,9 @@ bool GetTransaction(const uint256 &hash, CTransactionRef &txOut, const Consensus
     if (fAllowSlow) { // use coin database to locate block that contains transaction, and scan it
         int nHeight = -1;
         {
-            const CCoinsViewCache& view = *pcoinsTip;
-            const CCoins* coins = view.AccessCoins(hash);
-            if (coins)
-                nHeight = coins->nHeight;
+            const Coin& coin = AccessByTxid(*pcoinsTip, hash);
+            if (!coin.IsSpent())
+                nHeight = coin.nHeight;
         }
         if (nHeight > 0)
             pindexSlow = chainActive[nHeight];
@@ -1109,7 +1125,7 @@ bool GetTransaction(const uint256 &hash, CTransactionRef &txOut, const Consensus
 // CBlock and CBlockIndex
 //
 
-bool CheckProofOfWork(const CBlockHeader& block, const Consensus::Params& params)
+bool CheckProofOfWork(const CBlockHeader& block, const Consensus::Params& params, uint256* phashPoW, const uint256& hashPoWKnown)
 {
     /* Except for legacy blocks with full version 1, ensure that
        the chain ID is correct.  Legacy blocks are not allowed since
@@ -1129,15 +1145,18 @@ bool CheckProofOfWork(const CBlockHeader& block, const Consensus::Params& params
             return error("%s : no auxpow on block with auxpow version",
                          __func__);
         int algo = block.GetAlgo();
-        if (!CheckProofOfWork(block.GetPoWHash(algo, params), algo, block.nBits, params))
+        uint256 hashPoW = hashPoWKnown.IsNull() ? block.GetPoWHash(algo, params) : hashPoWKnown;
+        if (!CheckProofOfWork(hashPoW, algo, block.nBits, params))
             return error("%s : non-AUX proof of work failed, hash=%s, algo=%d, nVersion=%d, PoWHash=%s",
             __func__,
             block.GetHash().ToString(),
             algo,
             block.nVersion,
-            block.GetPoWHash(algo, params).ToString()
+            hashPoW.ToString()
             );
 
+        if (phashPoW)
+            *phashPoW = hashPoW;
         return true;
     }
 
@@ -1155,9 +1174,12 @@ bool CheckProofOfWork(const CBlockHeader& block, const Consensus::Params& params
     if (!block.auxpow->check(block.GetHash(), block.GetChainId(), params))
         return error("%s : AUX POW is not valid", __func__);
     int algo = block.GetAlgo();
-    if (!CheckProofOfWork(block.auxpow->getParentBlockPoWHash(algo, params), algo, block.nBits, params))
+    uint256 hashPoW = hashPoWKnown.IsNull() ? block.auxpow->getParentBlockPoWHash(algo, params) : hashPoWKnown;
+    if (!CheckProofOfWork(hashPoW, algo, block.nBits, params))
         return error("%s : AUX proof of work failed", __func__);
 
+    if (phashPoW)
+        *phashPoW = hashPoW;
     return true;
 }
 
@@ -1186,7 +1208,7 @@ bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMessageHea
    both a block and its header.  */
 
 template<typename T>
-static bool ReadBlockOrHeader(T& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams)
+static bool ReadBlockOrHeader(T& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams, bool fCheckPoW = true)
 {
     block.SetNull();
 
@@ -1204,20 +1226,29 @@ static bool ReadBlockOrHeader(T& block, const CDiskBlockPos& pos, const Consensu
     }
 
     // Check the header
-    if (!CheckProofOfWork(block, consensusParams))
+    if (fCheckPoW && !CheckProofOfWork(block, consensusParams))
         return error("ReadBlockFromDisk: Errors in block header at %s", pos.ToString());
 
     return true;
 }
 
+/* Blocks in the index had their header, and so their proof of work, checked
+   when they were accepted.  Once the hash of what was read matches the index,
+   computing the (memory-hard) PoW hash again only costs time: it is skipped,
+   and the auxpow and target are checked against the PoW hash stored in the
+   index instead, where there is one.  */
 template<typename T>
 static bool ReadBlockOrHeader(T& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams)
 {
-    if (!ReadBlockOrHeader(block, pindex->GetBlockPos(), consensusParams))
+    const bool fTrusted = pindex->IsValid(BLOCK_VALID_TREE);
+    if (!ReadBlockOrHeader(block, pindex->GetBlockPos(), consensusParams, !fTrusted))
         return false;
     if (block.GetHash() != pindex->GetBlockHash())
         return error("ReadBlockFromDisk(CBlock&, CBlockIndex*): GetHash() doesn't match index for %s at %s",
                 pindex->ToString(), pindex->GetBlockPos().ToString());
+    if (fTrusted && !pindex->hashPoW.IsNull() && !CheckProofOfWork(block, consensusParams, NULL, pindex->hashPoW))
+        return error("ReadBlockFromDisk(CBlock&, CBlockIndex*): Errors in block header for %s at %s",
+                pindex->ToString(), pindex->GetBlockPos().ToString());
     return true;
 }
 
@@ -1236,6 +1267,36 @@ bool ReadBlockHeaderFromDisk(CBlockHeader& block, const CBlockIndex* pindex, con
     return ReadBlockOrHeader(block, pindex, consensusParams);
 }
 
+bool ReadRawBlockFromDisk(std::vector<unsigned char>& block, const CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart)
+{
+    // Step back over the index header written by WriteBlockToDisk
+    CDiskBlockPos hpos = pos;
+    if (hpos.nPos < CMessageHeader::MESSAGE_START_SIZE + sizeof(unsigned int))
+        return error("ReadRawBlockFromDisk: invalid position %s", pos.ToString());
+    hpos.nPos -= CMessageHeader::MESSAGE_START_SIZE + sizeof(unsigned int);
+
+    CAutoFile filein(OpenBlockFile(hpos, true), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull())
+        return error("ReadRawBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
+
+    try {
+        CMessageHeader::MessageStartChars blkStart;
+        unsigned int nSize;
+        filein >> FLATDATA(blkStart) >> nSize;
+        if (memcmp(blkStart, messageStart, CMessageHeader::MESSAGE_START_SIZE) != 0)
+            return error("ReadRawBlockFromDisk: block magic mismatch at %s", pos.ToString());
+        if (nSize > MAX_SIZE)
+            return error("ReadRawBlockFromDisk: block size %u too large at %s", nSize, pos.ToString());
+        block.resize(nSize);
+        filein.read((char*)block.data(), nSize);
+    }
+    catch (const std::exception& e) {
+        return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
+    }
+
+    return true;
+}
+
 CAmount GetBlockSubsidy(int nHeight, const Consensus::Params& consensusParams)
 {
     // initial mining phase, first 1999 blocks, reward grows from 1 to 64 COIN.
@@ -1311,7 +1372,7 @@ void CheckForkWarningConditions()
     if (pindexBestForkTip && chainActive.Height() - pindexBestForkTip->nHeight >= 72)
         pindexBestForkTip = NULL;
 
-    if (pindexBestForkTip || (pindexBestInvalid && pindexBestInvalid->nChainWork > chainActive.Tip()->nChainWork + (GetBlockProof(*chainActive.Tip()) * 6)))
+    if (pindexBestForkTip || (pindexBestInvalid && pindexBestInvalid->nChainWork > chainActive.Tip()->nChainWork + (GetBlockProof(*chainActive.Tip(), Params().GetConsensus()) * 6)))
     {
         if (!GetfLargeWorkForkFound() && pindexBestForkBase)
         {
@@ -1362,7 +1423,7 @@ void CheckForkWarningConditionsOnNewFork(CBlockIndex* pindexNewForkTip)
     // We define it this way because it allows us to only store the highest fork tip (+ base) which meets
     // the 7-block condition and from this always have the most-likely-to-cause-warning fork
     if (pfork && (!pindexBestForkTip || (pindexBestForkTip && pindexNewForkTip->nHeight > pindexBestForkTip->nHeight)) &&
-            pindexNewForkTip->nChainWork - pfork->nChainWork > (GetBlockProof(*pfork) * 7) &&
+            pindexNewForkTip->nChainWork - pfork->nChainWork > (GetBlockProof(*pfork, Params().GetConsensus()) * 7) &&
             chainActive.Height() - pindexNewForkTip->nHeight < 72)
     {
         pindexBestForkTip = pindexNewForkTip;
@@ -1404,24 +1465,13 @@ void UpdateCoins(const CTransaction& tx, CCoinsViewCache& inputs, CTxUndo &txund
     if (!tx.IsCoinBase()) {
         txundo.vprevout.reserve(tx.vin.size());
         BOOST_FOREACH(const CTxIn &txin, tx.vin) {
-            CCoinsModifier coins = inputs.ModifyCoins(txin.prevout.hash);
-            unsigned nPos = txin.prevout.n;
-
-            if (nPos >= coins->vout.size() || coins->vout[nPos].IsNull())
-                assert(false);
-            // mark an outpoint spent, and construct undo information
-            txundo.vprevout.push_back(CTxInUndo(coins->vout[nPos]));
-            coins->Spend(nPos);
-            if (coins->vout.size() == 0) {
-                CTxInUndo& undo = txundo.vprevout.back();
-                undo.nHeight = coins->nHeight;
-                undo.fCoinBase = coins->fCoinBase;
-                undo.nVersion = coins->nVersion;
-            }
+            txundo.vprevout.emplace_back();
+            bool is_spent = inputs.SpendCoin(txin.prevout, &txundo.vprevout.back());
+            assert(is_spent);
         }
     }
     // add outputs
-    inputs.ModifyNewCoins(tx.GetHash(), tx.IsCoinBase())->FromTx(tx, nHeight);
+    AddCoins(inputs, tx, nHeight);
 }
 
 void UpdateCoins(const CTransaction& tx, CCoinsViewCache& inputs, int nHeight)
@@ -1434,7 +1484,7 @@ bool CScriptCheck::operator()() {
     const CScript &scriptSig = ptxTo->vin[nIn].scriptSig;
     const CScriptWitness *witness = &ptxTo->vin[nIn].scriptWitness;
     if (!VerifyScript(scriptSig, scriptPubKey, witness, nFlags, CachingTransactionSignatureChecker(ptxTo, nIn, amount, cacheStore, *txdata), &error)) {
-        return false;
+        return fIgnoreFailure;
     }
     return true;
 }
@@ -1459,20 +1509,20 @@ bool CheckTxInputs(const CTransaction& tx, CValidationState& state, const CCoins
         for (unsigned int i = 0; i < tx.vin.size(); i++)
         {
             const COutPoint &prevout = tx.vin[i].prevout;
-            const CCoins *coins = inputs.AccessCoins(prevout.hash);
-            assert(coins);
+            const Coin& coin = inputs.AccessCoin(prevout);
+            assert(!coin.IsSpent());
 
             // If prev is coinbase, check that it's matured
-            if (coins->IsCoinBase()) {
-                if (nSpendHeight - coins->nHeight < COINBASE_MATURITY)
+            if (coin.IsCoinBase()) {
+                if (nSpendHeight - coin.nHeight < COINBASE_MATURITY)
                     return state.Invalid(false,
                         REJECT_INVALID, "bad-txns-premature-spend-of-coinbase",
-                        strprintf("tried to spend coinbase at depth %d", nSpendHeight - coins->nHeight));
+                        strprintf("tried to spend coinbase at depth %d", nSpendHeight - coin.nHeight));
             }
 
             // Check for negative or overflow input values
-            nValueIn += coins->vout[prevout.n].nValue;
-            if (!MoneyRange(coins->vout[prevout.n].nValue) || !MoneyRange(nValueIn))
+            nValueIn += coin.out.nValue;
+            if (!MoneyRange(coin.out.nValue) || !MoneyRange(nValueIn))
                 return state.DoS(100, false, REJECT_INVALID, "bad-txns-inputvalues-outofrange");
 
         }
@@ -1514,11 +1564,11 @@ bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsVi
         if (fScriptChecks) {
             for (unsigned int i = 0; i < tx.vin.size(); i++) {
                 const COutPoint &prevout = tx.vin[i].prevout;
-                const CCoins* coins = inputs.AccessCoins(prevout.hash);
-                assert(coins);
+                const Coin& coin = inputs.AccessCoin(prevout);
+                assert(!coin.IsSpent());
 
                 // Verify signature
-                CScriptCheck check(*coins, tx, i, flags, cacheStore, &txdata);
+                CScriptCheck check(coin.out, tx, i, flags, cacheStore, &txdata);
                 if (pvChecks) {
                     pvChecks->push_back(CScriptCheck());
                     check.swap(pvChecks->back());
@@ -1530,7 +1580,7 @@ bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsVi
                         // arguments; if so, don't trigger DoS protection to
                         // avoid splitting the network between upgraded and
                         // non-upgraded nodes.
-                        CScriptCheck check2(*coins, tx, i,
+                        CScriptCheck check2(coin.out, tx, i,
                                 flags & ~STANDARD_NOT_MANDATORY_VERIFY_FLAGS, cacheStore, &txdata);
                         if (check2())
                             return state.Invalid(false, REJECT_NONSTANDARD, strprintf("non-mandatory-script-verify-flag (%s)", ScriptErrorString(check.GetScriptError())));
@@ -1628,39 +1678,34 @@ bool AbortNode(CValidationState& state, const std::string& strMessage, const std
 } // anon namespace
 
 /**
- * Apply the undo operation of a CTxInUndo to the given chain state.
- * @param undo The undo object.
+ * Restore the UTXO in a Coin at a given COutPoint
+ * @param undo The Coin to be restored.
  * @param view The coins view to which to apply the changes.
  * @param out The out point that corresponds to the tx input.
  * @return True on success.
  */
-bool ApplyTxInUndo(const CTxInUndo& undo, CCoinsViewCache& view, const COutPoint& out)
+bool ApplyTxInUndo(Coin&& undo, CCoinsViewCache& view, const COutPoint& out)
 {
     bool fClean = true;
 
-    CCoinsModifier coins = view.ModifyCoins(out.hash);
-    if (undo.nHeight != 0) {
-        // undo data contains height: this is the last output of the prevout tx being spent
-        if (!coins->IsPruned())
-            fClean = fClean && error("%s: undo data overwriting existing transaction", __func__);
-        coins->Clear();
-        coins->fCoinBase = undo.fCoinBase;
-        coins->nHeight = undo.nHeight;
-        coins->nVersion = undo.nVersion;
-    } else {
-        if (coins->IsPruned())
-            fClean = fClean && error("%s: undo data adding output to missing transaction", __func__);
-    }
-    if (coins->IsAvailable(out.n))
+    if (view.HaveCoin(out))
         fClean = fClean && error("%s: undo data overwriting existing output", __func__);
-    if (coins->vout.size() < out.n+1)
-        coins->vout.resize(out.n+1);
-    coins->vout[out.n] = undo.txout;
+    if (undo.nHeight == 0) {
+        // Missing undo metadata (height and coinbase). Older versions included this
+        // information only in undo records for the last spend of a transactions'
+        // outputs. This implies that it must be present for some other output of the same tx.
+        const Coin& alternate = AccessByTxid(view, out.hash);
+        if (alternate.IsSpent())
+            return error("%s: undo data adding output to missing transaction", __func__);
+        undo.nHeight = alternate.nHeight;
+        undo.fCoinBase = alternate.fCoinBase;
+    }
+    view.AddCoin(out, std::move(undo), !fClean);
 
     return fClean;
 }
 
-bool DisconnectBlock(const CBlock& block, CValidationState& state, const CBlockIndex* pindex, CCoinsViewCache& view, bool* pfClean)
+bool DisconnectBlock(const CBlock& block, CValidationState& state, const CBlockIndex* pindex, CCoinsViewCache& view, bool* pfClean, CAddressIndexUpdate* paddressIndex)
 {
     assert(pindex->GetBlockHash() == view.GetBestBlock());
 
@@ -1686,33 +1731,34 @@ bool DisconnectBlock(const CBlock& block, CValidationState& state, const CBlockI
 
         // Check that all outputs are available and match the outputs in the block itself
         // exactly.
-        {
-        CCoinsModifier outs = view.ModifyCoins(hash);
-        outs->ClearUnspendable();
-
-        CCoins outsBlock(tx, pindex->nHeight);
-        // The CCoins serialization does not serialize negative numbers.
-        // No network rules currently depend on the version here, so an inconsistency is harmless
-        // but it must be corrected before txout nversion ever influences a network rule.
-        if (outsBlock.nVersion < 0)
-            outs->nVersion = outsBlock.nVersion;
-        if (*outs != outsBlock)
-            fClean = fClean && error("DisconnectBlock(): added transaction mismatch? database corrupted");
-
-        // remove outputs
-        outs->Clear();
+        bool fCoinBase = tx.IsCoinBase();
+        for (size_t o = 0; o < tx.vout.size(); o++) {
+            if (!tx.vout[o].scriptPubKey.IsUnspendable()) {
+                COutPoint out(hash, o);
+                Coin coin;
+                bool fSpent = view.SpendCoin(out, &coin);
+                if (!fSpent || tx.vout[o] != coin.out || pindex->nHeight != (int)coin.nHeight || fCoinBase != (bool)coin.fCoinBase)
+                    fClean = fClean && error("DisconnectBlock(): added transaction mismatch? database corrupted");
+                if (paddressIndex)
+                    paddressIndex->vErase.push_back(CAddressIndexKey(GetAddressIndexHash(tx.vout[o].scriptPubKey), pindex->nHeight, hash, o));
+            }
         }
 
         // restore inputs
         if (i > 0) { // not coinbases
-            const CTxUndo &txundo = blockUndo.vtxundo[i-1];
+            CTxUndo &txundo = blockUndo.vtxundo[i-1];
             if (txundo.vprevout.size() != tx.vin.size())
                 return error("DisconnectBlock(): transaction and undo data inconsistent");
             for (unsigned int j = tx.vin.size(); j-- > 0;) {
                 const COutPoint &out = tx.vin[j].prevout;
-                const CTxInUndo &undo = txundo.vprevout[j];
-                if (!ApplyTxInUndo(undo, view, out))
+                if (!ApplyTxInUndo(std::move(txundo.vprevout[j]), view, out))
                     fClean = false;
+                if (paddressIndex) {
+                    // The restored coin has its height filled in, even from old undo data
+                    const Coin& coin = view.AccessCoin(out);
+                    if (!coin.IsSpent())
+                        paddressIndex->vWrite.push_back(std::make_pair(CAddressIndexKey(GetAddressIndexHash(coin.out.scriptPubKey), coin.nHeight, out.hash, out.n), CAddressIndexValue(coin.out.nValue)));
+                }
             }
         }
     }
@@ -1754,12 +1800,74 @@ void static FlushBlockFile(bool fFinalize = false)
 bool FindUndoPos(CValidationState &state, int nFile, CDiskBlockPos &pos, unsigned int nAddSize);
 
 static CCheckQueue<CScriptCheck> scriptcheckqueue(128);
+// Taken by ConnectBlock and PrecheckMempoolScripts, as the queue supports only
+// a single master at a time.
+static CCriticalSection cs_scriptcheckqueue;
 
 void ThreadScriptCheck() {
     RenameThread("bitcoin-scriptch");
     scriptcheckqueue.Thread();
 }
 
+/**
+ * Closure representing the proof of work check of one or more headers of the
+ * same algo, run by ProcessNewBlockHeaders before it takes cs_main. Headers
+ * whose PoW function has a batch implementation are checked up to HASH_LANES
+ * at a time, so that GetPoWHashes can hash them together; the others one per
+ * check. The PoW hash is only stored if the check passes; headers without one
+ * are checked again (and rejected with the proper state) by AcceptBlockHeader.
+ */
+class CPowCheck
+{
+private:
+    int algo;
+    const Consensus::Params* pparams;
+    std::vector<const CBlockHeader*> vpheaders;
+    std::vector<uint256*> vphashPoW;
+
+public:
+    CPowCheck(): algo(0), pparams(NULL) {}
+    CPowCheck(int algoIn, const Consensus::Params& paramsIn) : algo(algoIn), pparams(&paramsIn) { }
+
+    void Add(const CBlockHeader& header, uint256* phashPoW) {
+        vpheaders.push_back(&header);
+        vphashPoW.push_back(phashPoW);
+    }
+
+    size_t size() const { return vpheaders.size(); }
+
+    bool operator()() {
+        std::vector<const CPureBlockHeader*> vpPoWHeaders;
+        vpPoWHeaders.reserve(vpheaders.size());
+        for (const CBlockHeader* pheader : vpheaders)
+            vpPoWHeaders.push_back(pheader->auxpow ? &pheader->auxpow->getParentBlock() : pheader);
+        std::vector<uint256> vHashPoW(vpheaders.size());
+        GetPoWHashes(&vpPoWHeaders[0], vpPoWHeaders.size(), algo, *pparams, &vHashPoW[0]);
+        for (size_t i = 0; i < vpheaders.size(); i++) {
+            if (!CheckProofOfWork(*vpheaders[i], *pparams, vphashPoW[i], vHashPoW[i]))
+                return false;
+        }
+        return true;
+    }
+
+    void swap(CPowCheck &check) {
+        std::swap(algo, check.algo);
+        std::swap(pparams, check.pparams);
+        vpheaders.swap(check.vpheaders);
+        vphashPoW.swap(check.vphashPoW);
+    }
+};
+
+// PoW hashes are expensive, so hand them out to the workers in small batches.
+static CCheckQueue<CPowCheck> powcheckqueue(4);
+// CCheckQueue supports only a single master at a time.
+static CCriticalSection cs_powcheckqueue;
+
+void ThreadPowCheck() {
+    RenameThread("bitcoin-powcheck");
+    powcheckqueue.Thread();
+}
+
 // Protected by cs_main
 VersionBitsCache versionbitscache;
 
@@ -1805,6 +1913,30 @@ public:
 // Protected by cs_main
 static ThresholdConditionCache warningcache[VERSIONBITS_NUM_BITS];
 
+/** Collect the address index entries of the outputs a block creates and spends */
+static void AddressIndexConnectBlock(const CBlock& block, const CBlockUndo& blockundo, int nHeight, CAddressIndexUpdate& update)
+{
+    // Transactions in block order, so that outputs spent in the same block
+    // are written as created before being marked spent
+    for (unsigned int i = 0; i < block.vtx.size(); i++) {
+        const CTransaction& tx = *(block.vtx[i]);
+        const uint256& txid = tx.GetHash();
+        if (i > 0) {
+            const CTxUndo& txundo = blockundo.vtxundo[i-1];
+            for (unsigned int j = 0; j < tx.vin.size(); j++) {
+                const COutPoint& prevout = tx.vin[j].prevout;
+                const Coin& coin = txundo.vprevout[j];
+                update.vWrite.push_back(std::make_pair(CAddressIndexKey(GetAddressIndexHash(coin.out.scriptPubKey), coin.nHeight, prevout.hash, prevout.n), CAddressIndexValue(coin.out.nValue, txid, nHeight)));
+            }
+        }
+        for (unsigned int o = 0; o < tx.vout.size(); o++) {
+            const CTxOut& out = tx.vout[o];
+            if (!out.scriptPubKey.IsUnspendable())
+                update.vWrite.push_back(std::make_pair(CAddressIndexKey(GetAddressIndexHash(out.scriptPubKey), nHeight, txid, o), CAddressIndexValue(out.nValue)));
+        }
+    }
+}
+
 static int64_t nTimeCheck = 0;
 static int64_t nTimeForks = 0;
 static int64_t nTimeVerify = 0;
@@ -1908,10 +2040,12 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
 
     if (fEnforceBIP30) {
         for (const auto& tx : block.vtx) {
-            const CCoins* coins = view.AccessCoins(tx->GetHash());
-            if (coins && !coins->IsPruned())
-                return state.DoS(100, error("ConnectBlock(): tried to overwrite transaction"),
-                                 REJECT_INVALID, "bad-txns-BIP30");
+            for (size_t o = 0; o < tx->vout.size(); o++) {
+                if (view.HaveCoin(COutPoint(tx->GetHash(), o))) {
+                    return state.DoS(100, error("ConnectBlock(): tried to overwrite transaction"),
+                                     REJECT_INVALID, "bad-txns-BIP30");
+                }
+            }
         }
     }
 
@@ -1967,15 +2101,13 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
 
     CBlockUndo blockundo;
 
+    LOCK(cs_scriptcheckqueue);
     CCheckQueueControl<CScriptCheck> control(fScriptChecks && nScriptCheckThreads ? &scriptcheckqueue : NULL);
 
     std::vector<int> prevheights;
     CAmount nFees = 0;
     int nInputs = 0;
     int64_t nSigOpsCost = 0;
-    CDiskTxPos pos(pindex->GetBlockPos(), GetSizeOfCompactSize(block.vtx.size()));
-    std::vector<std::pair<uint256, CDiskTxPos> > vPos;
-    vPos.reserve(block.vtx.size());
     blockundo.vtxundo.reserve(block.vtx.size() - 1);
     std::vector<PrecomputedTransactionData> txdata;
     txdata.reserve(block.vtx.size()); // Required so that pointers to individual PrecomputedTransactionData don't get invalidated
@@ -1996,7 +2128,7 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
             // be in ConnectBlock because they require the UTXO set
             prevheights.resize(tx.vin.size());
             for (size_t j = 0; j < tx.vin.size(); j++) {
-                prevheights[j] = view.AccessCoins(tx.vin[j].prevout.hash)->nHeight;
+                prevheights[j] = view.AccessCoin(tx.vin[j].prevout).nHeight;
             }
 
             if (!SequenceLocks(tx, nLockTimeFlags, &prevheights, *pindex)) {
@@ -2032,9 +2164,6 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
             blockundo.vtxundo.push_back(CTxUndo());
         }
         UpdateCoins(tx, view, i == 0 ? undoDummy : blockundo.vtxundo.back(), pindex->nHeight);
-
-        vPos.push_back(std::make_pair(tx.GetHash(), pos));
-        pos.nTxOffset += ::GetSerializeSize(tx, SER_DISK, CLIENT_VERSION);
     }
     int64_t nTime3 = GetTimeMicros(); nTimeConnect += nTime3 - nTime2;
     LogPrint("bench", "      - Connect %u transactions: %.2fms (%.3fms/tx, %.3fms/txin) [%.2fs]\n", (unsigned)block.vtx.size(), 0.001 * (nTime3 - nTime2), 0.001 * (nTime3 - nTime2) / block.vtx.size(), nInputs <= 1 ? 0 : 0.001 * (nTime3 - nTime2) / (nInputs-1), nTimeConnect * 0.000001);
@@ -2073,9 +2202,12 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         setDirtyBlockIndex.insert(pindex);
     }
 
-    if (fTxIndex)
-        if (!pblocktree->WriteTxIndex(vPos))
-            return AbortNode(state, "Failed to write transaction index");
+    if (fAddressIndex) {
+        CAddressIndexUpdate addressIndex;
+        AddressIndexConnectBlock(block, blockundo, pindex->nHeight, addressIndex);
+        if (!pblocktree->UpdateAddressIndex(addressIndex))
+            return AbortNode(state, "Failed to write address index");
+    }
 
     // add this block to the view's block chain
     view.SetBestBlock(pindex->GetBlockHash());
@@ -2183,12 +2315,12 @@ bool static FlushStateToDisk(CValidationState &state, FlushStateMode mode, int n
     }
     // Flush best chain related state. This can only be done if the blocks / block index write was also done.
     if (fDoFullFlush) {
-        // Typical CCoins structures on disk are around 128 bytes in size.
+        // Typical Coin structures on disk are around 48 bytes in size.
         // Pushing a new one to the database can cause it to be written
         // twice (once in the log, and once in the tables). This is already
         // an overestimation, as most will delete an existing entry or
         // overwrite one. Still, use a conservative safety factor of 2.
-        if (!CheckDiskSpace(128 * 2 * 2 * pcoinsTip->GetCacheSize()))
+        if (!CheckDiskSpace(48 * 2 * 2 * pcoinsTip->GetCacheSize()))
             return state.Error("out of disk space");
         // Flush the chainstate (which may refer to block index entries).
         if (!pcoinsTip->Flush())
@@ -2269,7 +2401,7 @@ void static UpdateTip(CBlockIndex *pindexNew, const CChainParams& chainParams) {
             }
         }
     }
-    LogPrintf("%s: new best=%s height=%d algo=%d (%s) version=0x%08x log2_work=%.8g tx=%lu date='%s' progress=%f cache=%.1fMiB(%utx)", __func__,
+    LogPrintf("%s: new best=%s height=%d algo=%d (%s) version=0x%08x log2_work=%.8g tx=%lu date='%s' progress=%f cache=%.1fMiB(%utxo)", __func__,
       chainActive.Tip()->GetBlockHash().ToString(), chainActive.Height(), chainActive.Tip()->GetAlgo(),
       GetAlgoName(chainActive.Tip()->GetAlgo(), chainActive.Tip()->GetBlockTime(), chainParams.GetConsensus()), chainActive.Tip()->nVersion,
       log(chainActive.Tip()->nChainWork.getdouble())/log(2.0), (unsigned long)chainActive.Tip()->nChainTx,
@@ -2287,17 +2419,21 @@ bool static DisconnectTip(CValidationState& state, const CChainParams& chainpara
     CBlockIndex *pindexDelete = chainActive.Tip();
     assert(pindexDelete);
     // Read block from disk.
-    CBlock block;
+    std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
+    CBlock& block = *pblock;
     if (!ReadBlockFromDisk(block, pindexDelete, chainparams.GetConsensus()))
         return AbortNode(state, "Failed to read block");
     // Apply the block atomically to the chain state.
     int64_t nStart = GetTimeMicros();
     {
         CCoinsViewCache view(pcoinsTip);
-        if (!DisconnectBlock(block, state, pindexDelete, view))
+        CAddressIndexUpdate addressIndex;
+        if (!DisconnectBlock(block, state, pindexDelete, view, NULL, fAddressIndex ? &addressIndex : NULL))
             return error("DisconnectTip(): DisconnectBlock %s failed", pindexDelete->GetBlockHash().ToString());
         bool flushed = view.Flush();
         assert(flushed);
+        if (fAddressIndex && !pblocktree->UpdateAddressIndex(addressIndex))
+            return AbortNode(state, "Failed to write address index");
     }
     LogPrint("bench", "- Disconnect block: %.2fms\n", (GetTimeMicros() - nStart) * 0.001);
     // Write the chain state to disk, if necessary.
@@ -2330,8 +2466,9 @@ bool static DisconnectTip(CValidationState& state, const CChainParams& chainpara
     // Let wallets know transactions went from 1-confirmed to
     // 0-confirmed or conflicted:
     for (const auto& tx : block.vtx) {
-        GetMainSignals().SyncTransaction(*tx, pindexDelete->pprev, CMainSignals::SYNC_TRANSACTION_NOT_IN_BLOCK);
+        GetMainSignals().SyncTransaction(tx, pindexDelete->pprev, CMainSignals::SYNC_TRANSACTION_NOT_IN_BLOCK);
     }
+    GetMainSignals().BlockDisconnected(pblock, pindexDelete);
     return true;
 }
 
@@ -2638,7 +2775,8 @@ bool ActivateBestChain(CValidationState &state, const CChainParams& chainparams,
                 assert(pair.second);
                 const CBlock& block = *(pair.second);
                 for (unsigned int i = 0; i < block.vtx.size(); i++)
-                    GetMainSignals().SyncTransaction(*block.vtx[i], pair.first, i);
+                    GetMainSignals().SyncTransaction(block.vtx[i], pair.first, i);
+                GetMainSignals().BlockConnected(pair.second, pair.first);
             }
         }
         // When we reach this point, we switched to a new tip (stored in pindexNewTip).
@@ -2766,7 +2904,7 @@ bool ResetBlockFailureFlags(CBlockIndex *pindex) {
     return true;
 }
 
-CBlockIndex* AddToBlockIndex(const CBlockHeader& block)
+CBlockIndex* AddToBlockIndex(const CBlockHeader& block, const Consensus::Params& consensusParams, const uint256& hashPoW = uint256())
 {
     // Check for duplicate
     uint256 hash = block.GetHash();
@@ -2781,6 +2919,17 @@ CBlockIndex* AddToBlockIndex(const CBlockHeader& block)
     // to avoid miners withholding blocks but broadcasting headers, to get a
     // competitive advantage.
     pindexNew->nSequenceId = 0;
+    pindexNew->hashPoW = hashPoW;
+    if (block.auxpow) {
+        // Keep the auxpow of recent headers in memory, so that serving them
+        // to peers does not need a disk read.
+        pindexNew->pauxpow = block.auxpow;
+        dequeAuxpowCached.push_back(pindexNew);
+        if (dequeAuxpowCached.size() > MAX_AUXPOW_HEADERS_CACHED) {
+            dequeAuxpowCached.front()->pauxpow.reset();
+            dequeAuxpowCached.pop_front();
+        }
+    }
     BlockMap::iterator mi = mapBlockIndex.insert(std::make_pair(hash, pindexNew)).first;
     pindexNew->phashBlock = &((*mi).first);
     BlockMap::iterator miPrev = mapBlockIndex.find(block.hashPrevBlock);
@@ -2791,7 +2940,7 @@ CBlockIndex* AddToBlockIndex(const CBlockHeader& block)
         pindexNew->BuildSkip();
     }
     pindexNew->nTimeMax = (pindexNew->pprev ? std::max(pindexNew->pprev->nTimeMax, pindexNew->nTime) : pindexNew->nTime);
-    pindexNew->nChainWork = (pindexNew->pprev ? pindexNew->pprev->nChainWork : 0) + GetBlockProof(*pindexNew);
+    pindexNew->nChainWork = (pindexNew->pprev ? pindexNew->pprev->nChainWork : 0) + GetBlockProof(*pindexNew, consensusParams);
     pindexNew->RaiseValidity(BLOCK_VALID_TREE);
     if (pindexBestHeader == NULL || pindexBestHeader->nChainWork < pindexNew->nChainWork)
         pindexBestHeader = pindexNew;
@@ -2938,16 +3087,16 @@ bool FindUndoPos(CValidationState &state, int nFile, CDiskBlockPos &pos, unsigne
     return true;
 }
 
-bool CheckBlockHeader(const CBlockHeader& block, CValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW)
+bool CheckBlockHeader(const CBlockHeader& block, CValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW, uint256* phashPoW)
 {
     // Check proof of work matches claimed amount
-    if (fCheckPOW && !CheckProofOfWork(block, consensusParams))
+    if (fCheckPOW && !CheckProofOfWork(block, consensusParams, phashPoW))
         return state.DoS(50, false, REJECT_INVALID, "high-hash", false, "proof of work failed");
 
     return true;
 }
 
-bool CheckBlock(const CBlock& block, CValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW, bool fCheckMerkleRoot)
+bool CheckBlock(const CBlock& block, CValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW, bool fCheckMerkleRoot, uint256* phashPoW)
 {
     // These are checks that are independent of context.
 
@@ -2956,7 +3105,7 @@ bool CheckBlock(const CBlock& block, CValidationState& state, const Consensus::P
 
     // Check that the header is valid (particularly PoW).  This is mostly
     // redundant with the call in AcceptBlockHeader.
-    if (!CheckBlockHeader(block, state, consensusParams, fCheckPOW))
+    if (!CheckBlockHeader(block, state, consensusParams, fCheckPOW, phashPoW))
         return false;
 
     // Check the merkle root.
@@ -3227,13 +3376,18 @@ bool ContextualCheckBlock(const CBlock& block, CValidationState& state, const Co
     return true;
 }
 
-static bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex)
+/**
+ * Add a header to the block index after checking it. hashPoWChecked may hold
+ * the PoW hash of the header if its proof of work has already been verified.
+ */
+static bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, const uint256& hashPoWChecked = uint256())
 {
     AssertLockHeld(cs_main);
     // Check for duplicate
     uint256 hash = block.GetHash();
     BlockMap::iterator miSelf = mapBlockIndex.find(hash);
     CBlockIndex *pindex = NULL;
+    uint256 hashPoW = hashPoWChecked;
     if (hash != chainparams.GetConsensus().hashGenesisBlock) {
 
         if (miSelf != mapBlockIndex.end()) {
@@ -3246,7 +3400,7 @@ static bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state
             return true;
         }
 
-        if (!CheckBlockHeader(block, state, chainparams.GetConsensus()))
+        if (!CheckBlockHeader(block, state, chainparams.GetConsensus(), hashPoW.IsNull(), &hashPoW))
             return error("%s: Consensus::CheckBlockHeader: %s, %s", __func__, hash.ToString(), FormatStateMessage(state));
 
         // Get prev block index
@@ -3292,7 +3446,7 @@ static bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state
             return error("%s: Consensus::ContextualCheckBlockHeader: %s, %s", __func__, hash.ToString(), FormatStateMessage(state));
     }
     if (pindex == NULL)
-        pindex = AddToBlockIndex(block);
+        pindex = AddToBlockIndex(block, chainparams.GetConsensus(), hashPoW);
 
     if (ppindex)
         *ppindex = pindex;
@@ -3305,11 +3459,66 @@ static bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state
 // Exposed wrapper for AcceptBlockHeader
 bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& headers, CValidationState& state, const CChainParams& chainparams, const CBlockIndex** ppindex)
 {
+    // Verify the proof of work of unknown headers before taking cs_main, on
+    // the PoW check threads if there are any, so that memory-hard hashing of
+    // a whole headers message does not stall everything else waiting for the
+    // lock. Headers of an algo whose PoW hash has a batch implementation are
+    // checked HASH_LANES at a time. Once a check fails the remaining ones are
+    // skipped, and AcceptBlockHeader checks the headers without a PoW hash
+    // itself.
+    std::vector<uint256> vHashPoW(headers.size());
+    if (headers.size() > 1) {
+        const Consensus::Params& consensusParams = chainparams.GetConsensus();
+        std::vector<CPowCheck> vChecks;
+        vChecks.reserve(headers.size());
+        std::vector<CPowCheck> vBatches(NUM_ALGOS);
+        {
+            LOCK(cs_main);
+            for (size_t i = 0; i < headers.size(); i++) {
+                const CBlockHeader& header = headers[i];
+                if (mapBlockIndex.count(header.GetHash()))
+                    continue;
+                const int algo = header.GetAlgo();
+                const CPureBlockHeader& powHeader = header.auxpow ? header.auxpow->getParentBlock() : header;
+                if (!powHeader.HasBatchPoWHash(algo, consensusParams)) {
+                    vChecks.push_back(CPowCheck(algo, consensusParams));
+                    vChecks.back().Add(header, &vHashPoW[i]);
+                    continue;
+                }
+                CPowCheck& batch = vBatches[algo];
+                if (batch.size() == 0)
+                    batch = CPowCheck(algo, consensusParams);
+                batch.Add(header, &vHashPoW[i]);
+                if (batch.size() == HASH_LANES) {
+                    vChecks.push_back(CPowCheck());
+                    vChecks.back().swap(batch);
+                }
+            }
+        }
+        for (CPowCheck& batch : vBatches) {
+            if (batch.size() > 0) {
+                vChecks.push_back(CPowCheck());
+                vChecks.back().swap(batch);
+            }
+        }
+        if (nScriptCheckThreads) {
+            LOCK(cs_powcheckqueue);
+            CCheckQueueControl<CPowCheck> control(&powcheckqueue);
+            control.Add(vChecks);
+            control.Wait();
+        } else {
+            for (CPowCheck& check : vChecks) {
+                if (!check())
+                    break;
+            }
+        }
+    }
+
     {
         LOCK(cs_main);
-        for (const CBlockHeader& header : headers) {
+        for (size_t i = 0; i < headers.size(); i++) {
             CBlockIndex *pindex = NULL; // Use a temp pindex instead of ppindex to avoid a const_cast
-            if (!AcceptBlockHeader(header, state, chainparams, &pindex)) {
+            if (!AcceptBlockHeader(headers[i], state, chainparams, &pindex, vHashPoW[i])) {
                 return false;
             }
             if (ppindex) {
@@ -3322,7 +3531,7 @@ bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& headers, CValidatio
 }
 
 /** Store block on disk. If dbp is non-NULL, the file is known to already reside on disk */
-static bool AcceptBlock(const std::shared_ptr<const CBlock>& pblock, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, bool fRequested, const CDiskBlockPos* dbp, bool* fNewBlock)
+static bool AcceptBlock(const std::shared_ptr<const CBlock>& pblock, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, bool fRequested, const CDiskBlockPos* dbp, bool* fNewBlock, const uint256& hashPoWChecked = uint256())
 {
     const CBlock& block = *pblock;
 
@@ -3332,7 +3541,7 @@ static bool AcceptBlock(const std::shared_ptr<const CBlock>& pblock, CValidation
     CBlockIndex *pindexDummy = NULL;
     CBlockIndex *&pindex = ppindex ? *ppindex : pindexDummy;
 
-    if (!AcceptBlockHeader(block, state, chainparams, &pindex))
+    if (!AcceptBlockHeader(block, state, chainparams, &pindex, hashPoWChecked))
         return false;
 
     // Try to process all requested blocks that we don't have, but only
@@ -3362,7 +3571,7 @@ static bool AcceptBlock(const std::shared_ptr<const CBlock>& pblock, CValidation
     }
     if (fNewBlock) *fNewBlock = true;
 
-    if (!CheckBlock(block, state, chainparams.GetConsensus()) ||
+    if (!CheckBlock(block, state, chainparams.GetConsensus(), hashPoWChecked.IsNull()) ||
         !ContextualCheckBlock(block, state, chainparams.GetConsensus(), pindex->pprev)) {
         if (state.IsInvalid() && !state.CorruptionPossible()) {
             pindex->nStatus |= BLOCK_FAILED_VALID;
@@ -3679,7 +3888,7 @@ bool static LoadBlockIndexDB(const CChainParams& chainparams)
     BOOST_FOREACH(const PAIRTYPE(int, CBlockIndex*)& item, vSortedByHeight)
     {
         CBlockIndex* pindex = item.second;
-        pindex->nChainWork = (pindex->pprev ? pindex->pprev->nChainWork : 0) + GetBlockProof(*pindex);
+        pindex->nChainWork = (pindex->pprev ? pindex->pprev->nChainWork : 0) + GetBlockProof(*pindex, chainparams.GetConsensus());
         pindex->nTimeMax = (pindex->pprev ? std::max(pindex->pprev->nTimeMax, pindex->nTime) : pindex->nTime);
         // We can link the chain of blocks for which we've received transactions at some point.
         // Pruned nodes may have deleted the block.
@@ -3750,9 +3959,9 @@ bool static LoadBlockIndexDB(const CChainParams& chainparams)
     pblocktree->ReadReindexing(fReindexing);
     fReindex |= fReindexing;
 
-    // Check whether we have a transaction index
-    pblocktree->ReadFlag("txindex", fTxIndex);
-    LogPrintf("%s: transaction index %s\n", __func__, fTxIndex ? "enabled" : "disabled");
+    // Check whether we have an address index
+    pblocktree->ReadFlag("addressindex", fAddressIndex);
+    LogPrintf("%s: address index %s\n", __func__, fAddressIndex ? "enabled" : "disabled");
 
     // Load pointer to end of best chain
     BlockMap::iterator it = mapBlockIndex.find(pcoinsTip->GetBestBlock());
@@ -3974,6 +4183,7 @@ void UnloadBlockIndex()
     nBlockSequenceId = 1;
     setDirtyBlockIndex.clear();
     setDirtyFileInfo.clear();
+    dequeAuxpowCached.clear();
     versionbitscache.Clear();
     for (int b = 0; b < VERSIONBITS_NUM_BITS; b++) {
         warningcache[b].clear();
@@ -4002,9 +4212,9 @@ bool InitBlockIndex(const CChainParams& chainparams)
     if (chainActive.Genesis() != NULL)
         return true;
 
-    // Use the provided setting for -txindex in the new database
-    fTxIndex = GetBoolArg("-txindex", DEFAULT_TXINDEX);
-    pblocktree->WriteFlag("txindex", fTxIndex);
+    // Use the provided setting for -addressindex in the new database
+    fAddressIndex = GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX);
+    pblocktree->WriteFlag("addressindex", fAddressIndex);
     LogPrintf("Initializing databases...\n");
 
     // Only add the genesis block if not reindexing (in which case we reuse the one already on disk)
@@ -4019,7 +4229,7 @@ bool InitBlockIndex(const CChainParams& chainparams)
                 return error("LoadBlockIndex(): FindBlockPos failed");
             if (!WriteBlockToDisk(block, blockPos, chainparams.MessageStart()))
                 return error("LoadBlockIndex(): writing genesis block to disk failed");
-            CBlockIndex *pindex = AddToBlockIndex(block);
+            CBlockIndex *pindex = AddToBlockIndex(block, chainparams.GetConsensus());
             if (!ReceivedBlockTransactions(block, state, pindex, blockPos))
                 return error("LoadBlockIndex(): genesis block not accepted");
             // Force a chainstate write so that when we VerifyDB in a moment, it doesn't check stale data
@@ -4032,19 +4242,138 @@ bool InitBlockIndex(const CChainParams& chainparams)
     return true;
 }
 
-bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskBlockPos *dbp)
+namespace {
+
+/** How many files the readers may be ahead of the file being connected, per reader */
+static const size_t MAX_IMPORT_FILES_AHEAD = 2;
+
+/** A file of blocks to import */
+struct CImportFile
 {
-    // Map of disk positions for blocks with unknown parent (only used for reindex)
-    static std::multimap<uint256, CDiskBlockPos> mapBlocksUnknownParent;
-    int64_t nStart = GetTimeMillis();
+    boost::filesystem::path path;
+    int nFile; //!< number of our own block file (-reindex), or -1 for an external file
+};
+
+/** A block found in an import file by a reader */
+struct CImportedBlock
+{
+    std::shared_ptr<const CBlock> pblock; //!< NULL once the block only has its position kept
+    uint256 hash;
+    uint256 hashPrevBlock;
+    uint256 hashPoW; //!< set if the block passed CheckBlock, so that its PoW needs no checking again unless it is read again
+    size_t nFileIndex;
+    uint64_t nPos;
+    unsigned int nSize;
+};
+
+/**
+ * Imports the blocks of a list of files. Reader threads each take the next
+ * file, locate and deserialize its blocks and check them with CheckBlock,
+ * which includes the memory-hard proof of work. The calling thread then
+ * accepts the blocks in file order, so that a block is normally accepted
+ * right after its parent. Blocks whose parent is not known yet are held
+ * until it is.
+ */
+class CBlockImporter
+{
+private:
+    const CChainParams& chainparams;
+    const std::vector<CImportFile>& vFiles;
+
+    std::mutex mutex;
+    std::condition_variable condBlocks;  //!< blocks were queued or a file was finished
+    std::condition_variable condReaders; //!< the buffer or the file being accepted changed
+    std::vector<std::deque<CImportedBlock> > vQueues;
+    std::vector<bool> vFileDone;
+    std::vector<bool> vFileSpilled; //!< blocks of the file had to be read again
+    size_t nNextFile;
+    size_t nCurrentFile;
+    size_t nMaxFilesAhead;
+    uint64_t nBufferSize;
+    uint64_t nMaxBufferSize; //!< -importbuffer, in bytes
+    bool fStop;
+    bool fOpenFailed;
+    std::vector<std::thread> vThreads;
+
+    // Only used by the thread accepting the blocks
+    std::multimap<uint256, CImportedBlock> mapOutOfOrder;
+    int nLoaded;
+
+    void ThreadRead();
+    void ReadFile(size_t nIndex);
+    void Queue(size_t nIndex, CImportedBlock& item);
+    void ReleaseBuffer(const CImportedBlock& item);
+    bool ProcessBlock(CImportedBlock& item);
+    bool AcceptImportedBlock(const CImportedBlock& item);
+    void Stop();
+
+public:
+    CBlockImporter(const CChainParams& chainparamsIn, const std::vector<CImportFile>& vFilesIn) :
+        chainparams(chainparamsIn), vFiles(vFilesIn), vQueues(vFilesIn.size()), vFileDone(vFilesIn.size(), false), vFileSpilled(vFilesIn.size(), false),
+        nNextFile(0), nCurrentFile(0), nMaxFilesAhead(0), nBufferSize(0), nMaxBufferSize(0), fStop(false), fOpenFailed(false), nLoaded(0) {}
+    ~CBlockImporter() { Stop(); }
+
+    /** Import all files, returns false if a file could not be opened or the import was aborted */
+    bool Run();
+};
+
+void CBlockImporter::Stop()
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        fStop = true;
+    }
+    condReaders.notify_all();
+    for (std::thread& thread : vThreads)
+        thread.join();
+    vThreads.clear();
+}
+
+void CBlockImporter::ThreadRead()
+{
+    while (true) {
+        size_t nIndex;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condReaders.wait(lock, [&] { return fStop || nNextFile >= vFiles.size() || nNextFile < nCurrentFile + nMaxFilesAhead; });
+            if (fStop || nNextFile >= vFiles.size())
+                return;
+            nIndex = nNextFile++;
+        }
+        ReadFile(nIndex);
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            vFileDone[nIndex] = true;
+        }
+        condBlocks.notify_all();
+    }
+}
+
+void CBlockImporter::ReadFile(size_t nIndex)
+{
+    const CImportFile& file = vFiles[nIndex];
+    FILE* fileIn = fopen(file.path.string().c_str(), "rb");
+    if (!fileIn) {
+        LogPrintf("Warning: Could not open blocks file %s\n", file.path.string());
+        std::unique_lock<std::mutex> lock(mutex);
+        fOpenFailed = true;
+        return;
+    }
+    if (file.nFile >= 0)
+        LogPrintf("Reindexing block file blk%05u.dat...\n", (unsigned int)file.nFile);
+    else
+        LogPrintf("Importing blocks file %s...\n", file.path.string());
 
-    int nLoaded = 0;
     try {
         // This takes over fileIn and calls fclose() on it in the CBufferedFile destructor
         CBufferedFile blkdat(fileIn, 2*MAX_BLOCK_SERIALIZED_SIZE, MAX_BLOCK_SERIALIZED_SIZE+8, SER_DISK, CLIENT_VERSION);
         uint64_t nRewind = blkdat.GetPos();
         while (!blkdat.eof()) {
-            boost::this_thread::interruption_point();
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                if (fStop)
+                    return;
+            }
 
             blkdat.SetPos(nRewind);
             nRewind++; // start one byte further next time, in case of failure
@@ -4069,74 +4398,25 @@ bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskB
             try {
                 // read block
                 uint64_t nBlockPos = blkdat.GetPos();
-                if (dbp)
-                    dbp->nPos = nBlockPos;
                 blkdat.SetLimit(nBlockPos + nSize);
                 blkdat.SetPos(nBlockPos);
                 std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
-                CBlock& block = *pblock;
-                blkdat >> block;
+                blkdat >> *pblock;
                 nRewind = blkdat.GetPos();
 
-                // detect out of order blocks, and store them for later
-                uint256 hash = block.GetHash();
-                if (hash != chainparams.GetConsensus().hashGenesisBlock && mapBlockIndex.find(block.hashPrevBlock) == mapBlockIndex.end()) {
-                    LogPrint("reindex", "%s: Out of order block %s, parent %s not known\n", __func__, hash.ToString(),
-                            block.hashPrevBlock.ToString());
-                    if (dbp)
-                        mapBlocksUnknownParent.insert(std::make_pair(block.hashPrevBlock, *dbp));
-                    continue;
-                }
-
-                // process in case the block isn't known yet
-                if (mapBlockIndex.count(hash) == 0 || (mapBlockIndex[hash]->nStatus & BLOCK_HAVE_DATA) == 0) {
-                    LOCK(cs_main);
-                    CValidationState state;
-                    if (AcceptBlock(pblock, state, chainparams, NULL, true, dbp, NULL))
-                        nLoaded++;
-                    if (state.IsError())
-                        break;
-                } else if (hash != chainparams.GetConsensus().hashGenesisBlock && mapBlockIndex[hash]->nHeight % 1000 == 0) {
-                    LogPrint("reindex", "Block Import: already had block %s at height %d\n", hash.ToString(), mapBlockIndex[hash]->nHeight);
-                }
-
-                // Activate the genesis block so normal node progress can continue
-                if (hash == chainparams.GetConsensus().hashGenesisBlock) {
-                    CValidationState state;
-                    if (!ActivateBestChain(state, chainparams)) {
-                        break;
-                    }
-                }
-
-                NotifyHeaderTip();
-
-                // Recursively process earlier encountered successors of this block
-                std::deque<uint256> queue;
-                queue.push_back(hash);
-                while (!queue.empty()) {
-                    uint256 head = queue.front();
-                    queue.pop_front();
-                    std::pair<std::multimap<uint256, CDiskBlockPos>::iterator, std::multimap<uint256, CDiskBlockPos>::iterator> range = mapBlocksUnknownParent.equal_range(head);
-                    while (range.first != range.second) {
-                        std::multimap<uint256, CDiskBlockPos>::iterator it = range.first;
-                        std::shared_ptr<CBlock> pblockrecursive = std::make_shared<CBlock>();
-                        if (ReadBlockFromDisk(*pblockrecursive, it->second, chainparams.GetConsensus()))
-                        {
-                            LogPrint("reindex", "%s: Processing out of order child %s of %s\n", __func__, pblockrecursive->GetHash().ToString(),
-                                    head.ToString());
-                            LOCK(cs_main);
-                            CValidationState dummy;
-                            if (AcceptBlock(pblockrecursive, dummy, chainparams, NULL, true, &it->second, NULL))
-                            {
-                                nLoaded++;
-                                queue.push_back(pblockrecursive->GetHash());
-                            }
-                        }
-                        range.first++;
-                        mapBlocksUnknownParent.erase(it);
-                        NotifyHeaderTip();
-                    }
-                }
+                CImportedBlock item;
+                item.hash = pblock->GetHash();
+                item.hashPrevBlock = pblock->hashPrevBlock;
+                item.nFileIndex = nIndex;
+                item.nPos = nBlockPos;
+                item.nSize = nSize;
+                // A block that fails is passed on unchecked, AcceptBlock then
+                // rejects it as it would have before
+                CValidationState state;
+                if (!CheckBlock(*pblock, state, chainparams.GetConsensus(), true, true, &item.hashPoW))
+                    item.hashPoW.SetNull();
+                item.pblock = pblock;
+                Queue(nIndex, item);
             } catch (const std::exception& e) {
                 LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
             }
@@ -4144,9 +4424,191 @@ bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskB
     } catch (const std::runtime_error& e) {
         AbortNode(std::string("System error: ") + e.what());
     }
+}
+
+void CBlockImporter::Queue(size_t nIndex, CImportedBlock& item)
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        // Readers ahead of the file being accepted wait for room in the
+        // buffer. The reader of that file never waits, as blocks are only
+        // taken out of the buffer once it is done; it keeps just the
+        // positions of its blocks instead.
+        condReaders.wait(lock, [&] { return fStop || nIndex <= nCurrentFile || nBufferSize + item.nSize <= nMaxBufferSize; });
+        if (nBufferSize + item.nSize > nMaxBufferSize) {
+            if (!vFileSpilled[nIndex]) {
+                vFileSpilled[nIndex] = true;
+                LogPrint("reindex", "%s: Import buffer full, reading blocks of %s again as they are accepted\n", __func__, vFiles[nIndex].path.string());
+            }
+            item.pblock.reset();
+        } else
+            nBufferSize += item.nSize;
+        vQueues[nIndex].push_back(item);
+    }
+    condBlocks.notify_all();
+}
+
+void CBlockImporter::ReleaseBuffer(const CImportedBlock& item)
+{
+    if (!item.pblock)
+        return;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        nBufferSize -= item.nSize;
+    }
+    condReaders.notify_all();
+}
+
+bool CBlockImporter::AcceptImportedBlock(const CImportedBlock& item)
+{
+    const CImportFile& file = vFiles[item.nFileIndex];
+    std::shared_ptr<const CBlock> pblock = item.pblock;
+    uint256 hashPoW = item.hashPoW;
+    if (!pblock) {
+        std::shared_ptr<CBlock> pblockRead = std::make_shared<CBlock>();
+        CAutoFile filein(fopen(file.path.string().c_str(), "rb"), SER_DISK, CLIENT_VERSION);
+        try {
+            if (filein.IsNull() || fseek(filein.Get(), item.nPos, SEEK_SET))
+                throw std::runtime_error("cannot open or seek");
+            filein >> *pblockRead;
+        } catch (const std::exception& e) {
+            LogPrintf("%s: Failed to read block %s from %s again - %s\n", __func__, item.hash.ToString(), file.path.string(), e.what());
+            return true;
+        }
+        if (pblockRead->GetHash() != item.hash) {
+            LogPrintf("%s: Block %s in %s changed since it was read\n", __func__, item.hash.ToString(), file.path.string());
+            return true;
+        }
+        // The block hash does not cover the auxpow of a merge-mined block, so
+        // the PoW that was checked may not be the one read now; check it again
+        hashPoW.SetNull();
+        pblock = pblockRead;
+    }
+
+    CDiskBlockPos pos(file.nFile, (unsigned int)item.nPos);
+    {
+        LOCK(cs_main);
+        BlockMap::iterator mi = mapBlockIndex.find(item.hash);
+        if (mi == mapBlockIndex.end() || (mi->second->nStatus & BLOCK_HAVE_DATA) == 0) {
+            CValidationState state;
+            if (AcceptBlock(pblock, state, chainparams, NULL, true, file.nFile >= 0 ? &pos : NULL, NULL, hashPoW))
+                nLoaded++;
+            if (state.IsError())
+                return false;
+        } else if (item.hash != chainparams.GetConsensus().hashGenesisBlock && mi->second->nHeight % 1000 == 0) {
+            LogPrint("reindex", "Block Import: already had block %s at height %d\n", item.hash.ToString(), mi->second->nHeight);
+        }
+    }
+
+    // Activate the genesis block so normal node progress can continue
+    if (item.hash == chainparams.GetConsensus().hashGenesisBlock) {
+        CValidationState state;
+        if (!ActivateBestChain(state, chainparams))
+            return false;
+    }
+
+    NotifyHeaderTip();
+    return true;
+}
+
+bool CBlockImporter::ProcessBlock(CImportedBlock& item)
+{
+    // detect out of order blocks, and hold them until their parent is accepted
+    if (item.hash != chainparams.GetConsensus().hashGenesisBlock) {
+        LOCK(cs_main);
+        if (mapBlockIndex.find(item.hashPrevBlock) == mapBlockIndex.end()) {
+            LogPrint("reindex", "%s: Out of order block %s, parent %s not known\n", __func__, item.hash.ToString(),
+                    item.hashPrevBlock.ToString());
+            mapOutOfOrder.insert(std::make_pair(item.hashPrevBlock, item));
+            return true;
+        }
+    }
+
+    std::deque<CImportedBlock> queue;
+    queue.push_back(item);
+    while (!queue.empty()) {
+        CImportedBlock current = queue.front();
+        queue.pop_front();
+        bool fOk = AcceptImportedBlock(current);
+        ReleaseBuffer(current);
+        if (!fOk)
+            return false;
+
+        // Process earlier encountered successors of this block
+        std::pair<std::multimap<uint256, CImportedBlock>::iterator, std::multimap<uint256, CImportedBlock>::iterator> range = mapOutOfOrder.equal_range(current.hash);
+        for (std::multimap<uint256, CImportedBlock>::iterator it = range.first; it != range.second; ++it) {
+            LogPrint("reindex", "%s: Processing out of order child %s of %s\n", __func__, it->second.hash.ToString(),
+                    current.hash.ToString());
+            queue.push_back(it->second);
+        }
+        mapOutOfOrder.erase(range.first, range.second);
+    }
+    return true;
+}
+
+bool CBlockImporter::Run()
+{
+    int64_t nStart = GetTimeMillis();
+    nMaxBufferSize = (uint64_t)std::max(GetArg("-importbuffer", DEFAULT_IMPORT_BUFFER), (int64_t)0) * 1024;
+
+    // The readers do the work of -par verification threads
+    size_t nThreads = std::min(vFiles.size(), (size_t)std::max(nScriptCheckThreads, 1));
+    nMaxFilesAhead = MAX_IMPORT_FILES_AHEAD * nThreads;
+    for (size_t i = 0; i < nThreads; i++)
+        vThreads.push_back(std::thread(&TraceThread<std::function<void()> >, "loadblk", std::function<void()>(std::bind(&CBlockImporter::ThreadRead, this))));
+
+    bool fOk = true;
+    while (fOk && nCurrentFile < vFiles.size()) {
+        CImportedBlock item;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            std::deque<CImportedBlock>& queue = vQueues[nCurrentFile];
+            condBlocks.wait(lock, [&] { return !queue.empty() || vFileDone[nCurrentFile]; });
+            if (queue.empty()) {
+                nCurrentFile++;
+                lock.unlock();
+                condReaders.notify_all();
+                continue;
+            }
+            item = queue.front();
+            queue.pop_front();
+        }
+        boost::this_thread::interruption_point();
+        fOk = ProcessBlock(item);
+    }
+    Stop();
+
+    if (!mapOutOfOrder.empty())
+        LogPrintf("%s: %u blocks whose parent was not found were skipped\n", __func__, mapOutOfOrder.size());
     if (nLoaded > 0)
-        LogPrintf("Loaded %i blocks from external file in %dms\n", nLoaded, GetTimeMillis() - nStart);
-    return nLoaded > 0;
+        LogPrintf("Loaded %i blocks from %u files in %dms\n", nLoaded, vFiles.size(), GetTimeMillis() - nStart);
+    return fOk && !fOpenFailed;
+}
+
+}
+
+bool ReindexBlockFiles(const CChainParams& chainparams)
+{
+    std::vector<CImportFile> vFiles;
+    while (true) {
+        CDiskBlockPos pos(vFiles.size(), 0);
+        boost::filesystem::path path = GetBlockPosFilename(pos, "blk");
+        if (!boost::filesystem::exists(path))
+            break; // No block files left to reindex
+        CImportFile file = {path, (int)pos.nFile};
+        vFiles.push_back(file);
+    }
+    return CBlockImporter(chainparams, vFiles).Run();
+}
+
+bool LoadExternalBlockFiles(const CChainParams& chainparams, const std::vector<boost::filesystem::path>& vPaths)
+{
+    std::vector<CImportFile> vFiles;
+    for (const boost::filesystem::path& path : vPaths) {
+        CImportFile file = {path, -1};
+        vFiles.push_back(file);
+    }
+    return CBlockImporter(chainparams, vFiles).Run();
 }
 
 void static CheckBlockIndex(const Consensus::Params& consensusParams)
@@ -4355,7 +4817,110 @@ int VersionBitsTipStateSinceHeight(const Consensus::Params& params, Consensus::D
     return VersionBitsStateSinceHeight(chainActive.Tip(), params, pos, versionbitscache);
 }
 
-static const uint64_t MEMPOOL_DUMP_VERSION = 1;
+static const uint64_t MEMPOOL_DUMP_VERSION = 2;
+/** mempool.dat without checksums, as written before MEMPOOL_DUMP_VERSION 2 */
+static const uint64_t MEMPOOL_DUMP_VERSION_NO_CHECKSUM = 1;
+/** Maximum number of transactions and serialized size of a chunk of mempool.dat */
+static const size_t MEMPOOL_DUMP_CHUNK_TXS = 1000;
+static const size_t MEMPOOL_DUMP_CHUNK_SIZE = 4 * 1000 * 1000;
+
+namespace {
+
+struct MempoolDumpEntry
+{
+    CTransactionRef tx;
+    int64_t nTime;
+    int64_t nFeeDelta;
+};
+
+template<typename Stream>
+void ReadMempoolEntry(Stream& s, MempoolDumpEntry& entry)
+{
+    s >> entry.tx;
+    s >> entry.nTime;
+    s >> entry.nFeeDelta;
+}
+
+/** Write a chunk of mempool.dat followed by its hash, and clear it */
+void WriteMempoolChunk(CAutoFile& file, CDataStream& chunk)
+{
+    WriteCompactSize(file, chunk.size());
+    file.write(chunk.data(), chunk.size());
+    file << Hash(chunk.begin(), chunk.end());
+    chunk.clear();
+}
+
+/** Read a chunk of mempool.dat, throwing if it does not match its hash */
+void ReadMempoolChunk(CAutoFile& file, CDataStream& chunk)
+{
+    chunk.clear();
+    chunk.resize(ReadCompactSize(file));
+    file.read(chunk.data(), chunk.size());
+    uint256 hash;
+    file >> hash;
+    if (hash != Hash(chunk.begin(), chunk.end()))
+        throw std::runtime_error("checksum mismatch");
+}
+
+/**
+ * Verify the scripts of a batch of transactions from mempool.dat on the
+ * script check threads. This stores their signatures in the signature cache,
+ * so that AcceptToMemoryPool, which still checks the transactions one by one,
+ * does not verify them again. Transactions whose inputs are not available or
+ * whose scripts fail are left to AcceptToMemoryPool to reject.
+ */
+void PrecheckMempoolScripts(const std::vector<MempoolDumpEntry>& vEntries)
+{
+    if (!nScriptCheckThreads)
+        return;
+
+    std::vector<PrecomputedTransactionData> vTxData;
+    vTxData.reserve(vEntries.size());
+    std::vector<CScriptCheck> vChecks;
+
+    // cs_main is only held to look up the coins being spent. The checks keep
+    // a copy of the outputs they verify, so the signatures are verified after
+    // it is released, and only a block being connected meanwhile waits for
+    // them to share the queue.
+    {
+        LOCK(cs_main);
+        CCoinsViewMemPool viewMemPool(pcoinsTip, mempool);
+        CCoinsViewCache view(&viewMemPool);
+        for (const MempoolDumpEntry& entry : vEntries) {
+            const CTransaction& tx = *entry.tx;
+            if (tx.IsCoinBase())
+                continue;
+
+            bool fHaveInputs = true;
+            for (const CTxIn& txin : tx.vin) {
+                if (!view.HaveCoin(txin.prevout)) {
+                    fHaveInputs = false;
+                    break;
+                }
+            }
+            if (fHaveInputs) {
+                vTxData.emplace_back(tx);
+                for (unsigned int i = 0; i < tx.vin.size(); i++) {
+                    vChecks.push_back(CScriptCheck(view.AccessCoin(tx.vin[i].prevout).out, tx, i, STANDARD_SCRIPT_VERIFY_FLAGS, true, &vTxData.back()));
+                    // A failing transaction must not stop the checks of the
+                    // others, AcceptToMemoryPool rejects it
+                    vChecks.back().IgnoreFailure();
+                }
+            }
+
+            // Entries are in topological order, so later transactions of the
+            // batch may spend this one
+            AddCoins(view, tx, MEMPOOL_HEIGHT, true);
+        }
+    }
+
+    LOCK(cs_scriptcheckqueue);
+    CCheckQueueControl<CScriptCheck> control(&scriptcheckqueue);
+    control.Add(vChecks);
+    control.Wait();
+}
+
+}
 
 bool LoadMempool(void)
 {
@@ -4370,46 +4935,76 @@ bool LoadMempool(void)
     int64_t count = 0;
     int64_t skipped = 0;
     int64_t failed = 0;
+    int64_t nStart = GetTimeMillis();
     int64_t nNow = GetTime();
 
     try {
         uint64_t version;
         file >> version;
-        if (version != MEMPOOL_DUMP_VERSION) {
+        if (version != MEMPOOL_DUMP_VERSION && version != MEMPOOL_DUMP_VERSION_NO_CHECKSUM) {
             return false;
         }
+        bool fChecksums = version != MEMPOOL_DUMP_VERSION_NO_CHECKSUM;
         uint64_t num;
         file >> num;
         double prioritydummy = 0;
-        while (num--) {
-            CTransactionRef tx;
-            int64_t nTime;
-            int64_t nFeeDelta;
-            file >> tx;
-            file >> nTime;
-            file >> nFeeDelta;
-
-            CAmount amountdelta = nFeeDelta;
-            if (amountdelta) {
-                mempool.PrioritiseTransaction(tx->GetHash(), tx->GetHash().ToString(), prioritydummy, amountdelta);
+        CDataStream chunk(SER_DISK, CLIENT_VERSION);
+        std::vector<MempoolDumpEntry> vEntries;
+        while (num) {
+            // Read the next batch: a checksummed chunk, or up to as many
+            // transactions from an old file
+            vEntries.clear();
+            if (fChecksums) {
+                ReadMempoolChunk(file, chunk);
+                while (!chunk.empty() && num) {
+                    vEntries.emplace_back();
+                    ReadMempoolEntry(chunk, vEntries.back());
+                    num--;
+                }
+            } else {
+                while (vEntries.size() < MEMPOOL_DUMP_CHUNK_TXS && num) {
+                    vEntries.emplace_back();
+                    ReadMempoolEntry(file, vEntries.back());
+                    num--;
+                }
             }
-            CValidationState state;
-            if (nTime + nExpiryTimeout > nNow) {
+
+            std::vector<MempoolDumpEntry> vUnexpired;
+            vUnexpired.reserve(vEntries.size());
+            for (const MempoolDumpEntry& entry : vEntries) {
+                CAmount amountdelta = entry.nFeeDelta;
+                if (amountdelta) {
+                    mempool.PrioritiseTransaction(entry.tx->GetHash(), entry.tx->GetHash().ToString(), prioritydummy, amountdelta);
+                }
+                if (entry.nTime + nExpiryTimeout > nNow) {
+                    vUnexpired.push_back(entry);
+                } else {
+                    ++skipped;
+                }
+            }
+
+            PrecheckMempoolScripts(vUnexpired);
+
+            for (const MempoolDumpEntry& entry : vUnexpired) {
+                CValidationState state;
                 LOCK(cs_main);
-                AcceptToMemoryPoolWithTime(mempool, state, tx, true, NULL, nTime);
+                AcceptToMemoryPoolWithTime(mempool, state, entry.tx, true, NULL, entry.nTime);
                 if (state.IsValid()) {
                     ++count;
                 } else {
                     ++failed;
                 }
-            } else {
-                ++skipped;
             }
             if (ShutdownRequested())
                 return false;
         }
         std::map<uint256, CAmount> mapDeltas;
-        file >> mapDeltas;
+        if (fChecksums) {
+            ReadMempoolChunk(file, chunk);
+            chunk >> mapDeltas;
+        } else {
+            file >> mapDeltas;
+        }
 
         for (const auto& i : mapDeltas) {
             mempool.PrioritiseTransaction(i.first, i.first.ToString(), prioritydummy, i.second);
@@ -4419,7 +5014,7 @@ bool LoadMempool(void)
         return false;
     }
 
-    LogPrintf("Imported mempool transactions from disk: %i successes, %i failed, %i expired\n", count, failed, skipped);
+    LogPrintf("Imported mempool transactions from disk: %i successes, %i failed, %i expired in %dms\n", count, failed, skipped, GetTimeMillis() - nStart);
     return true;
 }
 
@@ -4451,15 +5046,28 @@ void DumpMempool(void)
         uint64_t version = MEMPOOL_DUMP_VERSION;
         file << version;
 
+        // infoAll returns the transactions ordered by their number of
+        // ancestors, so parents come before their children. They are
+        // written in chunks, each followed by its hash, so that LoadMempool
+        // can check a chunk before it uses any of its transactions.
         file << (uint64_t)vinfo.size();
+        CDataStream chunk(SER_DISK, CLIENT_VERSION);
+        size_t nChunkTxs = 0;
         for (const auto& i : vinfo) {
-            file << *(i.tx);
-            file << (int64_t)i.nTime;
-            file << (int64_t)i.nFeeDelta;
+            chunk << *(i.tx);
+            chunk << (int64_t)i.nTime;
+            chunk << (int64_t)i.nFeeDelta;
             mapDeltas.erase(i.tx->GetHash());
+            if (++nChunkTxs == MEMPOOL_DUMP_CHUNK_TXS || chunk.size() >= MEMPOOL_DUMP_CHUNK_SIZE) {
+                WriteMempoolChunk(file, chunk);
+                nChunkTxs = 0;
+            }
         }
+        if (nChunkTxs)
+            WriteMempoolChunk(file, chunk);
 
-        file << mapDeltas;
+        chunk << mapDeltas;
+        WriteMempoolChunk(file, chunk);
         FileCommit(file.Get());
         file.fclose();
         RenameOver(GetDataDir() / "mempool.dat.new", GetDataDir() / "mempool.dat");
@@ -5,6 +5,17 @@
 
 #include "validationinterface.h"
 
+#include "chain.h"
+#include "primitives/block.h"
+#include "primitives/transaction.h"
+#include "scheduler.h"
+#include "sync.h"
+
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <vector>
+
 static CMainSignals g_signals;
 
 CMainSignals& GetMainSignals()
@@ -12,7 +23,191 @@ CMainSignals& GetMainSignals()
     return g_signals;
 }
 
-void RegisterValidationInterface(CValidationInterface* pwalletIn) {
+/**
+ * Delivers notifications to the listeners registered with fAsync. The queue
+ * is connected to the signals like a synchronous listener, keeps a reference
+ * to the shared transaction or block a notification refers to and queues its
+ * delivery to all asynchronous listeners on the background scheduler.
+ */
+class CValidationInterfaceQueue
+{
+private:
+    CCriticalSection cs_listeners;
+    std::vector<CValidationInterface*> vListeners;
+    std::vector<boost::signals2::connection> vConnections;
+    // NULL until a background scheduler is registered: deliver synchronously
+    std::unique_ptr<SingleThreadedSchedulerClient> pqueue;
+    CScheduler* pscheduler;
+
+    // Held while notifications are delivered, so that Remove waits for a
+    // delivery in progress
+    CCriticalSection cs_delivery;
+
+    void Deliver(const std::function<void (CValidationInterface*)>& func)
+    {
+        std::function<void (void)> callback = [this, func] {
+            LOCK(cs_delivery);
+            std::vector<CValidationInterface*> vListenersCopy;
+            {
+                LOCK(cs_listeners);
+                vListenersCopy = vListeners;
+            }
+            for (CValidationInterface* pinterface : vListenersCopy)
+                func(pinterface);
+        };
+
+        {
+            LOCK(cs_listeners);
+            if (pqueue) {
+                pqueue->AddToProcessQueue(std::move(callback));
+                return;
+            }
+        }
+        callback();
+    }
+
+    void Connect()
+    {
+        vConnections.push_back(g_signals.UpdatedBlockTip.connect([this](const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) {
+            Deliver([=](CValidationInterface* p) { p->UpdatedBlockTip(pindexNew, pindexFork, fInitialDownload); });
+        }));
+        vConnections.push_back(g_signals.SyncTransaction.connect([this](const CTransactionRef &ptx, const CBlockIndex *pindex, int posInBlock) {
+            Deliver([=](CValidationInterface* p) { p->SyncTransaction(ptx, pindex, posInBlock); });
+        }));
+        vConnections.push_back(g_signals.UpdatedTransaction.connect([this](const uint256 &hash) {
+            Deliver([=](CValidationInterface* p) { p->UpdatedTransaction(hash); });
+        }));
+        vConnections.push_back(g_signals.SetBestChain.connect([this](const CBlockLocator &locator) {
+            Deliver([=](CValidationInterface* p) { p->SetBestChain(locator); });
+        }));
+        vConnections.push_back(g_signals.Inventory.connect([this](const uint256 &hash) {
+            Deliver([=](CValidationInterface* p) { p->Inventory(hash); });
+        }));
+        vConnections.push_back(g_signals.BlockFound.connect([this](const uint256 &hash) {
+            Deliver([=](CValidationInterface* p) { p->ResetRequestCount(hash); });
+        }));
+        vConnections.push_back(g_signals.NewPoWValidBlock.connect([this](const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& block) {
+            Deliver([=](CValidationInterface* p) { p->NewPoWValidBlock(pindex, block); });
+        }));
+        vConnections.push_back(g_signals.BlockConnected.connect([this](const std::shared_ptr<const CBlock> &block, const CBlockIndex *pindex) {
+            Deliver([=](CValidationInterface* p) { p->BlockConnected(block, pindex); });
+        }));
+        vConnections.push_back(g_signals.BlockDisconnected.connect([this](const std::shared_ptr<const CBlock> &block, const CBlockIndex *pindex) {
+            Deliver([=](CValidationInterface* p) { p->BlockDisconnected(block, pindex); });
+        }));
+    }
+
+public:
+    CValidationInterfaceQueue() : pscheduler(NULL) {}
+
+    void Add(CValidationInterface* pinterface)
+    {
+        LOCK(cs_listeners);
+        if (vListeners.empty())
+            Connect();
+        vListeners.push_back(pinterface);
+    }
+
+    void Remove(CValidationInterface* pinterface)
+    {
+        {
+            LOCK(cs_listeners);
+            std::vector<CValidationInterface*>::iterator it = std::find(vListeners.begin(), vListeners.end(), pinterface);
+            if (it == vListeners.end())
+                return;
+            vListeners.erase(it);
+            if (vListeners.empty()) {
+                for (boost::signals2::connection& conn : vConnections)
+                    conn.disconnect();
+                vConnections.clear();
+            }
+        }
+        LOCK(cs_delivery);
+    }
+
+    void RemoveAll()
+    {
+        {
+            LOCK(cs_listeners);
+            vListeners.clear();
+            for (boost::signals2::connection& conn : vConnections)
+                conn.disconnect();
+            vConnections.clear();
+        }
+        LOCK(cs_delivery);
+    }
+
+    void SetScheduler(CScheduler* pschedulerIn)
+    {
+        LOCK(cs_listeners);
+        pqueue.reset(pschedulerIn ? new SingleThreadedSchedulerClient(pschedulerIn) : NULL);
+        pscheduler = pschedulerIn;
+    }
+
+    void Flush()
+    {
+        // The callbacks take cs_delivery and then cs_listeners, so do not
+        // hold it while they run. Only the thread that sets the scheduler
+        // flushes, so the queue stays.
+        SingleThreadedSchedulerClient* pqueueFlush;
+        {
+            LOCK(cs_listeners);
+            pqueueFlush = pqueue.get();
+        }
+        if (pqueueFlush)
+            pqueueFlush->EmptyQueue();
+    }
+
+    void Sync()
+    {
+        std::shared_ptr<std::promise<void> > promise = std::make_shared<std::promise<void> >();
+        std::future<void> future = promise->get_future();
+        CScheduler* pschedulerWait;
+        {
+            LOCK(cs_listeners);
+            if (!pqueue)
+                return;
+            pqueue->AddToProcessQueue([promise] { promise->set_value(); });
+            pschedulerWait = pscheduler;
+        }
+        // Stop waiting if the scheduler is stopped for shutdown while the
+        // notifications are still pending
+        while (future.wait_for(std::chrono::milliseconds(100)) == std::future_status::timeout) {
+            if (!pschedulerWait->AreThreadsServicingQueue())
+                return;
+        }
+    }
+};
+
+static CValidationInterfaceQueue g_queue;
+
+void RegisterBackgroundSignalScheduler(CScheduler& scheduler) {
+    g_queue.SetScheduler(&scheduler);
+}
+
+void UnregisterBackgroundSignalScheduler() {
+    g_queue.Flush();
+    g_queue.SetScheduler(NULL);
+}
+
+void FlushBackgroundCallbacks() {
+    g_queue.Flush();
+}
+
+void SyncWithValidationInterfaceQueue() {
+    g_queue.Sync();
+}
+
+void RegisterValidationInterface(CValidationInterface* pwalletIn, bool fAsync) {
+    if (fAsync) {
+        // Only queries and notifications that must reflect the moment they
+        // are sent are delivered synchronously
+        g_signals.Broadcast.connect(boost::bind(&CValidationInterface::ResendWalletTransactions, pwalletIn, _1, _2));
+        g_signals.BlockChecked.connect(boost::bind(&CValidationInterface::BlockChecked, pwalletIn, _1, _2));
+        g_signals.ScriptForMining.connect(boost::bind(&CValidationInterface::GetScriptForMining, pwalletIn, _1));
+        g_queue.Add(pwalletIn);
+        return;
+    }
     g_signals.UpdatedBlockTip.connect(boost::bind(&CValidationInterface::UpdatedBlockTip, pwalletIn, _1, _2, _3));
     g_signals.SyncTransaction.connect(boost::bind(&CValidationInterface::SyncTransaction, pwalletIn, _1, _2, _3));
     g_signals.UpdatedTransaction.connect(boost::bind(&CValidationInterface::UpdatedTransaction, pwalletIn, _1));
@@ -23,9 +218,14 @@ void RegisterValidationInterface(CValidationInterface* pwalletIn) {
     g_signals.ScriptForMining.connect(boost::bind(&CValidationInterface::GetScriptForMining, pwalletIn, _1));
     g_signals.BlockFound.connect(boost::bind(&CValidationInterface::ResetRequestCount, pwalletIn, _1));
     g_signals.NewPoWValidBlock.connect(boost::bind(&CValidationInterface::NewPoWValidBlock, pwalletIn, _1, _2));
+    g_signals.BlockConnected.connect(boost::bind(&CValidationInterface::BlockConnected, pwalletIn, _1, _2));
+    g_signals.BlockDisconnected.connect(boost::bind(&CValidationInterface::BlockDisconnected, pwalletIn, _1, _2));
 }
 
 void UnregisterValidationInterface(CValidationInterface* pwalletIn) {
+    g_queue.Remove(pwalletIn);
+    g_signals.BlockDisconnected.disconnect(boost::bind(&CValidationInterface::BlockDisconnected, pwalletIn, _1, _2));
+    g_signals.BlockConnected.disconnect(boost::bind(&CValidationInterface::BlockConnected, pwalletIn, _1, _2));
     g_signals.BlockFound.disconnect(boost::bind(&CValidationInterface::ResetRequestCount, pwalletIn, _1));
     g_signals.ScriptForMining.disconnect(boost::bind(&CValidationInterface::GetScriptForMining, pwalletIn, _1));
     g_signals.BlockChecked.disconnect(boost::bind(&CValidationInterface::BlockChecked, pwalletIn, _1, _2));
@@ -39,6 +239,9 @@ void UnregisterValidationInterface(CValidationInterface* pwalletIn) {
 }
 
 void UnregisterAllValidationInterfaces() {
+    g_queue.RemoveAll();
+    g_signals.BlockDisconnected.disconnect_all_slots();
+    g_signals.BlockConnected.disconnect_all_slots();
     g_signals.BlockFound.disconnect_all_slots();
     g_signals.ScriptForMining.disconnect_all_slots();
     g_signals.BlockChecked.disconnect_all_slots();
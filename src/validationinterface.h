@@ -6,6 +6,8 @@
 #ifndef BITCOIN_VALIDATIONINTERFACE_H
 #define BITCOIN_VALIDATIONINTERFACE_H
 
+#include "primitives/transaction.h" // CTransaction(Ref)
+
 #include <boost/signals2/signal.hpp>
 #include <boost/shared_ptr.hpp>
 #include <memory>
@@ -16,24 +18,44 @@ struct CBlockLocator;
 class CBlockIndex;
 class CConnman;
 class CReserveScript;
-class CTransaction;
+class CScheduler;
 class CValidationInterface;
+class CValidationInterfaceQueue;
 class CValidationState;
 class uint256;
 
 // These functions dispatch to one or all registered wallets
 
-/** Register a wallet to receive updates from core */
-void RegisterValidationInterface(CValidationInterface* pwalletIn);
-/** Unregister a wallet from core */
+/** Register a wallet to receive updates from core. With fAsync, the
+ * notifications are queued and delivered in order on the background signal
+ * scheduler, so that the validation thread does not wait for the listener.
+ * Such a listener sees chainActive as it is at delivery, which may already
+ * differ from the chain the notification was sent for. BlockChecked,
+ * GetScriptForMining and ResendWalletTransactions are always delivered
+ * synchronously. */
+void RegisterValidationInterface(CValidationInterface* pwalletIn, bool fAsync = false);
+/** Unregister a wallet from core. Once this returns, no more notifications
+ * are delivered to it, so it must not be called with cs_main held. */
 void UnregisterValidationInterface(CValidationInterface* pwalletIn);
 /** Unregister all wallets from core */
 void UnregisterAllValidationInterfaces();
+/** Deliver the notifications of asynchronous listeners on scheduler's threads.
+ * Until this is called, they are delivered synchronously. */
+void RegisterBackgroundSignalScheduler(CScheduler& scheduler);
+/** Deliver the pending notifications and go back to synchronous delivery */
+void UnregisterBackgroundSignalScheduler();
+/** Deliver the pending notifications on the calling thread, once no thread
+ * services the scheduler any more. Must not be called with cs_main held. */
+void FlushBackgroundCallbacks();
+/** Wait until the notifications queued so far have been delivered to
+ * asynchronous listeners, for callers that need them to reflect the current
+ * chain. Must not be called with cs_main held. */
+void SyncWithValidationInterfaceQueue();
 
 class CValidationInterface {
 protected:
     virtual void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) {}
-    virtual void SyncTransaction(const CTransaction &tx, const CBlockIndex *pindex, int posInBlock) {}
+    virtual void SyncTransaction(const CTransactionRef &ptx, const CBlockIndex *pindex, int posInBlock) {}
     virtual void SetBestChain(const CBlockLocator &locator) {}
     virtual void UpdatedTransaction(const uint256 &hash) {}
     virtual void Inventory(const uint256 &hash) {}
@@ -42,9 +64,12 @@ protected:
     virtual void GetScriptForMining(boost::shared_ptr<CReserveScript>&) {};
     virtual void ResetRequestCount(const uint256 &hash) {};
     virtual void NewPoWValidBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& block) {};
-    friend void ::RegisterValidationInterface(CValidationInterface*);
+    virtual void BlockConnected(const std::shared_ptr<const CBlock> &block, const CBlockIndex *pindex) {}
+    virtual void BlockDisconnected(const std::shared_ptr<const CBlock> &block, const CBlockIndex *pindex) {}
+    friend void ::RegisterValidationInterface(CValidationInterface*, bool);
     friend void ::UnregisterValidationInterface(CValidationInterface*);
     friend void ::UnregisterAllValidationInterfaces();
+    friend class ::CValidationInterfaceQueue;
 };
 
 struct CMainSignals {
@@ -60,7 +85,7 @@ struct CMainSignals {
      * transaction was accepted to mempool, removed from mempool (only when
      * removal was due to conflict from connected block), or appeared in a
      * disconnected block.*/
-    boost::signals2::signal<void (const CTransaction &, const CBlockIndex *pindex, int posInBlock)> SyncTransaction;
+    boost::signals2::signal<void (const CTransactionRef &, const CBlockIndex *pindex, int posInBlock)> SyncTransaction;
     /** Notifies listeners of an updated transaction without new data (for now: a coinbase potentially becoming visible). */
     boost::signals2::signal<void (const uint256 &)> UpdatedTransaction;
     /** Notifies listeners of a new active block chain. */
@@ -79,6 +104,10 @@ struct CMainSignals {
      * Notifies listeners that a block which builds directly on our current tip
      * has been received and connected to the headers tree, though not validated yet */
     boost::signals2::signal<void (const CBlockIndex *, const std::shared_ptr<const CBlock>&)> NewPoWValidBlock;
+    /** Notifies listeners of a block being connected to the active chain, after its transactions went through SyncTransaction */
+    boost::signals2::signal<void (const std::shared_ptr<const CBlock> &, const CBlockIndex *pindex)> BlockConnected;
+    /** Notifies listeners of the tip of the active chain being disconnected */
+    boost::signals2::signal<void (const std::shared_ptr<const CBlock> &, const CBlockIndex *pindex)> BlockDisconnected;
 };
 
 CMainSignals& GetMainSignals();
@@ -490,4 +490,57 @@ BOOST_FIXTURE_TEST_CASE(importwallet_rescan, TestChain100Setup)
     ::pwalletMain = pwalletMainBackup;
 }
 
+BOOST_AUTO_TEST_CASE(scan_filter)
+{
+    CWallet wallet;
+    LOCK(wallet.cs_wallet);
+
+    CKey key, key2, otherKey, watchKey;
+    key.MakeNewKey(true);
+    key2.MakeNewKey(false);
+    otherKey.MakeNewKey(true);
+    watchKey.MakeNewKey(false);
+    wallet.AddKeyPubKey(key, key.GetPubKey());
+    wallet.AddKeyPubKey(key2, key2.GetPubKey());
+
+    CScript multisig = GetScriptForMultisig(1, {key.GetPubKey(), key2.GetPubKey()});
+    CScript witness = GetScriptForWitness(GetScriptForDestination(key.GetPubKey().GetID()));
+    CScript witnessMultisig = GetScriptForWitness(multisig);
+    CScript watched = GetScriptForDestination(watchKey.GetPubKey().GetID());
+    wallet.AddCScript(multisig);
+    wallet.AddCScript(witness);
+    wallet.AddCScript(witnessMultisig);
+    wallet.AddWatchOnly(watched, 0);
+
+    // Every script the wallet considers ours passes the filter.
+    const CWalletScanFilter filter(wallet);
+    std::vector<CScript> vMine = {
+        GetScriptForRawPubKey(key.GetPubKey()),
+        GetScriptForDestination(key.GetPubKey().GetID()),
+        multisig,
+        GetScriptForDestination(CScriptID(multisig)),
+        witness,
+        GetScriptForDestination(CScriptID(witness)),
+        witnessMultisig,
+        GetScriptForDestination(CScriptID(witnessMultisig)),
+        watched,
+    };
+    BOOST_FOREACH(const CScript& script, vMine) {
+        BOOST_CHECK(IsMine(wallet, script) != ISMINE_NO);
+        BOOST_CHECK(filter.IsRelevant(script));
+    }
+
+    // Scripts of other keys do not.
+    BOOST_CHECK(!filter.IsRelevant(GetScriptForDestination(otherKey.GetPubKey().GetID())));
+    BOOST_CHECK(!filter.IsRelevant(GetScriptForRawPubKey(watchKey.GetPubKey())));
+    BOOST_CHECK(!filter.IsRelevant(CScript() << OP_RETURN));
+
+    CMutableTransaction tx;
+    tx.vout.resize(2);
+    tx.vout[0].scriptPubKey = GetScriptForDestination(otherKey.GetPubKey().GetID());
+    BOOST_CHECK(!filter.IsRelevant(tx));
+    tx.vout[1].scriptPubKey = witness;
+    BOOST_CHECK(filter.IsRelevant(tx));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
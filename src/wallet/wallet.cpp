@@ -11,6 +11,8 @@
 #include "wallet/coincontrol.h"
 #include "consensus/consensus.h"
 #include "consensus/validation.h"
+#include "crypto/sha256.h"
+#include "hash.h"
 #include "key.h"
 #include "keystore.h"
 #include "validation.h"
@@ -27,6 +29,9 @@
 #include "utilmoneystr.h"
 
 #include <assert.h>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/filesystem.hpp>
@@ -1016,6 +1021,19 @@ bool CWallet::LoadToWallet(const CWalletTx& wtxIn)
     return true;
 }
 
+bool CWallet::MayBeInvolvingMe(const CTransaction& tx) const
+{
+    AssertLockHeld(cs_wallet);
+
+    if (mapWallet.count(tx.GetHash()))
+        return true;
+    BOOST_FOREACH(const CTxIn& txin, tx.vin) {
+        if (mapWallet.count(txin.prevout.hash) || mapTxSpends.count(txin.prevout))
+            return true;
+    }
+    return false;
+}
+
 /**
  * Add a transaction to the wallet, or update it.  pIndex and posInBlock should
  * be set when the transaction was known to be included in a block.  When
@@ -1179,8 +1197,9 @@ void CWallet::MarkConflicted(const uint256& hashBlock, const uint256& hashTx)
     }
 }
 
-void CWallet::SyncTransaction(const CTransaction& tx, const CBlockIndex *pindex, int posInBlock)
+void CWallet::SyncTransaction(const CTransactionRef& ptx, const CBlockIndex *pindex, int posInBlock)
 {
+    const CTransaction& tx = *ptx;
     LOCK2(cs_main, cs_wallet);
 
     if (!AddToWalletIfInvolvingMe(tx, pindex, posInBlock, true))
@@ -1539,11 +1558,183 @@ void CWalletTx::GetAccountAmounts(const string& strAccount, CAmount& nReceived,
     }
 }
 
+size_t CWalletScanFilter::ByteVectorHasher::operator()(const std::vector<unsigned char>& vch) const
+{
+    return MurmurHash3(nSeed, vch);
+}
+
+CWalletScanFilter::CWalletScanFilter(const CWallet& wallet) :
+    setPushes(0, ByteVectorHasher{(uint32_t)GetRand(std::numeric_limits<uint32_t>::max())}),
+    setWatchOnly(0, setPushes.hash_function())
+{
+    // Public keys for P2PK and multisig outputs, their IDs for P2PKH and
+    // P2WPKH outputs.
+    std::set<CKeyID> setKeyIDs;
+    wallet.GetKeys(setKeyIDs);
+    BOOST_FOREACH(const CKeyID& keyID, setKeyIDs) {
+        setPushes.insert(std::vector<unsigned char>(keyID.begin(), keyID.end()));
+        CPubKey pubkey;
+        if (wallet.GetPubKey(keyID, pubkey))
+            setPushes.insert(std::vector<unsigned char>(pubkey.begin(), pubkey.end()));
+    }
+
+    LOCK(wallet.cs_KeyStore);
+    // Script IDs for P2SH outputs, SHA256 hashes of scripts for P2WSH outputs.
+    BOOST_FOREACH(const ScriptMap::value_type& item, wallet.mapScripts) {
+        setPushes.insert(std::vector<unsigned char>(item.first.begin(), item.first.end()));
+        std::vector<unsigned char> vchHash(CSHA256::OUTPUT_SIZE);
+        CSHA256().Write(item.second.data(), item.second.size()).Finalize(vchHash.data());
+        setPushes.insert(vchHash);
+    }
+    BOOST_FOREACH(const CScript& script, wallet.setWatchOnly)
+        setWatchOnly.insert(std::vector<unsigned char>(script.begin(), script.end()));
+}
+
+bool CWalletScanFilter::IsRelevant(const CScript& scriptPubKey) const
+{
+    if (!setWatchOnly.empty() && setWatchOnly.count(std::vector<unsigned char>(scriptPubKey.begin(), scriptPubKey.end())))
+        return true;
+
+    CScript::const_iterator pc = scriptPubKey.begin();
+    std::vector<unsigned char> vchData;
+    opcodetype opcode;
+    while (pc < scriptPubKey.end()) {
+        if (!scriptPubKey.GetOp(pc, opcode, vchData))
+            break;
+        if (!vchData.empty() && setPushes.count(vchData))
+            return true;
+    }
+    return false;
+}
+
+bool CWalletScanFilter::IsRelevant(const CTransaction& tx) const
+{
+    BOOST_FOREACH(const CTxOut& txout, tx.vout) {
+        if (IsRelevant(txout.scriptPubKey))
+            return true;
+    }
+    return false;
+}
+
+namespace {
+
+/** A block of a rescan, read and filtered ahead of the wallet update */
+struct CRescanBlock
+{
+    CBlock block;
+    bool fRead;
+    //! Per transaction, whether one of its outputs passed the filter
+    std::vector<bool> vRelevant;
+};
+
+/**
+ * Reads the blocks of a rescan from disk and runs them through the scan
+ * filter on nThreads threads, at most nAhead blocks ahead of the wallet
+ * update. The blocks must be taken with Get and then handed back with Release
+ * in order. Without threads, Get does the work itself.
+ */
+class CRescanPrefetcher
+{
+private:
+    const std::vector<CBlockIndex*>& vBlocks;
+    const CWalletScanFilter& filter;
+    const Consensus::Params& consensusParams;
+    const size_t nAhead;
+
+    std::vector<CRescanBlock> vSlots;
+    std::vector<bool> vSlotDone;
+    std::mutex mutex;
+    std::condition_variable condDone;
+    std::condition_variable condSpace;
+    size_t nNext;
+    size_t nReleased;
+    bool fStop;
+    std::vector<std::thread> vThreads;
+
+    void Process(size_t i)
+    {
+        CRescanBlock& slot = vSlots[i % nAhead];
+        slot.fRead = ReadBlockFromDisk(slot.block, vBlocks[i], consensusParams);
+        slot.vRelevant.assign(slot.block.vtx.size(), false);
+        if (slot.fRead) {
+            for (size_t posInBlock = 0; posInBlock < slot.block.vtx.size(); ++posInBlock)
+                slot.vRelevant[posInBlock] = filter.IsRelevant(*slot.block.vtx[posInBlock]);
+        }
+    }
+
+    void ThreadPrefetch()
+    {
+        RenameThread("unitus-rescan");
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            while (!fStop && nNext < vBlocks.size() && nNext >= nReleased + nAhead)
+                condSpace.wait(lock);
+            if (fStop || nNext >= vBlocks.size())
+                return;
+            const size_t i = nNext++;
+            lock.unlock();
+            Process(i);
+            lock.lock();
+            vSlotDone[i % nAhead] = true;
+            condDone.notify_all();
+        }
+    }
+
+public:
+    CRescanPrefetcher(const std::vector<CBlockIndex*>& vBlocksIn, const CWalletScanFilter& filterIn, const Consensus::Params& consensusParamsIn, int nThreads) :
+        vBlocks(vBlocksIn), filter(filterIn), consensusParams(consensusParamsIn),
+        nAhead(std::max(1, nThreads) * RESCAN_BLOCKS_AHEAD),
+        vSlots(nAhead), vSlotDone(nAhead, false), nNext(0), nReleased(0), fStop(false)
+    {
+        for (int i = 0; i < nThreads; i++)
+            vThreads.push_back(std::thread(&CRescanPrefetcher::ThreadPrefetch, this));
+    }
+
+    ~CRescanPrefetcher()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            fStop = true;
+        }
+        condSpace.notify_all();
+        for (std::thread& thread : vThreads)
+            thread.join();
+    }
+
+    const CRescanBlock& Get(size_t i)
+    {
+        if (vThreads.empty()) {
+            Process(i);
+        } else {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (!vSlotDone[i % nAhead])
+                condDone.wait(lock);
+        }
+        return vSlots[i % nAhead];
+    }
+
+    void Release(size_t i)
+    {
+        // Drop the block now rather than when the slot is reused.
+        vSlots[i % nAhead].block.SetNull();
+        std::lock_guard<std::mutex> lock(mutex);
+        vSlotDone[i % nAhead] = false;
+        nReleased = i + 1;
+        condSpace.notify_all();
+    }
+};
+
+} // namespace
+
 /**
  * Scan the block chain (starting in pindexStart) for transactions
  * from or to us. If fUpdate is true, found transactions that already
  * exist in the wallet will be updated.
  *
+ * Blocks are read and their outputs matched against a CWalletScanFilter on
+ * -rescanthreads threads, ahead of this thread, which only passes on the
+ * transactions that match or that involve the wallet through their inputs.
+ *
  * Returns pointer to the first block in the last contiguous range that was
  * successfully scanned.
  *
@@ -1566,15 +1757,25 @@ CBlockIndex* CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool f
         ShowProgress(_("Rescanning..."), 0); // show rescan progress in GUI as dialog or on splashscreen, if -rescan on startup
         double dProgressStart = GuessVerificationProgress(chainParams.TxData(), pindex);
         double dProgressTip = GuessVerificationProgress(chainParams.TxData(), chainActive.Tip());
-        while (pindex)
+
+        std::vector<CBlockIndex*> vBlocks;
+        for (; pindex; pindex = chainActive.Next(pindex))
+            vBlocks.push_back(pindex);
+        const CWalletScanFilter filter(*this);
+        CRescanPrefetcher prefetcher(vBlocks, filter, chainParams.GetConsensus(), std::max(0, (int)GetArg("-rescanthreads", DEFAULT_RESCAN_THREADS)));
+
+        for (size_t i = 0; i < vBlocks.size(); i++)
         {
+            pindex = vBlocks[i];
             if (pindex->nHeight % 100 == 0 && dProgressTip - dProgressStart > 0.0)
                 ShowProgress(_("Rescanning..."), std::max(1, std::min(99, (int)((GuessVerificationProgress(chainParams.TxData(), pindex) - dProgressStart) / (dProgressTip - dProgressStart) * 100))));
 
-            CBlock block;
-            if (ReadBlockFromDisk(block, pindex, Params().GetConsensus())) {
-                for (size_t posInBlock = 0; posInBlock < block.vtx.size(); ++posInBlock) {
-                    AddToWalletIfInvolvingMe(*block.vtx[posInBlock], pindex, posInBlock, fUpdate);
+            const CRescanBlock& scanned = prefetcher.Get(i);
+            if (scanned.fRead) {
+                for (size_t posInBlock = 0; posInBlock < scanned.block.vtx.size(); ++posInBlock) {
+                    const CTransaction& tx = *scanned.block.vtx[posInBlock];
+                    if (scanned.vRelevant[posInBlock] || MayBeInvolvingMe(tx))
+                        AddToWalletIfInvolvingMe(tx, pindex, posInBlock, fUpdate);
                 }
                 if (!ret) {
                     ret = pindex;
@@ -1582,7 +1783,7 @@ CBlockIndex* CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool f
             } else {
                 ret = nullptr;
             }
-            pindex = chainActive.Next(pindex);
+            prefetcher.Release(i);
             if (GetTime() >= nNow + 60) {
                 nNow = GetTime();
                 LogPrintf("Still rescanning. At block %d. Progress=%f\n", pindex->nHeight, GuessVerificationProgress(chainParams.TxData(), pindex));
@@ -3547,6 +3748,7 @@ std::string CWallet::GetWalletHelpString(bool showDebug)
     strUsage += HelpMessageOpt("-paytxfee=<amt>", strprintf(_("Fee (in %s/kB) to add to transactions you send (default: %s)"),
                                                             CURRENCY_UNIT, FormatMoney(payTxFee.GetFeePerK())));
     strUsage += HelpMessageOpt("-rescan", _("Rescan the block chain for missing wallet transactions on startup"));
+    strUsage += HelpMessageOpt("-rescanthreads=<n>", strprintf(_("Set the number of threads that read blocks ahead during a rescan (0 = none, default: %d)"), DEFAULT_RESCAN_THREADS));
     strUsage += HelpMessageOpt("-salvagewallet", _("Attempt to recover private keys from a corrupt wallet on startup"));
     if (showDebug)
         strUsage += HelpMessageOpt("-sendfreetransactions", strprintf(_("Send transactions as zero-fee transactions if possible (default: %u)"), DEFAULT_SEND_FREE_TRANSACTIONS));
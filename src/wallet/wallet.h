@@ -26,6 +26,7 @@
 #include <stdexcept>
 #include <stdint.h>
 #include <string>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
@@ -72,6 +73,10 @@ static const bool DEFAULT_WALLETBROADCAST = true;
 static const bool DEFAULT_DISABLE_WALLET = false;
 //! if set, all keys will be derived by using BIP32
 static const bool DEFAULT_USE_HD_WALLET = true;
+//! -rescanthreads default
+static const int DEFAULT_RESCAN_THREADS = 4;
+//! Maximum number of blocks each -rescanthreads thread reads ahead of the wallet update
+static const unsigned int RESCAN_BLOCKS_AHEAD = 16;
 
 extern const char * DEFAULT_WALLET_DAT;
 
@@ -485,6 +490,35 @@ private:
 };
 
 
+/**
+ * What an output has to push, or be, to possibly be IsMine for a wallet: the
+ * wallet's public keys and their IDs, the IDs and SHA256 hashes of its
+ * scripts, and its watch-only scripts. Built once before a rescan so that
+ * blocks can be filtered on other threads without any wallet lock. An output
+ * that matches may still not be ours; one that does not match is not.
+ */
+class CWalletScanFilter
+{
+private:
+    struct ByteVectorHasher
+    {
+        uint32_t nSeed;
+        size_t operator()(const std::vector<unsigned char>& vch) const;
+    };
+    typedef std::unordered_set<std::vector<unsigned char>, ByteVectorHasher> ByteVectorSet;
+
+    ByteVectorSet setPushes;
+    ByteVectorSet setWatchOnly;
+
+public:
+    explicit CWalletScanFilter(const CWallet& wallet);
+
+    //! Whether scriptPubKey may be IsMine
+    bool IsRelevant(const CScript& scriptPubKey) const;
+    //! Whether any output of tx may be IsMine
+    bool IsRelevant(const CTransaction& tx) const;
+};
+
 /**
  * A CWallet is an extension of a keystore, which also maintains a set of transactions and balances,
  * and provides the ability to create new transactions.
@@ -492,6 +526,8 @@ private:
 class CWallet : public CCryptoKeyStore, public CValidationInterface
 {
 private:
+    friend class CWalletScanFilter;
+
     static std::atomic<bool> fFlushThreadRunning;
 
     /**
@@ -528,6 +564,13 @@ private:
 
     void SyncMetaData(std::pair<TxSpends::iterator, TxSpends::iterator>);
 
+    /**
+     * Whether AddToWalletIfInvolvingMe may act on tx for a reason other than
+     * its outputs: tx is in the wallet already, or it spends a wallet
+     * transaction or an outpoint that a wallet transaction spends.
+     */
+    bool MayBeInvolvingMe(const CTransaction& tx) const;
+
     /* the HD chain data model (external chain counters) */
     CHDChain hdChain;
 
@@ -709,7 +752,7 @@ public:
     void MarkDirty();
     bool AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose=true);
     bool LoadToWallet(const CWalletTx& wtxIn);
-    void SyncTransaction(const CTransaction& tx, const CBlockIndex *pindex, int posInBlock) override;
+    void SyncTransaction(const CTransactionRef& ptx, const CBlockIndex *pindex, int posInBlock) override;
     bool AddToWalletIfInvolvingMe(const CTransaction& tx, const CBlockIndex* pIndex, int posInBlock, bool fUpdate);
     CBlockIndex* ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate = false);
     void ReacceptWalletTransactions();
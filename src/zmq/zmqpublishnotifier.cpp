@@ -16,46 +16,85 @@ static const char *MSG_HASHTX    = "hashtx";
 static const char *MSG_RAWBLOCK  = "rawblock";
 static const char *MSG_RAWTX     = "rawtx";
 
-// Internal function to send multipart message
-static int zmq_send_multipart(void *sock, const void* data, size_t size, ...)
+// Internal function to initialize a message part with a copy of data
+static int zmq_msg_init_copy(zmq_msg_t *msg, const void* data, size_t size)
 {
-    va_list args;
-    va_start(args, size);
-
-    while (1)
+    int rc = zmq_msg_init_size(msg, size);
+    if (rc != 0)
     {
-        zmq_msg_t msg;
-
-        int rc = zmq_msg_init_size(&msg, size);
-        if (rc != 0)
-        {
-            zmqError("Unable to initialize ZMQ msg");
-            return -1;
-        }
-
-        void *buf = zmq_msg_data(&msg);
-        memcpy(buf, data, size);
-
-        data = va_arg(args, const void*);
+        zmqError("Unable to initialize ZMQ msg");
+        return -1;
+    }
+    memcpy(zmq_msg_data(msg), data, size);
+    return 0;
+}
 
-        rc = zmq_msg_send(&msg, sock, data ? ZMQ_SNDMORE : 0);
+// Internal function to send multipart message. All parts are built before
+// the first one is sent, and handed to ZMQ back to back as one batch.
+static int zmq_send_multipart(void *sock, zmq_msg_t *parts, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        int rc = zmq_msg_send(&parts[i], sock, i + 1 < count ? ZMQ_SNDMORE : 0);
         if (rc == -1)
         {
             zmqError("Unable to send ZMQ msg");
-            zmq_msg_close(&msg);
+            for (; i < count; i++)
+                zmq_msg_close(&parts[i]);
             return -1;
         }
+        zmq_msg_close(&parts[i]);
+    }
+    return 0;
+}
 
-        zmq_msg_close(&msg);
-
-        if (!data)
-            break;
+// Release the data of a message part built by zmq_msg_init_shared, once ZMQ has sent it
+static void zmq_free_shared(void * /*data*/, void *hint)
+{
+    delete static_cast<std::shared_ptr<const std::vector<unsigned char> >*>(hint);
+}
 
-        size = va_arg(args, size_t);
+// Internal function to initialize a message part that references data
+// instead of copying it
+static int zmq_msg_init_shared(zmq_msg_t *msg, const std::shared_ptr<const std::vector<unsigned char> >& data)
+{
+    std::shared_ptr<const std::vector<unsigned char> > *holder = new std::shared_ptr<const std::vector<unsigned char> >(data);
+    int rc = zmq_msg_init_data(msg, (void*)data->data(), data->size(), zmq_free_shared, holder);
+    if (rc != 0)
+    {
+        zmqError("Unable to initialize ZMQ msg");
+        delete holder;
+        return -1;
     }
     return 0;
 }
 
+// Internal function to send the command, data and sequence number parts of
+// a notification; takes ownership of the data part
+static int zmq_send_notification(void *sock, const char *command, zmq_msg_t *data, uint32_t nSequence)
+{
+    zmq_msg_t parts[3];
+    unsigned char msgseq[sizeof(uint32_t)];
+    WriteLE32(&msgseq[0], nSequence);
+
+    if (zmq_msg_init_copy(&parts[0], command, strlen(command)) != 0)
+    {
+        zmq_msg_close(data);
+        return -1;
+    }
+    zmq_msg_init(&parts[1]);
+    zmq_msg_move(&parts[1], data);
+    zmq_msg_close(data);
+    if (zmq_msg_init_copy(&parts[2], msgseq, sizeof(msgseq)) != 0)
+    {
+        zmq_msg_close(&parts[0]);
+        zmq_msg_close(&parts[1]);
+        return -1;
+    }
+
+    return zmq_send_multipart(sock, parts, 3);
+}
+
 bool CZMQAbstractPublishNotifier::Initialize(void *pcontext)
 {
     assert(!psocket);
@@ -72,7 +111,18 @@ bool CZMQAbstractPublishNotifier::Initialize(void *pcontext)
             return false;
         }
 
-        int rc = zmq_bind(psocket, address.c_str());
+        // Bound the messages queued for a slow subscriber; further ones are
+        // dropped for it rather than piling up in memory
+        LogPrint("zmq", "zmq: Outbound message high water mark for %s at %s is %d\n", type, address, nOutboundMessageHighWaterMark);
+        int rc = zmq_setsockopt(psocket, ZMQ_SNDHWM, &nOutboundMessageHighWaterMark, sizeof(nOutboundMessageHighWaterMark));
+        if (rc != 0)
+        {
+            zmqError("Failed to set outbound message high water mark");
+            zmq_close(psocket);
+            return false;
+        }
+
+        rc = zmq_bind(psocket, address.c_str());
         if (rc!=0)
         {
             zmqError("Failed to bind address");
@@ -130,10 +180,10 @@ bool CZMQAbstractPublishNotifier::SendMessage(const char *command, const void* d
     assert(psocket);
 
     /* send three parts, command & data & a LE 4byte sequence number */
-    unsigned char msgseq[sizeof(uint32_t)];
-    WriteLE32(&msgseq[0], nSequence);
-    int rc = zmq_send_multipart(psocket, command, strlen(command), data, size, msgseq, (size_t)sizeof(uint32_t), (void*)0);
-    if (rc == -1)
+    zmq_msg_t msgdata;
+    if (zmq_msg_init_copy(&msgdata, data, size) != 0)
+        return false;
+    if (zmq_send_notification(psocket, command, &msgdata, nSequence) == -1)
         return false;
 
     /* increment memory only sequence number after sending */
@@ -142,7 +192,22 @@ bool CZMQAbstractPublishNotifier::SendMessage(const char *command, const void* d
     return true;
 }
 
-bool CZMQPublishHashBlockNotifier::NotifyBlock(const CBlockIndex *pindex)
+bool CZMQAbstractPublishNotifier::SendMessage(const char *command, const std::shared_ptr<const std::vector<unsigned char> >& data)
+{
+    assert(psocket);
+
+    zmq_msg_t msgdata;
+    if (zmq_msg_init_shared(&msgdata, data) != 0)
+        return false;
+    if (zmq_send_notification(psocket, command, &msgdata, nSequence) == -1)
+        return false;
+
+    nSequence++;
+
+    return true;
+}
+
+bool CZMQPublishHashBlockNotifier::NotifyBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& pblock)
 {
     uint256 hash = pindex->GetBlockHash();
     LogPrint("zmq", "zmq: Publish hashblock %s\n", hash.GetHex());
@@ -162,25 +227,31 @@ bool CZMQPublishHashTransactionNotifier::NotifyTransaction(const CTransaction &t
     return SendMessage(MSG_HASHTX, data, 32);
 }
 
-bool CZMQPublishRawBlockNotifier::NotifyBlock(const CBlockIndex *pindex)
+bool CZMQPublishRawBlockNotifier::NotifyBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& pblock)
 {
     LogPrint("zmq", "zmq: Publish rawblock %s\n", pindex->GetBlockHash().GetHex());
 
-    const Consensus::Params& consensusParams = Params().GetConsensus();
-    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
+    // Use the block that was just connected when there is one, rather than
+    // reading it back and checking its proof of work again
+    std::shared_ptr<const CBlock> pblockPublish = pblock;
+    if (!pblockPublish)
     {
+        const Consensus::Params& consensusParams = Params().GetConsensus();
+        std::shared_ptr<CBlock> pblockRead = std::make_shared<CBlock>();
         LOCK(cs_main);
-        CBlock block;
-        if(!ReadBlockFromDisk(block, pindex, consensusParams))
+        if(!ReadBlockFromDisk(*pblockRead, pindex, consensusParams))
         {
             zmqError("Can't read block from disk");
             return false;
         }
-
-        ss << block;
+        pblockPublish = pblockRead;
     }
 
-    return SendMessage(MSG_RAWBLOCK, &(*ss.begin()), ss.size());
+    std::shared_ptr<std::vector<unsigned char> > data = std::make_shared<std::vector<unsigned char> >();
+    data->reserve(::GetSerializeSize(*pblockPublish, SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags()));
+    CVectorWriter(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags(), *data, 0, *pblockPublish);
+
+    return SendMessage(MSG_RAWBLOCK, data);
 }
 
 bool CZMQPublishRawTransactionNotifier::NotifyTransaction(const CTransaction &transaction)